@@ -0,0 +1,210 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+#include "agent.h"
+#include "http.h"
+#include "mock_server.h"
+#include "options.h"
+
+/**
+ * End-to-end benchmark of the sync against the local mock of the SamLib site. For every number of authors it
+ * measures:
+ *     add        - `Agent::addAuthor` for every author
+ *     sync:new   - the first `syncAll`, i.e. all books are new
+ *     sync:same  - `syncAll` without any changes on the site
+ *     sync:upd   - `syncAll` after the site has changed (new and updated books)
+ *     fetch:html - downloading of the books as HTML
+ *     fetch:fb2  - downloading of the books as FB2
+ *
+ * The rate limiter of the client (see http::HostLimiter) is off unless `--client-rps` is given. With `--async=N` the
+ * operations are run by agent::AsyncAgent, up to N of them at once.
+ */
+
+struct Measurement {
+    std::string name;
+    unsigned int authorsCount;
+    unsigned long items;
+    double seconds;
+    unsigned long requests;
+    unsigned long long bytes;
+};
+
+static void printHeader() {
+    std::cout << std::left << std::setw(12) << "operation" << std::right
+              << std::setw(9) << "authors" << std::setw(10) << "items" << std::setw(11) << "time, s"
+              << std::setw(12) << "items/s" << std::setw(10) << "requests" << std::setw(11) << "MiB/s" << std::endl;
+}
+
+static void print(const Measurement& measurement) {
+    const auto mebibytes = static_cast<double>(measurement.bytes) / 1024.0 / 1024.0;
+
+    std::cout << std::left << std::setw(12) << measurement.name << std::right << std::fixed
+              << std::setw(9) << measurement.authorsCount
+              << std::setw(10) << measurement.items
+              << std::setw(11) << std::setprecision(3) << measurement.seconds
+              << std::setw(12) << std::setprecision(1) << static_cast<double>(measurement.items) / measurement.seconds
+              << std::setw(10) << measurement.requests
+              << std::setw(11) << std::setprecision(2) << mebibytes / measurement.seconds << std::endl;
+}
+
+static Measurement measure(const std::string& name, unsigned int authorsCount, const mock::MockServer& server,
+                           const std::function<unsigned long()>& callable) {
+    const auto requests = server.getRequestsCount();
+    const auto bytes = server.getBytesSent();
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto items = callable();
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    return Measurement{
+        name, authorsCount, items, duration.count(), server.getRequestsCount() - requests,
+        server.getBytesSent() - bytes
+    };
+}
+
+static async::Task<void> runNext(std::size_t count, std::atomic<std::size_t>& next,
+                                 const std::function<async::Task<void>(std::size_t)>& operation) {
+    for (auto i = next++; i < count; i = next++) {
+        co_await operation(i);
+    }
+}
+
+// runs the operation for every index in [0, count), up to `concurrency` of them at once
+static void forEachAsync(std::size_t count, unsigned int concurrency,
+                         const std::function<async::Task<void>(std::size_t)>& operation) {
+    std::atomic<std::size_t> next{0};
+    std::vector<async::Task<void>> tasks;
+    for (std::size_t i = 0; i < std::min<std::size_t>(concurrency, count); i++) {
+        tasks.push_back(runNext(count, next, operation));
+    }
+    async::run(async::whenAll(std::move(tasks)));
+}
+
+static async::Task<void> addAuthor(agent::AsyncAgent& agent, std::size_t index) {
+    co_await agent.addAuthor("author_" + std::to_string(index + 1));
+}
+
+static async::Task<void> fetchBook(agent::AsyncAgent& agent, const db::BookData& book, fs::BookType bookType) {
+    co_await agent.fetchBook(book, bookType);
+}
+
+static void run(unsigned int authorsCount, unsigned int booksToFetch, unsigned int concurrency,
+                mock::MockServer& server) {
+    const auto location = std::filesystem::temp_directory_path()
+                        / ("samlib-bench-" + std::to_string(getpid()) + "-" + std::to_string(authorsCount));
+    std::filesystem::remove_all(location);
+    std::filesystem::create_directories(location);
+
+    {
+        auto logger = std::make_shared<logger::Logger>(
+            &std::cerr, std::make_unique<logger::ISO8601LogFormatter>(), logger::LogLevel::Warning
+        );
+        agent::Agent agent(location / "samlib.db", location, logger);
+        agent::AsyncAgent asyncAgent(agent);
+        agent.initDB();
+        server.setRevision(0);
+
+        print(measure("add", authorsCount, server, [&] {
+            if (concurrency) {
+                forEachAsync(authorsCount, concurrency, [&](std::size_t i) {return addAuthor(asyncAgent, i);});
+                return static_cast<unsigned long>(authorsCount);
+            }
+
+            for (unsigned int i = 1; i <= authorsCount; i++) {
+                agent.addAuthor("author_" + std::to_string(i));
+            }
+            return static_cast<unsigned long>(authorsCount);
+        }));
+
+        const auto sync = [&] {
+            if (concurrency) {
+                async::run(asyncAgent.checkUpdates(concurrency));
+            } else {
+                agent.checkUpdates();
+            }
+            return static_cast<unsigned long>(authorsCount);
+        };
+        print(measure("sync:new", authorsCount, server, sync));
+        print(measure("sync:same", authorsCount, server, sync));
+        server.setRevision(1);
+        print(measure("sync:upd", authorsCount, server, sync));
+
+        db::Books books;
+        for (const auto& author : agent.getAuthors()) {
+            for (const auto& book : agent.getBooks(author)) {
+                if (books.size() >= booksToFetch) {
+                    break;
+                }
+                books.push_back(book);
+            }
+        }
+
+        const auto fetch = [&](fs::BookType bookType) {
+            if (concurrency) {
+                forEachAsync(books.size(), concurrency, [&](std::size_t i) {
+                    return fetchBook(asyncAgent, books[i], bookType);
+                });
+                return static_cast<unsigned long>(books.size());
+            }
+
+            for (const auto& book : books) {
+                agent.fetchBook(book, bookType);
+            }
+            return static_cast<unsigned long>(books.size());
+        };
+        print(measure("fetch:html", authorsCount, server, [&] {return fetch(fs::BookType::HTML);}));
+        print(measure("fetch:fb2", authorsCount, server, [&] {return fetch(fs::BookType::FB2);}));
+    }
+
+    std::filesystem::remove_all(location);
+}
+
+int main(int argc, char** argv) {
+    const bench::Options options(argc, argv);
+    if (options.has("help")) {
+        std::cout << "Usage: " << argv[0] << " [--authors=10,100,1000,10000] [--fetch-books=N] [--async=N] [--client-rps=N] "
+                  << "[--client-connections=N] [--client-compression=0|1] "
+                  << bench::SITE_OPTIONS_HELP << std::endl;
+        return 0;
+    }
+
+    try {
+        mock::MockServer server(options.getSiteSettings());
+        http::Settings site;
+        site.protocol = "http";
+        site.domain = server.getDomain();
+        site.requestsPerSecond = options.get("client-rps", 0.0);  // the mock is local, so no politeness by default
+        site.maxConnections = options.get("client-connections", 0u);
+        site.compression = options.get("client-compression", true);
+        http::configure(site);
+
+        printHeader();
+        for (const auto authorsCount : options.getList("authors", {10, 100, 1000, 10000})) {
+            run(authorsCount, options.get("fetch-books", 200u), options.get("async", 0u), server);
+        }
+    } catch (const SamLibError& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
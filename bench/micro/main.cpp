@@ -0,0 +1,656 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <regex>
+#include <sstream>
+#include "db.h"
+#include "executor.h"
+#include "http.h"
+#include "miner.h"
+#include "parser.h"
+#include "tools.h"
+#include "mock_server.h"
+
+/**
+ * Microbenchmarks of the hot paths of the sync. The pages are generated by the mock site (see mock_server.h), the
+ * argument of a benchmark is the number of books per group. Set SAMLIB_BENCH_CORPUS to a directory with captured
+ * author's pages (`*.shtml`, cp1251) to measure the parser on the real pages as well.
+ */
+
+// all allocations of the process are counted, so a benchmark can report how many of them an iteration does
+static std::atomic<unsigned long long> allocationsCount{0};
+
+void* operator new(std::size_t size) {
+    allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// std::pmr::new_delete_resource() allocates with the alignment
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    if (auto pointer = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+static mock::SiteSettings getSiteSettings(unsigned int booksPerGroup, unsigned int groupsCount = 4) {
+    mock::SiteSettings settings;
+    settings.groupsCount = groupsCount;
+    settings.extendedGroupsCount = 0;
+    settings.booksPerGroup = booksPerGroup;
+    return settings;
+}
+
+// cp1251 page of an author, as it comes from the site
+static std::string getRawAuthorPage(unsigned int booksPerGroup) {
+    return mock::Site(getSiteSettings(booksPerGroup)).getAuthorPage("author_1", 0);
+}
+
+static std::string getAuthorPage(unsigned int booksPerGroup) {
+    return http::toUtf8(getRawAuthorPage(booksPerGroup));
+}
+
+// the page of one of the largest authors: thousands of books in dozens of groups
+static std::string getLargeAuthorPage() {
+    return http::toUtf8(mock::Site(getSiteSettings(100, 40)).getAuthorPage("author_1", 0));
+}
+
+static std::string getGroupPage(unsigned int booksPerGroup) {
+    return http::toUtf8(mock::Site(getSiteSettings(booksPerGroup)).getGroupPage(1, 0));
+}
+
+static std::vector<std::string> getCorpus() {
+    std::vector<std::string> pages;
+    const auto directory = std::getenv("SAMLIB_BENCH_CORPUS");
+    if (!directory) {
+        return pages;
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".shtml") {
+            std::ifstream file(entry.path(), std::ios::binary);
+            std::stringstream content;
+            content << file.rdbuf();
+            pages.push_back(http::toUtf8(content.str()));
+        }
+    }
+
+    return pages;
+}
+
+template <typename Groups>
+static unsigned long countBooks(const Groups& groups) {
+    unsigned long count = 0;
+    for (const auto& group : groups) {
+        count += group.books.size();
+    }
+    return count;
+}
+
+static void setBytesProcessed(benchmark::State& state, std::size_t bytesPerIteration) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytesPerIteration));
+}
+
+
+static void BM_ToUtf8(benchmark::State& state) {
+    const auto page = getRawAuthorPage(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(http::toUtf8(page));
+    }
+    state.SetItemsProcessed(state.iterations());
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_ToUtf8)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_GetBookGroupList(benchmark::State& state) {
+    const auto page = getAuthorPage(state.range(0));
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto groups = parser::getBookGroupList(page);
+        books += countBooks(groups);
+        benchmark::DoNotOptimize(groups);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_GetBookGroupList)->Arg(10)->Arg(100)->Arg(1000);
+
+// the same without copying the fields and cleaning the descriptions, as the sync does it
+static void BM_GetBookGroupViews(benchmark::State& state) {
+    const auto page = getAuthorPage(state.range(0));
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto groups = parser::getBookGroupViews(page);
+        books += countBooks(groups);
+        benchmark::DoNotOptimize(groups);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_GetBookGroupViews)->Arg(10)->Arg(100)->Arg(1000);
+
+// the groups of a large page are parsed on the executor of the given number of workers (1 means serially)
+static void BM_GetBookGroupViewsLarge(benchmark::State& state) {
+    const auto page = getLargeAuthorPage();
+    executor::Executor pool(static_cast<unsigned int>(state.range(0)));
+
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto groups = parser::getBookGroupViews(page, parser::DEFAULT_BOOK_GROUPS_PATTERN,
+                                                      std::pmr::get_default_resource(), pool);
+        books += countBooks(groups);
+        benchmark::DoNotOptimize(groups);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_GetBookGroupViewsLarge)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+static void BM_GetBooks(benchmark::State& state) {
+    const auto page = getGroupPage(state.range(0));
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto bookList = parser::getBooks(page);
+        books += bookList.size();
+        benchmark::DoNotOptimize(bookList);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_GetBooks)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_GetBookViews(benchmark::State& state) {
+    const auto page = getGroupPage(state.range(0));
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto bookList = parser::getBookViews(page);
+        books += bookList.size();
+        benchmark::DoNotOptimize(bookList);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    setBytesProcessed(state, page.size());
+}
+BENCHMARK(BM_GetBookViews)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_GetBookGroupListCorpus(benchmark::State& state) {
+    const auto pages = getCorpus();
+    if (pages.empty()) {
+        state.SkipWithError("SAMLIB_BENCH_CORPUS is not set or has no *.shtml pages");
+        return;
+    }
+
+    std::size_t bytes = 0;
+    unsigned long books = 0;
+    for (auto _ : state) {
+        for (const auto& page : pages) {
+            const auto groups = parser::getBookGroupList(page);
+            books += countBooks(groups);
+            bytes += page.size();
+            benchmark::DoNotOptimize(groups);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_GetBookGroupListCorpus);
+
+static void BM_GetBookGroupViewsCorpus(benchmark::State& state) {
+    const auto pages = getCorpus();
+    if (pages.empty()) {
+        state.SkipWithError("SAMLIB_BENCH_CORPUS is not set or has no *.shtml pages");
+        return;
+    }
+    executor::Executor pool(static_cast<unsigned int>(state.range(0)));
+
+    std::size_t bytes = 0;
+    unsigned long books = 0;
+    for (auto _ : state) {
+        for (const auto& page : pages) {
+            const auto groups = parser::getBookGroupViews(page, parser::DEFAULT_BOOK_GROUPS_PATTERN,
+                                                          std::pmr::get_default_resource(), pool);
+            books += countBooks(groups);
+            bytes += page.size();
+            benchmark::DoNotOptimize(groups);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_GetBookGroupViewsCorpus)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// decode + parse of a batch of the author pages on the executor of the given number of workers, one task per page
+static void BM_ParsePagesOnExecutor(benchmark::State& state) {
+    const std::vector<std::string> pages(64, getRawAuthorPage(100));
+    executor::Executor pool(static_cast<unsigned int>(state.range(0)));
+
+    unsigned long books = 0;
+    for (auto _ : state) {
+        executor::TaskGroup group(pool);
+        std::vector<std::future<unsigned long>> results;
+        results.reserve(pages.size());
+        for (const auto& page : pages) {
+            results.push_back(group.submit([&page] {
+                const auto content = http::toUtf8(page);
+                return countBooks(parser::getBookGroupViews(content));
+            }));
+        }
+        group.wait();
+        for (auto& result : results) {
+            books += result.get();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pages.size()));
+    setBytesProcessed(state, pages.size() * pages.front().size());
+    state.counters["books"] = static_cast<double>(books);
+}
+BENCHMARK(BM_ParsePagesOnExecutor)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+static void BM_TextCleanerClean(benchmark::State& state) {
+    const parser::TextCleaner cleaner;
+    const std::string description = "<font color=\"#555555\">Описание книги&nbsp;&#8212; <i>синтетика</i>,<br>"
+                                    "которая    продолжается <b>на второй</b> строке<dd>и третьей.  </font>";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cleaner.clean(description));
+    }
+    state.SetItemsProcessed(state.iterations());
+    setBytesProcessed(state, description.size());
+}
+BENCHMARK(BM_TextCleanerClean);
+
+// the former implementation of TextCleaner::clean(), the reference of cleanHtml()
+static std::string cleanByRegex(const std::string& text) {
+    static const std::regex reHtmlTags("<\\/?(\\S+?)[^>]*?>", std::regex_constants::multiline | std::regex_constants::icase);
+    static const std::regex reHtmlNewLine("<dd>|<br/?>", std::regex_constants::multiline | std::regex_constants::icase);
+    static const std::regex reMultipleSpaces("\\s{2,}", std::regex_constants::multiline);
+
+    std::string cleanText = std::regex_replace(text, reHtmlNewLine, "\n");
+    cleanText = std::regex_replace(cleanText, reHtmlTags, "");
+    cleanText = std::regex_replace(cleanText, reMultipleSpaces, " ");
+    trim(cleanText, [](unsigned char ch){return ch != ' ';});
+
+    const std::string search = "&#8212;";
+    for (std::size_t position = 0; (position = cleanText.find(search, position)) != std::string::npos; position++) {
+        cleanText.replace(position, search.size(), "-");
+    }
+    return cleanText;
+}
+
+static void BM_CleanByRegex(benchmark::State& state) {
+    const std::string description = "<font color=\"#555555\">Описание книги&nbsp;&#8212; <i>синтетика</i>,<br>"
+                                    "которая    продолжается <b>на второй</b> строке<dd>и третьей.  </font>";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cleanByRegex(description));
+    }
+    state.SetItemsProcessed(state.iterations());
+    setBytesProcessed(state, description.size());
+}
+BENCHMARK(BM_CleanByRegex);
+
+// the descriptions of the mock pages and the random mixes of the markup, including the broken one
+static std::vector<std::string> getCleanerInputs() {
+    std::vector<std::string> inputs;
+    const auto page = getAuthorPage(100);
+    for (const auto& group : parser::getBookGroupViews(page)) {
+        for (const auto& book : group.books) {
+            inputs.emplace_back(book.description);
+        }
+    }
+
+    const std::vector<std::string> pieces = {
+        "<", ">", "/", "<br>", "<BR/>", "<bR", "<br/", "<dd>", "<Dd>", "<b>", "</i>", "< b>", "</ >", "<>", "</>",
+        " ", "  ", "\t", "\n", "\r\n", "\v", "&#8212;", "&#82", "12;", ";", "&", "-", "a", "Я", "текст", "<a href=x>",
+    };
+    std::minstd_rand random(2024);
+    for (unsigned int i = 0; i < 20000; i++) {
+        std::string input;
+        for (auto count = random() % 24; count > 0; count--) {
+            input += pieces[random() % pieces.size()];
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    return inputs;
+}
+
+// the differential check of cleanHtml(): the benchmark fails if its result differs from the one of the regexes
+static void BM_CleanHtmlMatchesRegex(benchmark::State& state) {
+    const auto inputs = getCleanerInputs();
+    for (const auto& input : inputs) {
+        if (cleanHtml(input) != cleanByRegex(input)) {
+            state.SkipWithError(("cleanHtml() differs from the regexes on \"" + input + "\"").c_str());
+            return;
+        }
+    }
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        for (const auto& input : inputs) {
+            benchmark::DoNotOptimize(cleanHtml(input));
+            bytes += input.size();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * inputs.size()));
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_CleanHtmlMatchesRegex);
+
+static void BM_ReplaceAll(benchmark::State& state) {
+    std::string text;
+    for (int i = 0; i < state.range(0); i++) {
+        text += "слово&#8212;";
+    }
+    for (auto _ : state) {
+        auto copy = text;
+        replaceAll(copy, "&#8212;", "-");
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    setBytesProcessed(state, text.size());
+}
+BENCHMARK(BM_ReplaceAll)->Arg(10)->Arg(1000)->Arg(100000);
+
+static void BM_TrimCopy(benchmark::State& state) {
+    const std::string title = " \t  Книга с длинным названием для проверки \r\n";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(trim_copy(title, noisyChar));
+    }
+    state.SetItemsProcessed(state.iterations());
+    setBytesProcessed(state, title.size());
+}
+BENCHMARK(BM_TrimCopy);
+
+static void BM_NoisyChar(benchmark::State& state) {
+    const std::string text = getAuthorPage(10);
+    for (auto _ : state) {
+        unsigned long count = 0;
+        for (const unsigned char ch : text) {
+            count += noisyChar(ch);
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    setBytesProcessed(state, text.size());
+}
+BENCHMARK(BM_NoisyChar);
+
+
+/**
+ * @brief In-memory DB with the author and his books parsed from the mock page.
+ */
+class DBFixture : public benchmark::Fixture {
+    protected:
+        std::shared_ptr<db::Connection> _con;
+        std::shared_ptr<db::DB<db::Author>> _tAuthor;
+        std::shared_ptr<db::DB<db::GroupBook>> _tGroup;
+        std::shared_ptr<db::DB<db::Book>> _tBook;
+        std::ostringstream _log;
+        std::unique_ptr<miner::Miner> _miner;
+        db::AuthorData _author;
+        std::string _page;
+        parser::BookGroupViewsList _webGroups;  // references the `_page`
+
+    public:
+        void SetUp(const benchmark::State& state) override {
+            this->_con = std::make_shared<db::Connection>(":memory:");
+            this->_tAuthor = std::make_shared<db::DB<db::Author>>(this->_con);
+            this->_tGroup = std::make_shared<db::DB<db::GroupBook>>(this->_con);
+            this->_tBook = std::make_shared<db::DB<db::Book>>(this->_con);
+            this->_tAuthor->createTable();
+            this->_tGroup->createTable();
+            this->_tBook->createTable();
+
+            const auto logger = std::make_shared<logger::Logger>(
+                &this->_log, std::make_unique<logger::ISO8601LogFormatter>(), logger::LogLevel::Error
+            );
+            this->_miner = std::make_unique<miner::Miner>(
+                this->_con, logger, this->_tAuthor, this->_tGroup, this->_tBook
+            );
+
+            db::AuthorData author;
+            author.name = "Автор 1";
+            author.url = "/a/author_1/";
+            author.is_new = false;
+            author.mtime = 0;
+            this->_author = this->_tAuthor->add(author);
+
+            this->_page = getAuthorPage(state.range(0));
+            this->_webGroups = parser::getBookGroupViews(this->_page);
+        }
+
+        void TearDown(const benchmark::State&) override {
+            this->_miner.reset();
+            this->_tBook.reset();
+            this->_tGroup.reset();
+            this->_tAuthor.reset();
+            this->_con.reset();
+        }
+
+        void populate() {
+            auto diff = this->_miner->getDifference(this->_author, {}, {}, this->_webGroups);
+            this->_miner->apply(diff, this->_author);
+        }
+};
+
+BENCHMARK_DEFINE_F(DBFixture, BM_AddBooks)(benchmark::State& state) {
+    auto books = this->_miner->getDifference(this->_author, {}, {}, this->_webGroups).added.books;
+    for (auto& book : books) {
+        book.group_id = 0;  // the groups don't exist in the DB
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(this->_tBook->add(books));
+
+        state.PauseTiming();
+        this->_tBook->remove(db::WhereAny());
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * books.size()));
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_AddBooks)->Arg(10)->Arg(100);
+
+BENCHMARK_DEFINE_F(DBFixture, BM_RetrieveBooks)(benchmark::State& state) {
+    this->populate();
+    const auto criteria = db::WhereAuthorIs(this->_author);
+
+    unsigned long books = 0;
+    for (auto _ : state) {
+        const auto stored = this->_tBook->retrieve(criteria);
+        books += stored.size();
+        benchmark::DoNotOptimize(stored);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(books));
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_RetrieveBooks)->Arg(10)->Arg(100);
+
+// the usual case: nothing has changed since the last sync
+BENCHMARK_DEFINE_F(DBFixture, BM_GetDifference)(benchmark::State& state) {
+    this->populate();
+    const auto criteria = db::WhereAuthorIs(this->_author);
+    const auto storedBooks = this->_tBook->retrieve(criteria);
+    const auto storedGroups = this->_tGroup->retrieve(criteria);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            this->_miner->getDifference(this->_author, storedBooks, storedGroups, this->_webGroups)
+        );
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * storedBooks.size()));
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_GetDifference)->Arg(10)->Arg(100);
+
+// the stored rows are read and matched in memory (miner::DiffEngine::Registry) ...
+BENCHMARK_DEFINE_F(DBFixture, BM_RetrieveAndDiff)(benchmark::State& state) {
+    this->populate();
+    const auto criteria = db::WhereAuthorIs(this->_author);
+
+    for (auto _ : state) {
+        const auto storedBooks = this->_tBook->retrieve(criteria);
+        const auto storedGroups = this->_tGroup->retrieve(criteria);
+        benchmark::DoNotOptimize(
+            this->_miner->getDifference(this->_author, storedBooks, storedGroups, this->_webGroups)
+        );
+    }
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_RetrieveAndDiff)->Arg(10)->Arg(100);
+
+// ... vs the web books are matched inside SQLite (miner::DiffEngine::Staging)
+BENCHMARK_DEFINE_F(DBFixture, BM_GetStagedDifference)(benchmark::State& state) {
+    this->populate();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(this->_miner->getStagedDifference(this->_author, this->_webGroups));
+    }
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_GetStagedDifference)->Arg(10)->Arg(100);
+
+// parse -> registries -> diff of an unchanged page, as getUpdates() does it; the second argument enables the arena
+BENCHMARK_DEFINE_F(DBFixture, BM_ParseAndDiff)(benchmark::State& state) {
+    this->populate();
+    const auto criteria = db::WhereAuthorIs(this->_author);
+    const auto storedBooks = this->_tBook->retrieve(criteria);
+    const auto storedGroups = this->_tGroup->retrieve(criteria);
+
+    std::pmr::monotonic_buffer_resource arena(miner::ARENA_INITIAL_SIZE);
+    const auto resource = state.range(1) ? &arena : std::pmr::get_default_resource();
+
+    const auto allocationsBefore = allocationsCount.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        {
+            const auto webGroups = parser::getBookGroupViews(this->_page, parser::DEFAULT_BOOK_GROUPS_PATTERN, resource);
+            benchmark::DoNotOptimize(
+                this->_miner->getDifference(this->_author, storedBooks, storedGroups, webGroups, resource)
+            );
+        }
+        arena.release();
+    }
+    const auto allocations = allocationsCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(allocations), benchmark::Counter::kAvgIterations
+    );
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * storedBooks.size()));
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_ParseAndDiff)->ArgsProduct({{10, 100}, {0, 1}});
+
+// a stored book moves into a group which is new on the page, the second argument enables the staging engine, the
+// third one moves the book to another URL as well (see RenameDetector); it's a regression check as well: the book
+// must be saved with the ID of the new group
+BENCHMARK_DEFINE_F(DBFixture, BM_MoveBookToNewGroup)(benchmark::State& state) {
+    const std::string newGroupName = "New group";
+    const auto movedUrl = "moved_" + std::string(this->_webGroups.front().books.front().url);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        this->_tBook->remove(db::WhereAny());
+        this->_tGroup->remove(db::WhereAny());
+        this->populate();
+
+        auto webGroups = this->_webGroups;
+        auto& newGroup = webGroups.emplace_back();
+        newGroup.name = newGroupName;
+        newGroup.books.push_back(webGroups.front().books.front());
+        webGroups.front().books.erase(webGroups.front().books.begin());
+        if (state.range(2)) {
+            newGroup.books.front().url = movedUrl;
+        }
+
+        const auto criteria = db::WhereAuthorIs(this->_author);
+        const auto storedBooks = this->_tBook->retrieve(criteria);
+        const auto storedGroups = this->_tGroup->retrieve(criteria);
+        const auto& movedBook = storedBooks.front();
+        state.ResumeTiming();
+
+        auto diff = state.range(1)
+                    ? this->_miner->getStagedDifference(this->_author, webGroups)
+                    : this->_miner->getDifference(this->_author, storedBooks, storedGroups, webGroups);
+        try {
+            this->_miner->apply(diff, this->_author);
+        } catch (const db::DBError& err) {
+            state.SkipWithError((std::string("the moved book isn't saved: ") + err.what()).c_str());
+            break;
+        }
+
+        state.PauseTiming();
+        const auto groups = this->_tGroup->retrieve(criteria);
+        const auto group = std::find_if(groups.begin(), groups.end(), [&](const auto& item) {
+            return item.name == newGroupName;
+        });
+        const auto books = this->_tBook->retrieve(db::WhereMe(movedBook.id));
+        if (group == groups.end() || books.size() != 1 || books.front().group_id != group->id) {
+            state.SkipWithError("the moved book isn't saved into the new group");
+            break;
+        }
+        state.ResumeTiming();
+    }
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_MoveBookToNewGroup)->ArgsProduct({{10}, {0, 1}, {0, 1}});
+
+// the last book of a group is replaced by the next one, e.g. "Книга 0_9" by "Книга 0_10"; it's a regression check of
+// RenameDetector as well: the new book must not be taken for the removed one, even if their sizes are the same
+BENCHMARK_DEFINE_F(DBFixture, BM_ReplaceBookByNext)(benchmark::State& state) {
+    this->populate();
+    const auto criteria = db::WhereAuthorIs(this->_author);
+    const auto storedBooks = this->_tBook->retrieve(criteria);
+    const auto storedGroups = this->_tGroup->retrieve(criteria);
+
+    auto webGroups = this->_webGroups;
+    auto& books = webGroups.front().books;
+    const auto nextTitle = std::string(books.back().title.substr(0, books.back().title.rfind('_') + 1))
+                           + std::to_string(books.size());
+    const auto nextUrl = "next_" + std::string(books.back().url);
+    books.back().title = nextTitle;
+    books.back().url = nextUrl;
+
+    for (auto _ : state) {
+        const auto diff = this->_miner->getDifference(this->_author, storedBooks, storedGroups, webGroups);
+        if (diff.added.books.size() != 1 || diff.removed.books.size() != 1 || !diff.updated.books.empty()) {
+            state.SkipWithError(("\"" + nextTitle + "\" is taken for the removed book").c_str());
+            break;
+        }
+    }
+}
+BENCHMARK_REGISTER_F(DBFixture, BM_ReplaceBookByNext)->Arg(10);
+
+BENCHMARK_MAIN();
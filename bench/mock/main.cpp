@@ -0,0 +1,54 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <csignal>
+#include <iostream>
+#include "mock_server.h"
+#include "options.h"
+
+static std::atomic<bool> isInterrupted{false};
+
+/**
+ * Standalone mock of the SamLib site, e.g. to try the CLI against it:
+ *     samlib-mock-server --port=8080 --latency-ms=50
+ */
+int main(int argc, char** argv) {
+    const bench::Options options(argc, argv);
+    if (options.has("help")) {
+        std::cout << "Usage: " << argv[0] << " [--port=N] " << bench::SITE_OPTIONS_HELP << std::endl;
+        return 0;
+    }
+
+    try {
+        mock::MockServer server(options.getSiteSettings(), options.get("port", 0u));
+        std::cout << "Serving the synthetic site on http://" << server.getDomain() << "/ (Ctrl+C to stop)"
+                  << std::endl;
+
+        std::signal(SIGINT, [](int) { isInterrupted.store(true); });
+        std::signal(SIGTERM, [](int) { isInterrupted.store(true); });
+        while (!isInterrupted.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        std::cout << "Served " << server.getRequestsCount() << " request(s), " << server.getThrottledCount()
+                  << " of them throttled." << std::endl;
+    } catch (const SamLibError& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
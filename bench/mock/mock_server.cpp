@@ -0,0 +1,377 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iconv.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <random>
+#include <regex>
+#include <sstream>
+#include "mock_server.h"
+
+using namespace mock;
+
+static const std::size_t MAX_REQUEST_SIZE = 8 * 1024;
+
+
+std::string mock::toCp1251(const std::string& text) {
+    iconv_t descriptor = iconv_open("WINDOWS-1251", "UTF-8");
+    if (descriptor == (iconv_t) - 1) {
+        throw MockServerError("iconv open failed");
+    }
+
+    std::string result(text.size(), '\0');  // cp1251 text is never longer than UTF-8 one
+    auto inBuf = const_cast<char*>(text.data());
+    auto inSize = text.size();
+    auto outBuf = result.data();
+    auto outSize = result.size();
+
+    const auto status = iconv(descriptor, &inBuf, &inSize, &outBuf, &outSize);
+    iconv_close(descriptor);
+    if (status == (size_t) - 1) {
+        throw MockServerError("iconv failed");
+    }
+
+    result.resize(result.size() - outSize);
+    return result;
+}
+
+
+Site::Site(const SiteSettings& settings) : _settings(settings) {
+    const auto paragraph = toCp1251(
+        "<p>Синтетический текст книги для измерения скорости синхронизации, "
+        "some latin words &#8212; and an entity.<br>\n"
+    );
+
+    this->_bookText.reserve(this->_settings.bookSize + paragraph.size());
+    while (this->_bookText.size() < this->_settings.bookSize) {
+        this->_bookText += paragraph;
+    }
+    this->_bookText.resize(this->_settings.bookSize);
+}
+
+unsigned int Site::_getBooksCount(unsigned int group, unsigned int revision) const {
+    return this->_settings.booksPerGroup + (group == 0 ? revision : 0);
+}
+
+std::string Site::_getBookLine(unsigned int group, unsigned int book, unsigned int revision) const {
+    const auto size = this->_settings.bookSize / 1024 + 1 + (book % 3 == 0 ? revision : 0);
+    const auto id = std::to_string(group) + "_" + std::to_string(book);
+
+    return "<DL><DT><li><A HREF=book_" + id + ".shtml><b>Книга " + id + "</b></A> &nbsp; <b>"
+         + std::to_string(size) + "k</b> &nbsp; <small>Оценка:<b>7.00*3</b> &nbsp; Проза</small><br><DD>"
+         + "<font color=\"#555555\">Описание книги " + id + " &#8212; <i>синтетика</i></font></DL>\n";
+}
+
+std::string Site::getAuthorPage(const std::string& name, unsigned int revision) const {
+    const auto number = name.substr(name.find('_') + 1);
+
+    std::ostringstream page;
+    page << "<html><head><title>Автор " << number << "</title></head><body>\n"
+         << "<h3>Автор " << number << "<br>\n"
+         << "<font color=\"#cc5555\">Синтетический автор " << name << "</font></h3>\n"
+         << "<dl>\n";
+
+    const auto groupsCount = this->_settings.groupsCount + this->_settings.extendedGroupsCount;
+    for (unsigned int group = 0; group < groupsCount; group++) {
+        if (group > 0) {
+            page << "</small><p><font size=+1>\n";
+        }
+
+        if (group < this->_settings.groupsCount) {
+            page << "<a name=gr" << group << ">Группа " << group << "<gr" << group << ">\n";
+            for (unsigned int book = 0; book < this->_getBooksCount(group, revision); book++) {
+                page << this->_getBookLine(group, book, revision);
+            }
+        } else {
+            // the books of the extended group are listed on its own page only
+            page << "<a name=gr" << group << "><a href=index_" << group << ".shtml><font color=#393939>"
+                 << "Расширенная группа " << group << "</font></a><gr" << group << ">\n";
+        }
+    }
+
+    page << "</dl>\n</body></html>\n";
+    return toCp1251(page.str());
+}
+
+std::string Site::getGroupPage(unsigned int group, unsigned int revision) const {
+    std::ostringstream page;
+    page << "<html><head><title>Группа " << group << "</title></head><body>\n<dl>\n";
+    for (unsigned int book = 0; book < this->_getBooksCount(group, revision); book++) {
+        page << this->_getBookLine(group, book, revision);
+    }
+    page << "</dl>\n</body></html>\n";
+
+    return toCp1251(page.str());
+}
+
+std::string Site::getBookPage(const std::string& title) const {
+    return "<html><head><title>" + title + "</title></head><body>\n" + this->_bookText + "\n</body></html>\n";
+}
+
+std::string Site::getBookFile(const std::string& title) const {
+    std::string file(this->_settings.bookSize, '\0');
+    std::uint32_t state = std::hash<std::string>{}(title);
+    for (auto& byte : file) {
+        state = state * 1664525 + 1013904223;  // LCG, it's enough for the incompressible bytes
+        byte = static_cast<char>(state >> 24);
+    }
+
+    return file;
+}
+
+
+MockServer::MockServer(const SiteSettings& settings, unsigned short port) :
+    _site(settings),
+    _latency(settings.latency),
+    _rateLimit(settings.rateLimit),
+    _failureRate(settings.failureRate),
+    _isGzipEnabled(settings.gzip),
+    _socket(-1),
+    _port(port),
+    _isStopping(false),
+    _revision(0),
+    _requestsCount(0),
+    _bytesSent(0),
+    _throttledCount(0),
+    _tokens(std::max(settings.rateLimit, 1.0)),
+    _lastRefill(std::chrono::steady_clock::now())
+{
+    this->_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (this->_socket < 0) {
+        throw MockServerError(std::string("cannot create socket: ") + std::strerror(errno));
+    }
+
+    const int reuse = 1;
+    setsockopt(this->_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    socklen_t addressLength = sizeof(address);
+    if (bind(this->_socket, reinterpret_cast<sockaddr*>(&address), addressLength) < 0
+        || listen(this->_socket, SOMAXCONN) < 0
+        || getsockname(this->_socket, reinterpret_cast<sockaddr*>(&address), &addressLength) < 0
+    ) {
+        const auto error = std::string(std::strerror(errno));
+        close(this->_socket);
+        throw MockServerError("cannot listen on port " + std::to_string(port) + ": " + error);
+    }
+    this->_port = ntohs(address.sin_port);
+
+    for (unsigned int i = 0; i < std::max(settings.threadsCount, 1u); i++) {
+        this->_workers.emplace_back(&MockServer::_serve, this);
+    }
+}
+
+MockServer::~MockServer() {
+    this->stop();
+}
+
+void MockServer::stop() {
+    if (this->_isStopping.exchange(true)) {
+        return;
+    }
+
+    shutdown(this->_socket, SHUT_RDWR);  // wakes up the workers blocked in `accept`
+    for (auto& worker : this->_workers) {
+        worker.join();
+    }
+    close(this->_socket);
+}
+
+std::string MockServer::getDomain() const {
+    return "127.0.0.1:" + std::to_string(this->_port);
+}
+
+void MockServer::_serve() {
+    while (!this->_isStopping.load()) {
+        const int connection = accept(this->_socket, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+
+        this->_handle(connection);
+        close(connection);
+    }
+}
+
+std::string mock::gzip(const std::string& data) {
+    z_stream stream{};
+    // 15 bits of the window plus 16 means the gzip wrapper instead of the zlib one
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw MockServerError("deflateInit2 failed");
+    }
+
+    std::string result(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = result.size();
+
+    const auto status = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        throw MockServerError("deflate failed");
+    }
+
+    result.resize(stream.total_out);
+    return result;
+}
+
+// e.g. "Accept-Encoding: deflate, gzip, br, zstd"
+static bool acceptsGzip(const std::string& request) {
+    std::string headers(request.size(), '\0');
+    std::transform(request.begin(), request.end(), headers.begin(), [](unsigned char ch) {return std::tolower(ch);});
+
+    const auto header = headers.find("\r\naccept-encoding:");
+    if (header == std::string::npos) {
+        return false;
+    }
+    const auto value = headers.substr(header, headers.find("\r\n", header + 2) - header);
+    return value.find("gzip") != std::string::npos;
+}
+
+void MockServer::_handle(int connection) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        const auto received = recv(connection, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    // e.g. "GET /a/author_1/ HTTP/1.1"
+    const auto pathStart = request.find(' ') + 1;
+    const auto pathEnd = request.find(' ', pathStart);
+    const auto path = pathStart > 0 && pathEnd != std::string::npos
+        ? request.substr(pathStart, pathEnd - pathStart)
+        : std::string{};
+
+    if (this->_latency.count() > 0) {
+        std::this_thread::sleep_for(this->_latency);
+    }
+
+    const auto isThrottled = this->_isThrottled();
+    auto [status, body] = isThrottled ? std::pair{429, std::string{}}
+                        : this->_isFailed() ? std::pair{500, std::string{}}
+                        : this->_getResponse(path);
+
+    const auto isCompressed = this->_isGzipEnabled && status == 200 && !path.ends_with(".zip")
+                           && acceptsGzip(request);
+    if (isCompressed) {
+        body = gzip(body);
+    }
+
+    const auto statusLine = status == 200 ? "200 OK"
+                          : status == 429 ? "429 Too Many Requests"
+                          : status == 500 ? "500 Internal Server Error"
+                          : "404 Not Found";
+    const auto header = std::string("HTTP/1.1 ") + statusLine + "\r\n"
+                      + (isThrottled ? "Retry-After: 1\r\n" : "")
+                      + (isCompressed ? "Content-Encoding: gzip\r\n" : "")
+                      + "Content-Type: text/html; charset=windows-1251\r\n"
+                      + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                      + "Connection: close\r\n\r\n";
+
+    const auto response = header + body;
+    std::size_t sent = 0;
+    while (sent < response.size()) {
+        const auto result = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            break;
+        }
+        sent += result;
+    }
+
+    this->_requestsCount++;
+    this->_bytesSent += sent;
+}
+
+// a token bucket: up to `rateLimit` requests at once and `rateLimit` requests per second on average
+bool MockServer::_isThrottled() {
+    if (this->_rateLimit <= 0) {
+        return false;
+    }
+
+    const std::lock_guard lock(this->_rateMutex);
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - this->_lastRefill;
+    this->_tokens = std::min(std::max(this->_rateLimit, 1.0), this->_tokens + elapsed.count() * this->_rateLimit);
+    this->_lastRefill = now;
+
+    if (this->_tokens < 1) {
+        this->_throttledCount++;
+        return true;
+    }
+
+    this->_tokens -= 1;
+    return false;
+}
+
+bool MockServer::_isFailed() const {
+    if (this->_failureRate <= 0) {
+        return false;
+    }
+
+    thread_local std::mt19937 generator{std::random_device{}()};
+    return std::uniform_real_distribution<double>(0, 1)(generator) < this->_failureRate;
+}
+
+std::pair<int, std::string> MockServer::_getResponse(const std::string& path) const {
+    static const std::regex rePath(R"(^/+([a-z])/+([a-z0-9_-]+)/*(.*)$)");
+    static const std::regex reGroup(R"(^index_(\d+)\.shtml$)");
+    static const std::regex reBook(R"(^(book_\d+_\d+)\.(shtml|fb2\.zip)$)");
+
+    std::smatch matches;
+    if (!std::regex_match(path, matches, rePath)) {
+        return {404, ""};
+    }
+
+    const auto name = matches[2].str();
+    const auto resource = matches[3].str();
+    const auto revision = this->_revision.load();
+
+    if (resource.empty() || resource == "index.shtml") {
+        return {200, this->_site.getAuthorPage(name, revision)};
+    }
+
+    if (std::regex_match(resource, matches, reGroup)) {
+        const auto& settings = this->_site.getSettings();
+        const auto group = std::stoul(matches[1].str());
+        if (group < settings.groupsCount || group >= settings.groupsCount + settings.extendedGroupsCount) {
+            return {404, ""};
+        }
+        return {200, this->_site.getGroupPage(group, revision)};
+    }
+
+    if (std::regex_match(resource, matches, reBook)) {
+        return matches[2] == "shtml"
+            ? std::pair{200, this->_site.getBookPage(matches[1].str())}
+            : std::pair{200, this->_site.getBookFile(matches[1].str())};
+    }
+
+    return {404, ""};
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_MOCK_SERVER_H
+#define SAMLIBINFO_MOCK_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "errors.h"
+
+/**
+ * Local HTTP server which imitates the SamLib site with synthetic pages, so the sync can be measured without
+ * the network and the live site.
+ *
+ * Every author exists, e.g. `/a/author_1/` is the page of the author "Автор 1". The pages are encoded in cp1251,
+ * just like the real ones:
+ *     /x/name/                   the author's page with the plain and the extended groups
+ *     /x/name/index_N.shtml      the page of the extended group #N
+ *     /x/name/book_G_B.shtml     the text of the book #B from the group #G
+ *     /x/name/book_G_B.fb2.zip   the same book in "FB2" (random bytes in fact)
+ */
+namespace mock {
+    class MockServerError : public SamLibError {
+        public:
+            explicit MockServerError(const std::string& arg) : SamLibError("MockServerError: " + arg) {}
+    };
+
+    struct SiteSettings {
+        unsigned int groupsCount = 3;           // plain groups on the author's page
+        unsigned int extendedGroupsCount = 1;   // groups which books are listed on separate pages
+        unsigned int booksPerGroup = 10;
+        std::size_t bookSize = 32 * 1024;       // size of the book's text in bytes
+        std::chrono::milliseconds latency{0};   // delay before every response
+        unsigned int threadsCount = 4;
+        double rateLimit = 0;                   // requests per second before "429 Too Many Requests", 0 is unlimited
+        double failureRate = 0;                 // part of the requests answered "500 Internal Server Error"
+        bool gzip = true;                       // compress the pages if the client accepts gzip
+    };
+
+    /**
+     * @brief Renders the pages of the synthetic site (in cp1251).
+     *
+     * The revision changes the site: every revision adds one book to the first group of every author and
+     * increases size of every third book, so the sync on the next revision finds new and updated books.
+     */
+    class Site {
+        private:
+            const SiteSettings _settings;
+            std::string _bookText;  // the text of every book, it's rendered once
+
+            [[nodiscard]] std::string _getBookLine(unsigned int group, unsigned int book, unsigned int revision) const;
+            [[nodiscard]] unsigned int _getBooksCount(unsigned int group, unsigned int revision) const;
+
+        public:
+            explicit Site(const SiteSettings& settings);
+
+            [[nodiscard]] const SiteSettings& getSettings() const { return this->_settings; }
+
+            [[nodiscard]] std::string getAuthorPage(const std::string& name, unsigned int revision) const;
+            [[nodiscard]] std::string getGroupPage(unsigned int group, unsigned int revision) const;
+            [[nodiscard]] std::string getBookPage(const std::string& title) const;
+            [[nodiscard]] std::string getBookFile(const std::string& title) const;
+    };
+
+    /**
+     * @brief Converts the UTF-8 text to cp1251.
+     *
+     * @throw MockServerError
+     */
+    std::string toCp1251(const std::string& text);
+
+    /**
+     * @brief Compresses the data into the gzip format (i.e. `Content-Encoding: gzip`).
+     *
+     * @throw MockServerError
+     */
+    std::string gzip(const std::string& data);
+
+    class MockServer {
+        private:
+            const Site _site;
+            const std::chrono::milliseconds _latency;
+            const double _rateLimit;
+            const double _failureRate;
+            const bool _isGzipEnabled;
+            int _socket;
+            unsigned short _port;
+            std::vector<std::thread> _workers;
+            std::atomic<bool> _isStopping;
+            std::atomic<unsigned int> _revision;
+            std::atomic<unsigned long> _requestsCount;
+            std::atomic<unsigned long long> _bytesSent;
+            std::atomic<unsigned long> _throttledCount;
+            std::mutex _rateMutex;
+            double _tokens;
+            std::chrono::steady_clock::time_point _lastRefill;
+
+            void _serve();
+            bool _isThrottled();
+            [[nodiscard]] bool _isFailed() const;
+            void _handle(int connection);
+            [[nodiscard]] std::pair<int, std::string> _getResponse(const std::string& path) const;
+
+        public:
+            /**
+             * @brief Starts the server on the loopback interface.
+             *
+             * @param settings The shape of the synthetic site
+             * @param port The port to listen on, the free one is chosen if it's 0 (see getPort())
+             *
+             * @throw MockServerError if the server cannot be started
+             */
+            explicit MockServer(const SiteSettings& settings, unsigned short port = 0);
+            ~MockServer();
+
+            MockServer(const MockServer&) = delete;
+            MockServer& operator=(const MockServer&) = delete;
+
+            void stop();
+
+            [[nodiscard]] unsigned short getPort() const { return this->_port; }
+
+            /**
+             * @return host and port of the server for `http::Settings::domain`, e.g. "127.0.0.1:8080"
+             */
+            [[nodiscard]] std::string getDomain() const;
+
+            void setRevision(unsigned int revision) { this->_revision.store(revision); }
+            [[nodiscard]] unsigned long getRequestsCount() const { return this->_requestsCount.load(); }
+            [[nodiscard]] unsigned long long getBytesSent() const { return this->_bytesSent.load(); }
+            [[nodiscard]] unsigned long getThrottledCount() const { return this->_throttledCount.load(); }
+    };
+}
+
+#endif //SAMLIBINFO_MOCK_SERVER_H
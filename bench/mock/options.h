@@ -0,0 +1,107 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_BENCH_OPTIONS_H
+#define SAMLIBINFO_BENCH_OPTIONS_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mock_server.h"
+
+namespace bench {
+    const auto SITE_OPTIONS_HELP =
+        "[--groups=N] [--extended-groups=N] [--books-per-group=N] [--book-size=BYTES] [--latency-ms=N] [--threads=N] "
+        "[--rate-limit=RPS] [--failure-rate=0..1] [--gzip=0|1]";
+
+    /**
+     * @brief Minimal parser of the `--key=value` command line options of the benchmark tools.
+     */
+    class Options {
+        private:
+            std::map<std::string, std::string> _values;
+
+        public:
+            Options(int argc, char** argv) {
+                for (int i = 1; i < argc; i++) {
+                    std::string argument = argv[i];
+                    if (!argument.starts_with("--")) {
+                        continue;
+                    }
+
+                    const auto separator = argument.find('=');
+                    if (separator == std::string::npos) {
+                        this->_values[argument.substr(2)] = "";
+                    } else {
+                        this->_values[argument.substr(2, separator - 2)] = argument.substr(separator + 1);
+                    }
+                }
+            }
+
+            [[nodiscard]] bool has(const std::string& key) const {
+                return this->_values.contains(key);
+            }
+
+            template <typename T>
+            [[nodiscard]] T get(const std::string& key, T defaultValue) const {
+                const auto value = this->_values.find(key);
+                if (value == this->_values.end()) {
+                    return defaultValue;
+                }
+
+                T result;
+                std::istringstream(value->second) >> result;
+                return result;
+            }
+
+            /**
+             * @brief Returns the comma separated list of numbers, e.g. `--authors=10,100,1000`
+             */
+            [[nodiscard]] std::vector<unsigned int> getList(const std::string& key,
+                                                            const std::vector<unsigned int>& defaultValue) const {
+                const auto value = this->_values.find(key);
+                if (value == this->_values.end()) {
+                    return defaultValue;
+                }
+
+                std::vector<unsigned int> result;
+                std::istringstream stream(value->second);
+                std::string item;
+                while (std::getline(stream, item, ',')) {
+                    result.push_back(std::stoul(item));
+                }
+                return result;
+            }
+
+            [[nodiscard]] mock::SiteSettings getSiteSettings() const {
+                mock::SiteSettings settings;
+                settings.groupsCount = this->get("groups", settings.groupsCount);
+                settings.extendedGroupsCount = this->get("extended-groups", settings.extendedGroupsCount);
+                settings.booksPerGroup = this->get("books-per-group", settings.booksPerGroup);
+                settings.bookSize = this->get("book-size", settings.bookSize);
+                settings.latency = std::chrono::milliseconds(this->get("latency-ms", 0L));
+                settings.threadsCount = this->get("threads", settings.threadsCount);
+                settings.rateLimit = this->get("rate-limit", settings.rateLimit);
+                settings.failureRate = this->get("failure-rate", settings.failureRate);
+                settings.gzip = this->get("gzip", settings.gzip);
+                return settings;
+            }
+    };
+}
+
+#endif //SAMLIBINFO_BENCH_OPTIONS_H
@@ -23,7 +23,10 @@
 #include <boost/program_options.hpp>
 #include <boost/locale.hpp>
 #include "agent.h"
+#include "daemon.h"
 #include "db.h"
+#include "http.h"
+#include "stats.h"
 
 namespace po = boost::program_options;
 
@@ -205,6 +208,31 @@ struct isValidListTarget {
     }
 };
 
+struct isValidDiffEngine {
+    void operator()(const std::string& v) const {
+        if(v != "registry" && v != "staging" && v != "verify") {
+            throw po::validation_error(po::validation_error::invalid_option_value);
+        }
+    }
+};
+
+struct isValidSite {
+    void operator()(const std::string& v) const {
+        const auto separator = v.find("://");
+        if (separator == std::string::npos || separator == 0 || separator + 3 >= v.size()) {
+            throw po::validation_error(po::validation_error::invalid_option_value);
+        }
+    }
+};
+
+struct isNonNegative {
+    void operator()(double v) const {
+        if (v < 0) {
+            throw po::validation_error(po::validation_error::invalid_option_value);
+        }
+    }
+};
+
 struct isValidMarkAction {
     void operator()(const std::string& v) const {
         if(v != "read" && v != "r" && v != "unread" && v != "u") {
@@ -359,12 +387,17 @@ void handleShow(const po::variables_map& vm, const std::unique_ptr<agent::Agent>
     }
 }
 
-int main(int argc, char **argv) {
-    // Define and parse the program options
+// the options which set up the whole process, so the daemon uses the ones it's started with
+const std::vector<std::string> PROCESS_OPTIONS = {"site", "requests-per-second", "max-connections", "retries", "log-json"};
+
+po::options_description getOptions() {
     po::options_description desc("I know how to");
     desc.add_options()
             ("help", "Show this help messages")
             ("check-updates,u", "Check for updates on all registered authors")
+            ("check-due", "Check for updates only the authors that are due according to their usual update rate")
+            ("unread-first", "Check the authors with unread updates first (for the `--check-due`)")
+            ("resume", "Continue the interrupted `--check-updates` instead of starting from the first author")
             ("add", po::value<std::string>(), "Add new author")
             ("remove", po::value<unsigned int>(), "Remove author with given ID")
             (
@@ -383,6 +416,53 @@ int main(int argc, char **argv) {
             ("group,g", po::value<unsigned int>(), "GroupID")
             ("new-only,n", "List only new/updated items")
             ("path-only", "Show only path to the local copy of the book with given BookID")
+            ("search", po::value<std::string>(), "Search books by title, description, genre or author's name")
+            ("limit", po::value<unsigned int>()->default_value(20), "Max number of found books to show")
+            ("index-text", "Index text of downloaded books (HTML only) for the `--search`")
+            ("log-json", po::value<std::string>(), "Append detailed log records (JSON lines) to the given file")
+            ("stats", "Show time spent in every stage of the `--check-updates` or `--check-due`")
+            (
+                "sync-workers",
+                po::value<unsigned int>()->default_value(miner::PipelineSettings().fetchWorkers),
+                "How many authors' pages are downloaded at once while the other ones are parsed and saved "
+                "(0 means the authors are checked one by one)"
+            )
+            (
+                "async",
+                po::value<unsigned int>(),
+                "Check the authors by the event loop, up to N of them at once, instead of the pipeline of the "
+                "`--sync-workers` (for the `--check-updates` without the `--resume`)"
+            )
+            (
+                "diff-engine",
+                po::value<std::string>()->default_value("registry")->notifier(isValidDiffEngine()),
+                "How to find the changes on the authors' pages: [registry|staging|verify]. The `staging` matches "
+                "the books inside the DB, the `verify` uses both and reports the differences"
+            )
+            (
+                "site",
+                po::value<std::string>()->notifier(isValidSite()),
+                "Base URL of the site, e.g. a mirror (by default http://samlib.ru)"
+            )
+            (
+                "requests-per-second",
+                po::value<double>()->default_value(http::S_REQUESTS_PER_SECOND)->notifier(isNonNegative()),
+                "Max rate of the requests to the site, it's reduced automatically if the site asks to slow down "
+                "(0 means unlimited)"
+            )
+            (
+                "max-connections",
+                po::value<unsigned int>()->default_value(http::S_MAX_CONNECTIONS),
+                "Max number of simultaneous connections to the site (0 means unlimited)"
+            )
+            (
+                "retries",
+                po::value<unsigned int>()->default_value(http::S_RETRIES),
+                "How many times to repeat a request if the site is temporarily unavailable"
+            )
+            ("daemon", "Keep running and serve the commands of the other calls (the `samlibd` mode)")
+            ("stop-daemon", "Stop the daemon of the `--location`")
+            ("no-daemon", "Run the command by this call even if the daemon is running")
             (
                 "location",
                 po::value<std::filesystem::path>()->default_value("~/.local/share/SamLib/"),
@@ -390,6 +470,159 @@ int main(int argc, char **argv) {
             )
     ;
 
+
+    return desc;
+}
+
+void configureSite(const po::variables_map& vm) {
+    http::Settings siteSettings;
+    if (vm.count("site")) {
+        auto site = vm["site"].as<std::string>();
+        while (site.ends_with("/")) {
+            site.pop_back();
+        }
+        const auto separator = site.find("://");
+        if (separator == std::string::npos || separator == 0 || separator + 3 == site.size()) {
+            throw po::validation_error(po::validation_error::invalid_option_value, "site", site);
+        }
+        siteSettings.protocol = site.substr(0, separator);
+        siteSettings.domain = site.substr(separator + 3);
+    }
+    siteSettings.requestsPerSecond = vm["requests-per-second"].as<double>();
+    siteSettings.maxConnections = vm["max-connections"].as<unsigned int>();
+    siteSettings.retries = vm["retries"].as<unsigned int>();
+    http::configure(siteSettings);
+}
+
+std::shared_ptr<logger::Logger> createLogger(const po::variables_map& vm) {
+    auto logger = std::make_shared<logger::Logger>(
+        &std::cout, std::make_unique<logger::ISO8601LogFormatter>(), logger::LogLevel::Info
+    );
+    if (vm.count("log-json")) {
+        logger->addSink(
+            vm["log-json"].as<std::string>(), std::make_unique<logger::JSONLinesLogFormatter>(),
+            logger::LogLevel::Debug
+        );
+    }
+    return logger;
+}
+
+std::unique_ptr<agent::Agent> createAgent(const po::variables_map& vm, const std::shared_ptr<logger::Logger>& logger) {
+    const auto path = vm["location"].as<std::filesystem::path>();
+    auto agent = std::make_unique<agent::Agent>(path / "samlib.db", path, logger);
+    agent->initDB();
+    return agent;
+}
+
+// every option is set, so the daemon doesn't keep the ones of the previous command
+void configureAgent(const po::variables_map& vm, const std::unique_ptr<agent::Agent>& agent) {
+    agent->setBookTextIndexing(vm.count("index-text"));
+
+    const auto diffEngine = vm["diff-engine"].as<std::string>();
+    if (diffEngine == "staging") {
+        agent->setDiffEngine(miner::DiffEngine::Staging);
+    } else if (diffEngine == "verify") {
+        agent->setDiffEngine(miner::DiffEngine::Verify);
+    } else {
+        agent->setDiffEngine(miner::DiffEngine::Registry);
+    }
+
+    miner::PipelineSettings pipelineSettings;
+    pipelineSettings.fetchWorkers = vm["sync-workers"].as<unsigned int>();
+    pipelineSettings.isEnabled = pipelineSettings.fetchWorkers > 0;
+    agent->setPipeline(pipelineSettings);
+}
+
+void runCommand(const po::variables_map& vm, const std::unique_ptr<agent::Agent>& agent,
+                const std::shared_ptr<logger::Logger>& logger) {
+    configureAgent(vm, agent);
+
+    if (vm.count("check-updates") || vm.count("check-due")) {
+        // the sync produces most of the log records; other commands print their results into the same stdout,
+        // so they keep logging synchronously to preserve the order of the output
+        logger->startAsync();
+        stats::reset();
+        stats::setEnabled(vm.count("stats"));
+        if (vm.count("check-due")) {
+            agent->checkDueUpdates(vm.count("unread-first"));
+        } else if (vm.count("async") && !vm.count("resume")) {
+            agent::AsyncAgent asyncAgent(*agent);
+            async::run(asyncAgent.checkUpdates(vm["async"].as<unsigned int>()));
+        } else {
+            agent->checkUpdates(vm.count("resume"));
+        }
+
+        if (stats::isEnabled()) {
+            logger->flush();
+            std::cout << std::endl << stats::getReport();
+
+            const auto pipelineStats = agent->getPipelineStats();
+            if (!pipelineStats.empty()) {
+                std::cout << std::endl << pipeline::getReport(pipelineStats);
+            }
+        }
+        logger->stopAsync();
+    }
+    else if (vm.count("add")) {
+        agent->addAuthor(vm["add"].as<std::string>());
+    }
+    else if (vm.count("remove")) {
+        // Note: this action doesn't affect downloaded books! All books of the author that were downloaded
+        //       earlier are left untouched.
+        agent->removeAuthor(vm["remove"].as<unsigned int>());
+    }
+    else if (vm.count("list")) {
+        handleList(vm, agent);
+    }
+    else if (vm.count("mark-as")) {
+        handleMarkAs(vm, agent);
+    }
+    else if (vm.count("show")) {
+        handleShow(vm, agent);
+    }
+    else if (vm.count("search")) {
+        std::cout << agent->search(vm["search"].as<std::string>(), vm["limit"].as<unsigned int>());
+    }
+}
+
+int serveCommands(const po::variables_map& vm, const po::options_description& desc) {
+    configureSite(vm);
+    const auto logger = createLogger(vm);
+    const auto agent = createAgent(vm, logger);
+
+    samlibd::serve(samlibd::getSocketPath(vm["location"].as<std::filesystem::path>()), [&](const auto& args) {
+        try {
+            po::variables_map commandVm;
+            po::store(po::command_line_parser(args).options(desc).run(), commandVm);
+            runCommand(commandVm, agent, logger);
+            po::notify(commandVm);
+        }
+        catch (po::error& e) {
+            logger->stopAsync();
+            std::cerr << "Error: " << e.what() << std::endl << std::endl;
+            std::cerr << desc << std::endl;
+            return -1;
+        }
+        catch (...) {
+            logger->stopAsync();
+            throw;
+        }
+        return 0;
+    }, logger);
+
+    return 0;
+}
+
+// the command is run by the daemon unless it sets up the process differently
+bool isForwarded(const po::variables_map& vm) {
+    return !vm.count("daemon") && !vm.count("stop-daemon") && !vm.count("no-daemon")
+           && std::none_of(PROCESS_OPTIONS.begin(), PROCESS_OPTIONS.end(), [&vm](const auto& name) {
+               return vm.count(name) && !vm[name].defaulted();
+           });
+}
+
+int main(int argc, char **argv) {
+    const auto desc = getOptions();
     po::variables_map vm;
 
     try
@@ -402,33 +635,28 @@ int main(int argc, char **argv) {
             return 0;
         }
 
-        const auto path = vm["location"].as<std::filesystem::path>();
-        auto logger = std::make_shared<logger::Logger>();
-        logger->setLogLevel(logger::LogLevel::Info);
-        auto agent = std::make_unique<agent::Agent>(path / "samlib.db", path, logger);
-        agent->initDB();
-
-        if (vm.count("check-updates")) {
-            agent->checkUpdates();
-        }
-        else if (vm.count("add")) {
-            agent->addAuthor(vm["add"].as<std::string>());
-        }
-        else if (vm.count("remove")) {
-            // Note: this action doesn't affect downloaded books! All books of the author that were downloaded
-            //       earlier are left untouched.
-            agent->removeAuthor(vm["remove"].as<unsigned int>());
+        const auto location = vm["location"].as<std::filesystem::path>();
+        if (vm.count("daemon")) {
+            return serveCommands(vm, desc);
         }
-        else if (vm.count("list")) {
-            handleList(vm, agent);
-        }
-        else if (vm.count("mark-as")) {
-            handleMarkAs(vm, agent);
+        if (vm.count("stop-daemon")) {
+            if (!samlibd::stop(samlibd::getSocketPath(location))) {
+                std::cerr << "The daemon isn't running." << std::endl;
+                return 1;
+            }
+            return 0;
         }
-        else if (vm.count("show")) {
-            handleShow(vm, agent);
+        if (isForwarded(vm)) {
+            if (const auto exitCode = samlibd::forward(samlibd::getSocketPath(location), {argv + 1, argv + argc})) {
+                return *exitCode;
+            }
         }
 
+        configureSite(vm);
+        const auto logger = createLogger(vm);
+        const auto agent = createAgent(vm, logger);
+        runCommand(vm, agent, logger);
+
         // call notify function on each option container to run the assigned tasks
         // it also checks option dependencies and can throw exceptions
         po::notify(vm);
@@ -439,6 +667,11 @@ int main(int argc, char **argv) {
         std::cerr << desc << std::endl;
         return -1;
     }
+    catch(SamLibError& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "daemon.h"
+#include "fs.h"
+
+using namespace samlibd;
+
+namespace {
+    enum class FrameType : char {
+        Request = 'R',
+        Stop = 'S',
+        Accepted = 'A',
+        Out = 'O',
+        Err = 'E',
+        Exit = 'X',
+    };
+
+    struct Frame {
+        FrameType type;
+        std::string payload;
+    };
+
+    const std::size_t FRAME_HEADER_SIZE = 5;
+    const std::uint32_t MAX_REQUEST_SIZE = 1 << 20;
+    const std::size_t OUTPUT_CHUNK_SIZE = 4096;
+    // the daemon serves a single client at a time, so it doesn't wait long for the one which doesn't read or write
+    const timeval REQUEST_TIMEOUT{5, 0};
+    const timeval OUTPUT_TIMEOUT{10, 0};
+    const int BUSY_NOTICE_DELAY_MS = 1000;
+
+    volatile std::sig_atomic_t isStopRequested = 0;
+    int stopPipe = -1;  // the write end of the pipe which wakes up the daemon waiting for a client
+
+    void onStopSignal(int) {
+        isStopRequested = 1;
+        if (stopPipe >= 0) {
+            const auto savedErrno = errno;
+            [[maybe_unused]] const auto written = write(stopPipe, "", 1);
+            errno = savedErrno;
+        }
+    }
+
+    class Socket {
+        private:
+            int _fd;
+
+        public:
+            explicit Socket(int fd = -1) : _fd(fd) {}
+            Socket(Socket&& other) noexcept : _fd(other._fd) {other._fd = -1;}
+
+            ~Socket() {
+                if (this->_fd >= 0) {
+                    close(this->_fd);
+                }
+            }
+
+            Socket(const Socket&) = delete;
+            Socket& operator=(const Socket&) = delete;
+
+            [[nodiscard]] int get() const {return this->_fd;}
+            [[nodiscard]] bool isValid() const {return this->_fd >= 0;}
+    };
+
+    sockaddr_un toAddress(const std::filesystem::path& socketPath) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        const auto path = socketPath.string();
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw DaemonError("the path to the socket is too long: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    Socket connectTo(const std::filesystem::path& socketPath) {
+        sockaddr_un address{};
+        try {
+            address = toAddress(socketPath);
+        } catch (const DaemonError&) {
+            return Socket();    // the daemon couldn't listen on it either
+        }
+
+        Socket connection(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (!connection.isValid()
+            || connect(connection.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            return Socket();
+        }
+        return connection;
+    }
+
+    bool writeAll(int fd, const char* data, std::size_t size) {
+        while (size) {
+            // the client may be gone, it mustn't kill the daemon by SIGPIPE
+            const auto written = send(fd, data, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, std::size_t size) {
+        while (size) {
+            const auto received = recv(fd, data, size, 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                return false;
+            }
+            data += received;
+            size -= static_cast<std::size_t>(received);
+        }
+        return true;
+    }
+
+    void putSize(std::string& out, std::uint32_t size) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>((size >> shift) & 0xFF));
+        }
+    }
+
+    std::uint32_t getSize(const char* data) {
+        std::uint32_t size = 0;
+        for (int i = 0; i < 4; i++) {
+            size = (size << 8) | static_cast<unsigned char>(data[i]);
+        }
+        return size;
+    }
+
+    bool sendFrame(int fd, FrameType type, std::string_view payload) {
+        std::string frame;
+        frame.reserve(FRAME_HEADER_SIZE + payload.size());
+        frame.push_back(static_cast<char>(type));
+        putSize(frame, static_cast<std::uint32_t>(payload.size()));
+        frame.append(payload);
+        return writeAll(fd, frame.data(), frame.size());
+    }
+
+    std::optional<Frame> receiveFrame(int fd, std::uint32_t maxSize = UINT32_MAX) {
+        char header[FRAME_HEADER_SIZE];
+        if (!readAll(fd, header, sizeof(header))) {
+            return std::nullopt;
+        }
+
+        const auto size = getSize(header + 1);
+        if (size > maxSize) {
+            return std::nullopt;
+        }
+
+        Frame frame{static_cast<FrameType>(header[0]), std::string(size, '\0')};
+        if (!readAll(fd, frame.payload.data(), size)) {
+            return std::nullopt;
+        }
+        return frame;
+    }
+
+    std::string encodeRequest(const std::vector<std::string>& args) {
+        std::string payload(1, static_cast<char>(PROTOCOL_VERSION));
+        putSize(payload, static_cast<std::uint32_t>(args.size()));
+        for (const auto& arg : args) {
+            putSize(payload, static_cast<std::uint32_t>(arg.size()));
+            payload.append(arg);
+        }
+        return payload;
+    }
+
+    std::vector<std::string> decodeRequest(const std::string& payload) {
+        if (payload.empty() || static_cast<unsigned char>(payload[0]) != PROTOCOL_VERSION) {
+            throw DaemonError("unsupported version of the protocol, please restart the daemon");
+        }
+
+        std::size_t position = 1;
+        const auto take = [&payload, &position](std::size_t size) {
+            if (payload.size() - position < size) {
+                throw DaemonError("the request is truncated");
+            }
+            position += size;
+            return std::string_view(payload).substr(position - size, size);
+        };
+
+        const auto count = getSize(take(4).data());
+        if (count > payload.size()) {
+            throw DaemonError("the request is malformed");
+        }
+
+        std::vector<std::string> args(count);
+        for (auto& arg : args) {
+            arg = take(getSize(take(4).data()));
+        }
+        return args;
+    }
+
+    // the client of the command which is running now
+    struct Connection {
+        int fd;
+        std::mutex mutex{};   // the logger may write from its own thread
+        bool isBroken = false;
+    };
+
+    /**
+     * The stream buffer which sends the output to the client by frames of the given type, when it's flushed or grows
+     * big enough. If the client is gone or doesn't read the output in time (see OUTPUT_TIMEOUT), it's disconnected and
+     * the output is dropped, so the command still completes.
+     */
+    class FrameBuffer : public std::streambuf {
+        private:
+            Connection& _connection;
+            FrameType _type;
+            std::string _buffer;
+
+            void _send() {
+                if (!this->_connection.isBroken && !this->_buffer.empty()) {
+                    this->_connection.isBroken = !sendFrame(this->_connection.fd, this->_type, this->_buffer);
+                    if (this->_connection.isBroken) {
+                        shutdown(this->_connection.fd, SHUT_RDWR);  // a part of the frame may have been sent
+                    }
+                }
+                this->_buffer.clear();
+            }
+
+        protected:
+            int_type overflow(int_type ch) override {
+                if (traits_type::eq_int_type(ch, traits_type::eof())) {
+                    return traits_type::not_eof(ch);
+                }
+
+                const std::lock_guard lock(this->_connection.mutex);
+                this->_buffer.push_back(traits_type::to_char_type(ch));
+                if (this->_buffer.size() >= OUTPUT_CHUNK_SIZE) {
+                    this->_send();
+                }
+                return ch;
+            }
+
+            std::streamsize xsputn(const char* data, std::streamsize size) override {
+                const std::lock_guard lock(this->_connection.mutex);
+                this->_buffer.append(data, static_cast<std::size_t>(size));
+                if (this->_buffer.size() >= OUTPUT_CHUNK_SIZE) {
+                    this->_send();
+                }
+                return size;
+            }
+
+            int sync() override {
+                const std::lock_guard lock(this->_connection.mutex);
+                this->_send();
+                return 0;
+            }
+
+        public:
+            FrameBuffer(Connection& connection, FrameType type) : _connection(connection), _type(type) {}
+    };
+
+    int runCommand(int fd, const Handler& handler, const std::vector<std::string>& args) {
+        Connection connection{fd};
+        FrameBuffer out(connection, FrameType::Out);
+        FrameBuffer err(connection, FrameType::Err);
+
+        const auto coutBuffer = std::cout.rdbuf(&out);
+        const auto cerrBuffer = std::cerr.rdbuf(&err);
+        int exitCode = 1;
+        try {
+            exitCode = handler(args);
+        } catch (const std::exception& err) {
+            std::cerr << "Error: " << err.what() << std::endl;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        std::cout.clear();
+        std::cerr.clear();
+        return exitCode;
+    }
+
+    bool sendExitCode(int fd, int exitCode) {
+        std::string payload;
+        putSize(payload, static_cast<std::uint32_t>(exitCode));
+        return sendFrame(fd, FrameType::Exit, payload);
+    }
+
+    /**
+     * SIGINT and SIGTERM stop the daemon after the command which it runs now (SA_RESTART keeps the command intact).
+     * The handler writes to a pipe which is polled along with the socket, so the signal isn't lost, whenever it comes.
+     */
+    class StopSignals {
+        private:
+            int _pipe[2]{-1, -1};
+            struct sigaction _previousInt{};
+            struct sigaction _previousTerm{};
+
+        public:
+            StopSignals() {
+                if (pipe2(this->_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+                    throw DaemonError(std::string("cannot create the pipe for the signals: ") + std::strerror(errno));
+                }
+                isStopRequested = 0;
+                stopPipe = this->_pipe[1];
+
+                struct sigaction action{};
+                action.sa_handler = onStopSignal;
+                action.sa_flags = SA_RESTART;
+                sigemptyset(&action.sa_mask);
+                sigaction(SIGINT, &action, &this->_previousInt);
+                sigaction(SIGTERM, &action, &this->_previousTerm);
+            }
+
+            ~StopSignals() {
+                sigaction(SIGINT, &this->_previousInt, nullptr);
+                sigaction(SIGTERM, &this->_previousTerm, nullptr);
+                stopPipe = -1;
+                close(this->_pipe[0]);
+                close(this->_pipe[1]);
+            }
+
+            StopSignals(const StopSignals&) = delete;
+            StopSignals& operator=(const StopSignals&) = delete;
+
+            [[nodiscard]] int getFd() const {return this->_pipe[0];}
+    };
+
+    // the socket is removed when the daemon stops, even by an error
+    class SocketFile {
+        private:
+            std::filesystem::path _path;
+
+        public:
+            explicit SocketFile(std::filesystem::path path) : _path(std::move(path)) {}
+
+            ~SocketFile() {
+                std::error_code error;
+                std::filesystem::remove(this->_path, error);
+            }
+
+            SocketFile(const SocketFile&) = delete;
+            SocketFile& operator=(const SocketFile&) = delete;
+    };
+}
+
+std::filesystem::path samlibd::getSocketPath(const std::filesystem::path& location) {
+    return fs::path::resolve(location.string()) / SOCKET_NAME;
+}
+
+void samlibd::serve(const std::filesystem::path& socketPath, const Handler& handler,
+                    const std::shared_ptr<logger::Logger>& logger) {
+    const auto address = toAddress(socketPath);
+    if (connectTo(socketPath).isValid()) {
+        throw DaemonError("another daemon already listens on " + socketPath.string());
+    }
+
+    // the socket of a crashed daemon is left behind
+    std::error_code error;
+    std::filesystem::remove(socketPath, error);
+
+    Socket server(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (!server.isValid()) {
+        throw DaemonError("cannot create the socket " + socketPath.string() + ": " + std::strerror(errno));
+    }
+
+    // the socket is accessible to the current user only from the very beginning
+    const auto previousUmask = umask(S_IRWXG | S_IRWXO);
+    const auto isBound = bind(server.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    const auto bindErrno = errno;
+    umask(previousUmask);
+    if (!isBound) {
+        throw DaemonError("cannot create the socket " + socketPath.string() + ": " + std::strerror(bindErrno));
+    }
+
+    const SocketFile socketFile(socketPath);
+    if (listen(server.get(), SOMAXCONN) != 0) {
+        throw DaemonError("cannot listen on the socket " + socketPath.string() + ": " + std::strerror(errno));
+    }
+
+    const StopSignals stopSignals;
+    logger->info << "The daemon listens on " << socketPath.string() << std::endl;
+    while (!isStopRequested) {
+        pollfd polls[] = {{server.get(), POLLIN, 0}, {stopSignals.getFd(), POLLIN, 0}};
+        if (poll(polls, 2, -1) <= 0 || !(polls[0].revents & POLLIN)) {
+            continue;
+        }
+
+        const Socket client(accept4(server.get(), nullptr, nullptr, SOCK_CLOEXEC));
+        if (!client.isValid()) {
+            continue;
+        }
+
+        // a client which doesn't send the whole request or doesn't read the output in time mustn't block the others
+        setsockopt(client.get(), SOL_SOCKET, SO_RCVTIMEO, &REQUEST_TIMEOUT, sizeof(REQUEST_TIMEOUT));
+        setsockopt(client.get(), SOL_SOCKET, SO_SNDTIMEO, &OUTPUT_TIMEOUT, sizeof(OUTPUT_TIMEOUT));
+
+        const auto request = receiveFrame(client.get(), MAX_REQUEST_SIZE);
+        if (!request) {
+            continue;
+        }
+        if (request->type == FrameType::Stop) {
+            sendExitCode(client.get(), 0);
+            break;
+        }
+        if (request->type != FrameType::Request) {
+            continue;
+        }
+
+        int exitCode = 1;
+        try {
+            const auto args = decodeRequest(request->payload);
+            if (!sendFrame(client.get(), FrameType::Accepted, {})) {
+                continue;   // the client has given up waiting for its turn
+            }
+            exitCode = runCommand(client.get(), handler, args);
+        } catch (const DaemonError& err) {
+            sendFrame(client.get(), FrameType::Err, std::string(err.what()) + "\n");
+        }
+        sendExitCode(client.get(), exitCode);
+    }
+    logger->info << "The daemon is stopped" << std::endl;
+}
+
+std::optional<int> samlibd::forward(const std::filesystem::path& socketPath, const std::vector<std::string>& args) {
+    const auto connection = connectTo(socketPath);
+    if (!connection.isValid() || !sendFrame(connection.get(), FrameType::Request, encodeRequest(args))) {
+        return std::nullopt;
+    }
+
+    pollfd connectionPoll{connection.get(), POLLIN, 0};
+    if (poll(&connectionPoll, 1, BUSY_NOTICE_DELAY_MS) == 0) {
+        std::cerr << "The daemon is busy with another command, waiting for it to finish..." << std::endl;
+    }
+
+    while (const auto frame = receiveFrame(connection.get())) {
+        switch (frame->type) {
+            case FrameType::Out:
+                std::cout << frame->payload << std::flush;
+                break;
+            case FrameType::Err:
+                std::cerr << frame->payload << std::flush;
+                break;
+            case FrameType::Exit:
+                return frame->payload.size() == 4 ? static_cast<int>(getSize(frame->payload.data())) : 1;
+            default:
+                break;
+        }
+    }
+
+    throw DaemonError("the daemon has closed the connection before the command was done");
+}
+
+bool samlibd::stop(const std::filesystem::path& socketPath) {
+    const auto connection = connectTo(socketPath);
+    if (!connection.isValid() || !sendFrame(connection.get(), FrameType::Stop, {})) {
+        return false;
+    }
+
+    const auto frame = receiveFrame(connection.get());
+    return frame && frame->type == FrameType::Exit;
+}
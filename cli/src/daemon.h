@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_DAEMON_H
+#define SAMLIBINFO_DAEMON_H
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "errors.h"
+#include "logger.h"
+
+/**
+ * The `samlibd` mode: a long-running process keeps the agent (i.e. the DB connection, the HTTP connections and the
+ * workers) warm and runs the commands of the other calls of the CLI.
+ *
+ * The client and the daemon talk over a Unix domain socket by frames: a type (1 byte), a size of the payload (4 bytes,
+ * big-endian) and the payload. A connection serves a single command:
+ *   client -> daemon: `R` (the version of the protocol, 1 byte, and the number of the arguments followed by every
+ *                     argument, each with its size) or `S` (stop the daemon);
+ *   daemon -> client: `A` when the command is started (the daemon runs one command at a time), any number of `O`
+ *                     (stdout) and `E` (stderr) chunks, as the command writes them, then `X` (the exit code).
+ */
+namespace samlibd {
+    class DaemonError : public SamLibError {
+    public:
+        explicit DaemonError(const std::string &arg) : SamLibError("DaemonError: " + arg) {}
+
+        explicit DaemonError(const char *arg) : SamLibError(std::string("DaemonError: ") + arg) {}
+    };
+
+    const unsigned char PROTOCOL_VERSION = 2;
+    const std::string SOCKET_NAME = "samlibd.sock";
+
+    /**
+     * @brief Runs the command with the given arguments (without the name of the program) and returns its exit code.
+     *
+     * The std::cout and std::cerr of the handler are the ones of the client.
+     */
+    using Handler = std::function<int(const std::vector<std::string>& args)>;
+
+    /**
+     * @return the path to the socket of the daemon which serves the given location of the application data
+     */
+    std::filesystem::path getSocketPath(const std::filesystem::path& location);
+
+    /**
+     * @brief Serves the commands of the clients one by one, until a client asks to stop or SIGINT/SIGTERM is received.
+     *
+     * The socket is accessible to the current user only, it's removed when the daemon stops.
+     *
+     * @throws DaemonError if the socket cannot be created, e.g. another daemon already listens on it
+     */
+    void serve(const std::filesystem::path& socketPath, const Handler& handler,
+               const std::shared_ptr<logger::Logger>& logger);
+
+    /**
+     * @brief Runs the command by the daemon and writes its output to std::cout and std::cerr.
+     *
+     * If the daemon doesn't start the command at once, since it runs the command of another call, it's told to the
+     * user, and the command waits for its turn.
+     *
+     * @return the exit code of the command, std::nullopt if no daemon listens on the socket
+     *
+     * @throws DaemonError if the daemon has been lost in the middle of the command
+     */
+    std::optional<int> forward(const std::filesystem::path& socketPath, const std::vector<std::string>& args);
+
+    /**
+     * @brief Asks the daemon to stop (after the command which it runs now, if any).
+     *
+     * @return false if no daemon listens on the socket
+     */
+    bool stop(const std::filesystem::path& socketPath);
+}
+
+#endif //SAMLIBINFO_DAEMON_H
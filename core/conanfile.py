@@ -25,7 +25,7 @@ class MyProjectConan(ConanFile):
     version = '1.0'
     requires = 'libcurl/8.6.0', 'libiconv/1.17', 'sqlite3/3.45.1'
     exports_sources = 'CMakeLists.txt', 'src/*', 'include/*'
-    default_options = {'*:shared': True}
+    default_options = {'*:shared': True, 'sqlite3/*:enable_fts5': True}
 
     def package_info(self):
         self.settings.compiler.cppstd = '20'
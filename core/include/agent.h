@@ -18,22 +18,36 @@
 #ifndef SAMLIBINFO_AGENT_H
 #define SAMLIBINFO_AGENT_H
 
+#include "async.h"
 #include "db.h"
 #include "miner.h"
+#include "scheduler.h"
+#include "journal.h"
 #include "logger.h"
 #include "fs.h"
 
 namespace agent {
+    // max number of the authors synced at once by AsyncAgent::checkUpdates(), the requests are limited by the host's
+    // limiter anyway, so it just bounds the memory of the pages in progress
+    const unsigned int ASYNC_CONCURRENCY = 64;
+
+    class AsyncAgent;
 
     class Agent {
+        friend class AsyncAgent;
+
         private:
             const std::shared_ptr<db::Connection> _con;
             const std::shared_ptr<logger::Logger> _logger;
             const std::shared_ptr<db::DB<db::Book>> _tBook;
             const std::shared_ptr<db::DB<db::GroupBook>> _tGroup;
             const std::shared_ptr<db::DB<db::Author>> _tAuthor;
+            const std::shared_ptr<scheduler::Scheduler> _scheduler;
+            const std::shared_ptr<journal::SyncJournal> _journal;
             const std::unique_ptr<miner::Miner> _miner;
             const std::unique_ptr<fs::BookStorage> _storage;
+            const std::unique_ptr<db::SearchIndex> _searchIndex;
+            bool _indexBookText = false;
 
             /**
              * @brief Fetches a book from the site by using it's URL from the database and stores it as an HTML file.
@@ -58,11 +72,37 @@ namespace agent {
              */
             std::string _fetchBookAsFB2(const db::BookData& book) const;
 
+            /**
+             * @brief Stores the downloaded book in the book storage.
+             *
+             * @return path to the file, an empty string if it cannot be written
+             */
+            std::string _storeBook(const db::BookData& book, const std::string& content, fs::BookType bookType) const;
+
+            /**
+             * @brief Adds the text of the book to the full-text search index (see setBookTextIndexing()).
+             */
+            void _indexBook(const db::BookData& book, const std::string& text) const;
+
+            static std::string _getBookUrl(const db::BookData& book, fs::BookType bookType);
+
         public:
             Agent(const std::string& dbPath, const std::string& bookStorageLocation);
             Agent(const std::string& dbPath, const std::string& bookStorageLocation, const std::shared_ptr<logger::Logger>& logger);
             ~Agent() = default;
-            void checkUpdates();
+            /**
+             * @brief Checks for updates all authors.
+             *
+             * @param resume Continue the interrupted check (if any) instead of starting from the first author
+             */
+            void checkUpdates(bool resume = false);
+
+            /**
+             * @brief Checks for updates only the authors whose check is due (see scheduler::Scheduler).
+             *
+             * @param unreadFirst Check the authors with unread updates before the other ones
+             */
+            void checkDueUpdates(bool unreadFirst = false);
             // fixme: refactor this! I'd prefer to have interface like the next one:
             //        me->author->add()
             //        me->author->retrieve()
@@ -127,6 +167,106 @@ namespace agent {
              * @return path to downloaded file if the book was fetched successfully, an empty string otherwise
              */
             std::string fetchBook(unsigned int bookId, fs::BookType bookType = fs::BookType::FB2) const;
+
+            /**
+             * @brief Searches books by title, description, genre and author's name (and the text of the book).
+             *
+             * @param query Free text to search, all words have to be found in a book. Every word is treated as a prefix
+             * @param limit Max number of books to return
+             *
+             * @return books ordered by relevance (the most relevant first)
+             */
+            db::Books search(const std::string& query, unsigned int limit = 20);
+
+            /**
+             * @brief Enables/disables indexing of the text of downloaded books for the full-text search.
+             *
+             * Note, only books downloaded in HTML format can be indexed.
+             *
+             * @param enable True to index the text of every downloaded book
+             */
+            void setBookTextIndexing(bool enable);
+
+            /**
+             * @brief Chooses how the changes on the authors' pages are found (see miner::DiffEngine).
+             */
+            void setDiffEngine(miner::DiffEngine engine);
+
+            /**
+             * @brief Sets the stages of the sync of several authors and the number of their workers.
+             */
+            void setPipeline(const miner::PipelineSettings& settings);
+
+            /**
+             * @return the queues and the utilization of the stages of the running or the last sync (see
+             *         miner::Miner::getPipelineStats()), it's empty if the authors were synced one by one
+             */
+            [[nodiscard]] std::vector<pipeline::StageStats> getPipelineStats() const;
+    };
+
+    /**
+     * @class AsyncAgent
+     *
+     * @brief The coroutine API of the Agent, so thousands of the operations may run at once on a few threads, e.g.
+     *
+     *     const auto author = async::run(asyncAgent.addAuthor("/l/lorem_ipsum"));
+     *
+     * The requests are sent by the event loop of the http module (see http::fetchAsync()), the parsing and the diff
+     * are run by the shared executor (see executor::getShared()) and all writes to the DB are made by the single
+     * thread of the DB strand. The awaiting coroutines continue on the executor.
+     *
+     * @note the agent must outlive the tasks, and it must not be used directly while they are running (see query())
+     */
+    class AsyncAgent {
+        private:
+            Agent& _agent;
+            async::Strand _dbStrand;
+
+        public:
+            explicit AsyncAgent(Agent& agent);
+
+            AsyncAgent(const AsyncAgent&) = delete;
+            AsyncAgent& operator=(const AsyncAgent&) = delete;
+
+            /**
+             * @brief The same as Agent::addAuthor(), but the author is returned after the first sync.
+             */
+            async::Task<db::AuthorData> addAuthor(std::string url);
+
+            /**
+             * @brief Checks for updates the author.
+             *
+             * @return the synced author
+             */
+            async::Task<db::AuthorData> sync(db::AuthorData author);
+
+            /**
+             * @brief Checks for updates all authors, up to `concurrency` of them at once.
+             */
+            async::Task<void> checkUpdates(unsigned int concurrency = ASYNC_CONCURRENCY);
+
+            /**
+             * @brief The same as Agent::fetchBook(), but the FB2 file is written when it's downloaded completely.
+             */
+            async::Task<std::string> fetchBook(db::BookData book, fs::BookType bookType = fs::BookType::FB2);
+            async::Task<std::string> fetchBook(unsigned int bookId, fs::BookType bookType = fs::BookType::FB2);
+
+            /**
+             * @brief Calls the blocking method of the agent by the DB strand, e.g.
+             *
+             *     const auto books = co_await asyncAgent.query([id](agent::Agent& agent) {
+             *         return agent.getBooks<db::Author>(id, true);
+             *     });
+             *
+             * @note the function must not download anything (e.g. call Agent::fetchBook()), it would block the strand
+             */
+            template <typename F>
+            auto query(F function) -> async::Task<std::invoke_result_t<F&, Agent&>> {
+                return this->_dbStrand.run([this, function = std::move(function)]() mutable {
+                    const auto lock = this->_agent._miner->lockDB();
+                    return function(this->_agent);
+                });
+            }
     };
 }
 
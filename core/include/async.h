@@ -0,0 +1,391 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_ASYNC_H
+#define SAMLIBINFO_ASYNC_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "executor.h"
+
+/**
+ * The coroutines of the library, e.g.
+ *
+ *     async::Task<db::AuthorData> sync(agent::AsyncAgent& agent, db::AuthorData author) {
+ *         co_return co_await agent.sync(std::move(author));
+ *     }
+ *
+ * A Task starts when it's awaited, the awaiting coroutine continues on the thread which completes the task. The
+ * I/O is done by the event loop of the http module (see http::fetchAsync()), the CPU-bound work is resumed on the
+ * shared executor (see executor::getShared()) and the blocking DB calls are run by a Strand.
+ */
+namespace async {
+    class PromiseBase {
+        private:
+            // resumes the awaiting coroutine right away instead of returning to the one which resumed the task
+            struct FinalAwaiter {
+                bool await_ready() noexcept {return false;}
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                    return handle.promise().continuation;
+                }
+
+                void await_resume() noexcept {}
+            };
+
+        public:
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() noexcept {return {};}
+            FinalAwaiter final_suspend() noexcept {return {};}
+            void unhandled_exception() {this->error = std::current_exception();}
+    };
+
+    template <typename T>
+    class Result {
+        private:
+            std::optional<T> _value;
+
+        public:
+            template <typename U>
+            void return_value(U&& value) {this->_value.emplace(std::forward<U>(value));}
+            T get() {return std::move(*this->_value);}
+    };
+
+    template <>
+    class Result<void> {
+        public:
+            void return_void() {}
+            void get() {}
+    };
+
+    /**
+     * @class Task
+     *
+     * @brief The lazy coroutine: it starts when it's awaited and resumes the awaiting coroutine when it's done.
+     *
+     * The exception of the coroutine is rethrown to the awaiting one.
+     *
+     * @note the parameters of a coroutine are copied into it, but the references stay references, so pass by value
+     *       everything that may die before the task is done
+     */
+    template <typename T>
+    class [[nodiscard]] Task {
+        public:
+            struct promise_type : PromiseBase, Result<T> {
+                Task get_return_object() {return Task(std::coroutine_handle<promise_type>::from_promise(*this));}
+            };
+
+        private:
+            std::coroutine_handle<promise_type> _handle;
+
+            explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+        public:
+            Task() = default;
+            Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+            Task& operator=(Task&& other) noexcept {
+                if (this != &other) {
+                    if (this->_handle) {
+                        this->_handle.destroy();
+                    }
+                    this->_handle = std::exchange(other._handle, nullptr);
+                }
+                return *this;
+            }
+
+            ~Task() {
+                if (this->_handle) {
+                    this->_handle.destroy();
+                }
+            }
+
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+
+            bool await_ready() const noexcept {return !this->_handle || this->_handle.done();}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                this->_handle.promise().continuation = awaiting;
+                return this->_handle;
+            }
+
+            T await_resume() {
+                auto& promise = this->_handle.promise();
+                if (promise.error) {
+                    std::rethrow_exception(promise.error);
+                }
+                return promise.get();
+            }
+    };
+
+    /**
+     * @brief The coroutine which starts right away and isn't awaited by anyone, e.g. the one started by run().
+     *
+     * @note it must not throw
+     */
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() noexcept {return {};}
+            std::suspend_never initial_suspend() noexcept {return {};}
+            std::suspend_never final_suspend() noexcept {return {};}
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept {std::terminate();}
+        };
+    };
+
+    class ScheduleAwaiter {
+        private:
+            executor::Executor& _executor;
+
+        public:
+            explicit ScheduleAwaiter(executor::Executor& executor) : _executor(executor) {}
+
+            bool await_ready() const noexcept {return false;}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                this->_executor.post(executor::Task([handle] {handle.resume();}));
+            }
+
+            void await_resume() const noexcept {}
+    };
+
+    /**
+     * @brief `co_await async::schedule()` continues the coroutine on a worker of the executor.
+     */
+    inline ScheduleAwaiter schedule(executor::Executor& executor = executor::getShared()) {
+        return ScheduleAwaiter(executor);
+    }
+
+    /**
+     * @class Strand
+     *
+     * @brief The queue of the tasks which are run one by one by its own thread, e.g. the blocking calls to the DB.
+     *
+     * @note it's thread-safe
+     */
+    class Strand {
+        private:
+            std::mutex _mutex;
+            std::condition_variable _wakeUp;
+            std::deque<executor::Task> _tasks;
+            bool _isStopped = false;
+            std::thread _thread;
+
+            void _work();
+
+        public:
+            class Awaiter {
+                private:
+                    Strand& _strand;
+
+                public:
+                    explicit Awaiter(Strand& strand) : _strand(strand) {}
+
+                    bool await_ready() const noexcept {return this->_strand.isCurrent();}
+
+                    void await_suspend(std::coroutine_handle<> handle) {
+                        this->_strand.post(executor::Task([handle] {handle.resume();}));
+                    }
+
+                    void await_resume() const noexcept {}
+            };
+
+            Strand();
+
+            /**
+             * @brief Runs the tasks which are already posted and stops the thread.
+             */
+            ~Strand();
+
+            Strand(const Strand&) = delete;
+            Strand& operator=(const Strand&) = delete;
+
+            void post(executor::Task task);
+
+            /**
+             * @brief `co_await strand.schedule()` continues the coroutine on the thread of the strand.
+             */
+            Awaiter schedule() {return Awaiter(*this);}
+
+            /**
+             * @brief Runs the function by the thread of the strand, the awaiting coroutine continues on the shared
+             *        executor then (even if the function throws), so the strand is busy only with the function.
+             */
+            template <typename F>
+            auto run(F function) -> Task<std::invoke_result_t<F&>>;
+
+            /**
+             * @return true if it's called by the thread of the strand
+             */
+            [[nodiscard]] bool isCurrent() const;
+    };
+
+    template <typename F>
+    auto Strand::run(F function) -> Task<std::invoke_result_t<F&>> {
+        using Result = std::invoke_result_t<F&>;
+
+        co_await this->schedule();
+        std::exception_ptr error;
+        std::optional<std::conditional_t<std::is_void_v<Result>, bool, Result>> result;
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                function();
+            } else {
+                result.emplace(function());
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        co_await async::schedule();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if constexpr (!std::is_void_v<Result>) {
+            co_return std::move(*result);
+        }
+    }
+
+    template <typename T>
+    using WhenAllResult = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+    template <typename T>
+    class WhenAllAwaiter {
+        private:
+            struct State {
+                std::atomic<std::size_t> left{0};
+                std::coroutine_handle<> awaiting;
+                std::mutex mutex;
+                std::exception_ptr error;
+                std::vector<std::optional<std::conditional_t<std::is_void_v<T>, bool, T>>> results;
+            };
+
+            std::vector<Task<T>> _tasks;
+            State _state;
+
+            static Detached _start(Task<T> task, State* state, std::size_t index) {
+                try {
+                    if constexpr (std::is_void_v<T>) {
+                        co_await std::move(task);
+                    } else {
+                        state->results[index].emplace(co_await std::move(task));
+                    }
+                } catch (...) {
+                    const std::lock_guard lock(state->mutex);
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                }
+
+                if (state->left.fetch_sub(1) == 1) {
+                    state->awaiting.resume();
+                }
+            }
+
+        public:
+            explicit WhenAllAwaiter(std::vector<Task<T>> tasks) : _tasks(std::move(tasks)) {}
+
+            bool await_ready() const noexcept {return this->_tasks.empty();}
+
+            bool await_suspend(std::coroutine_handle<> awaiting) {
+                auto& state = this->_state;
+                state.awaiting = awaiting;
+                state.results.resize(this->_tasks.size());
+                // one more for this function, so the last task doesn't resume the coroutine before all are started
+                state.left = this->_tasks.size() + 1;
+
+                for (std::size_t i = 0; i < this->_tasks.size(); i++) {
+                    _start(std::move(this->_tasks[i]), &state, i);
+                }
+
+                return state.left.fetch_sub(1) != 1;
+            }
+
+            WhenAllResult<T> await_resume() {
+                if (this->_state.error) {
+                    std::rethrow_exception(this->_state.error);
+                }
+
+                if constexpr (!std::is_void_v<T>) {
+                    std::vector<T> results;
+                    results.reserve(this->_state.results.size());
+                    for (auto& result : this->_state.results) {
+                        results.push_back(std::move(*result));
+                    }
+                    return results;
+                }
+            }
+    };
+
+    /**
+     * @brief Runs the tasks concurrently and waits for all of them.
+     *
+     * @return the results in the order of the tasks
+     *
+     * @throw the exception of the first failed task (after all tasks are done)
+     */
+    template <typename T>
+    Task<WhenAllResult<T>> whenAll(std::vector<Task<T>> tasks) {
+        co_return co_await WhenAllAwaiter<T>(std::move(tasks));
+    }
+
+    // the promise is owned by the coroutine, so it isn't destroyed by run() while set_value() is still running
+    template <typename T>
+    Detached _runDetached(Task<T> task, std::shared_ptr<std::promise<T>> promise) {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(task);
+                promise->set_value();
+            } else {
+                promise->set_value(co_await std::move(task));
+            }
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    }
+
+    /**
+     * @brief Runs the task and blocks the calling thread until it's done, i.e. it's the bridge from the blocking
+     *        code to the coroutines.
+     *
+     * @note don't call it from a coroutine, co_await the task instead
+     */
+    template <typename T>
+    T run(Task<T> task) {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto future = promise->get_future();
+        _runDetached(std::move(task), std::move(promise));
+        return future.get();
+    }
+}
+
+#endif //SAMLIBINFO_ASYNC_H
@@ -30,6 +30,9 @@
 #include "fs.h"
 
 namespace db {
+    // how long a connection waits for the other process (e.g. the daemon) to release the DB before it gives up
+    const int BUSY_TIMEOUT_MS = 10 * 1000;
+
     class DBError : public SamLibError {
         public:
             explicit DBError(const std::string& arg) : SamLibError("DBError: " + arg) {}
@@ -101,6 +104,32 @@ namespace db {
         GroupBookData() : DBData(), author_id(0), new_number(0), is_hidden(false) {}
     };
 
+    struct ScheduleData: DBData {
+        int author_id;
+        std::time_t last_check;   // the last time the author's page was checked
+        std::time_t last_change;  // the last time the changes were found on the author's page
+        std::time_t interval;     // the expected interval between author's updates
+        std::time_t next_check;
+
+        ScheduleData() : DBData(), author_id(0), last_check(0), last_change(0), interval(0), next_check(0) {}
+    };
+
+    struct SyncRunData: DBData {
+        std::time_t started_at;
+        std::time_t finished_at;  // 0 if the run was interrupted or is still in progress
+        unsigned int authors_count;
+
+        SyncRunData() : DBData(), started_at(0), finished_at(0), authors_count(0) {}
+    };
+
+    struct SyncRunAuthorData: DBData {
+        int run_id;
+        int author_id;
+        std::time_t checked_at;
+
+        SyncRunAuthorData() : DBData(), run_id(0), author_id(0), checked_at(0) {}
+    };
+
     struct Author {
         AuthorData data;
 
@@ -271,14 +300,114 @@ namespace db {
                      "    DELTA_SIZE  INTEGER\n"
                      ");\n"
                      "CREATE INDEX IF NOT EXISTS idx_book_author ON " + Book::getTable() + " (AUTHOR_ID);\n"
+                     "CREATE INDEX IF NOT EXISTS idx_book_author_link ON " + Book::getTable() + " (AUTHOR_ID, LINK);\n"
                      "CREATE INDEX IF NOT EXISTS idx_book_mtime ON " + Book::getTable() + " (MTIME);\n"
             );
         }
     };
 
+    struct Schedule {
+        ScheduleData data;
+
+        static std::string getTable() {return "Schedule";}
+        [[nodiscard]] static std::unordered_map<std::string, std::string> serialize(const ScheduleData& schedule) {
+            return std::unordered_map<std::string, std::string> {
+                {"AUTHOR_ID", std::to_string(schedule.author_id)},
+                {"LAST_CHECK", std::to_string(schedule.last_check)},
+                {"LAST_CHANGE", std::to_string(schedule.last_change)},
+                {"INTERVAL", std::to_string(schedule.interval)},
+                {"NEXT_CHECK", std::to_string(schedule.next_check)}
+            };
+        }
+        static void load(ScheduleData& schedule, const std::string& fieldName, const char *fieldValue) {
+            if(fieldName == "_id") schedule.id = std::stoi(fieldValue);     // primary key, cannot be null
+            else if(fieldName == "AUTHOR_ID") schedule.author_id = std::stoi(fieldValue);   // not null
+            else if(fieldName == "LAST_CHECK") schedule.last_check = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+            else if(fieldName == "LAST_CHANGE") schedule.last_change = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+            else if(fieldName == "INTERVAL") schedule.interval = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+            else if(fieldName == "NEXT_CHECK") schedule.next_check = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+        }
+        static std::string getCrateTableQuery() {
+            return std::string(
+                    "CREATE TABLE IF NOT EXISTS " + Schedule::getTable() + " (\n"
+                    "    _id         INTEGER PRIMARY KEY AUTOINCREMENT CHECK (_id >= 0),\n"
+                    "    AUTHOR_ID   INTEGER NOT NULL UNIQUE CHECK (AUTHOR_ID >= 0) "
+                                     " REFERENCES " + Author::getTable() + "(_id) ON DELETE CASCADE,\n"
+                    "    LAST_CHECK  TIMESTAMP,\n"
+                    "    LAST_CHANGE TIMESTAMP,\n"
+                    "    INTERVAL    INTEGER,\n"
+                    "    NEXT_CHECK  TIMESTAMP\n"
+                    ");\n"
+                    "CREATE INDEX IF NOT EXISTS idx_schedule_next_check ON " + Schedule::getTable() + " (NEXT_CHECK);\n"
+            );
+        }
+    };
+
+    struct SyncRun {
+        SyncRunData data;
+
+        static std::string getTable() {return "SyncRun";}
+        [[nodiscard]] static std::unordered_map<std::string, std::string> serialize(const SyncRunData& run) {
+            return std::unordered_map<std::string, std::string> {
+                {"STARTED_AT", std::to_string(run.started_at)},
+                {"FINISHED_AT", std::to_string(run.finished_at)},
+                {"AUTHORS_COUNT", std::to_string(run.authors_count)}
+            };
+        }
+        static void load(SyncRunData& run, const std::string& fieldName, const char *fieldValue) {
+            if(fieldName == "_id") run.id = std::stoi(fieldValue);     // primary key, cannot be null
+            else if(fieldName == "STARTED_AT") run.started_at = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+            else if(fieldName == "FINISHED_AT") run.finished_at = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+            else if(fieldName == "AUTHORS_COUNT") run.authors_count = fieldValue == nullptr ? 0 : std::stoul(fieldValue);
+        }
+        static std::string getCrateTableQuery() {
+            return std::string(
+                    "CREATE TABLE IF NOT EXISTS " + SyncRun::getTable() + " (\n"
+                    "    _id           INTEGER PRIMARY KEY AUTOINCREMENT CHECK (_id >= 0),\n"
+                    "    STARTED_AT    TIMESTAMP NOT NULL,\n"
+                    "    FINISHED_AT   TIMESTAMP,\n"
+                    "    AUTHORS_COUNT INTEGER\n"
+                    ");\n"
+            );
+        }
+    };
+
+    struct SyncRunAuthor {
+        SyncRunAuthorData data;
+
+        static std::string getTable() {return "SyncRunAuthor";}
+        [[nodiscard]] static std::unordered_map<std::string, std::string> serialize(const SyncRunAuthorData& item) {
+            return std::unordered_map<std::string, std::string> {
+                {"RUN_ID", std::to_string(item.run_id)},
+                {"AUTHOR_ID", std::to_string(item.author_id)},
+                {"CHECKED_AT", std::to_string(item.checked_at)}
+            };
+        }
+        static void load(SyncRunAuthorData& item, const std::string& fieldName, const char *fieldValue) {
+            if(fieldName == "_id") item.id = std::stoi(fieldValue);     // primary key, cannot be null
+            else if(fieldName == "RUN_ID") item.run_id = std::stoi(fieldValue);         // not null
+            else if(fieldName == "AUTHOR_ID") item.author_id = std::stoi(fieldValue);   // not null
+            else if(fieldName == "CHECKED_AT") item.checked_at = fieldValue == nullptr ? 0 : std::stol(fieldValue);
+        }
+        static std::string getCrateTableQuery() {
+            return std::string(
+                    "CREATE TABLE IF NOT EXISTS " + SyncRunAuthor::getTable() + " (\n"
+                    "    _id        INTEGER PRIMARY KEY AUTOINCREMENT CHECK (_id >= 0),\n"
+                    "    RUN_ID     INTEGER NOT NULL CHECK (RUN_ID >= 0) "
+                                    " REFERENCES " + SyncRun::getTable() + "(_id) ON DELETE CASCADE,\n"
+                    "    AUTHOR_ID  INTEGER NOT NULL CHECK (AUTHOR_ID >= 0),\n"
+                    "    CHECKED_AT TIMESTAMP,\n"
+                    "    UNIQUE (RUN_ID, AUTHOR_ID)\n"
+                    ");\n"
+            );
+        }
+    };
+
     using Authors = std::vector<AuthorData>;
     using Books = std::vector<BookData>;
     using GroupBooks = std::vector<GroupBookData>;
+    using Schedules = std::vector<ScheduleData>;
+    using SyncRuns = std::vector<SyncRunData>;
 
     class Where {
         private:
@@ -355,10 +484,41 @@ namespace db {
              * @return The clean version of the database file path.
              */
             std::string _getCleanPath(const std::string& dbPath) const;
+            unsigned int _transactionDepth = 0;
+
+            void _exec(const std::string& sql);
+
         public:
             sqlite3* session;
             explicit Connection(const std::string &dbPath);
             ~Connection();
+
+            /**
+             * @brief Starts a transaction, or a savepoint if a transaction is already started.
+             *
+             * So the operations which need a transaction (e.g. DB::add() of a list) may be called inside a larger
+             * transaction: their commit or rollback affects only their own changes, while the outermost commit
+             * makes everything durable at once.
+             *
+             * @throw QueryError
+             */
+            void begin();
+
+            /**
+             * @brief Commits the transaction or releases the innermost savepoint.
+             *
+             * The transaction which cannot be committed is rolled back.
+             *
+             * @throw QueryError
+             */
+            void commit();
+
+            /**
+             * @brief Rolls back the transaction or the changes made since the innermost savepoint.
+             */
+            void rollback();
+
+            [[nodiscard]] unsigned int getTransactionDepth() const {return this->_transactionDepth;}
     };
 
     template <typename T>
@@ -401,26 +561,13 @@ namespace db {
             explicit DB(const std::shared_ptr<db::Connection>& connection) : _con(connection) {}
 
             void begin() {
-                char *zErrMsg = nullptr;
-                if (sqlite3_exec(this->_con->session, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg) != SQLITE_OK) {
-                    const std::string errMsg(zErrMsg);
-                    sqlite3_free(zErrMsg);
-                    throw QueryError(errMsg);
-                }
-                sqlite3_free(zErrMsg);
+                this->_con->begin();
             }
             void rollback() {
-                sqlite3_exec(this->_con->session, "ROLLBACK;", NULL, NULL, nullptr);
+                this->_con->rollback();
             }
             void commit() {
-                char *zErrMsg = nullptr;
-                if (sqlite3_exec(this->_con->session, "COMMIT;", NULL, NULL, &zErrMsg) != SQLITE_OK) {
-                    const std::string errMsg(zErrMsg);
-                    sqlite3_free(zErrMsg);
-                    throw QueryError(errMsg);
-                }
-
-                sqlite3_free(zErrMsg);
+                this->_con->commit();
             }
 
             bool isTableExists() {
@@ -718,5 +865,78 @@ namespace db {
                 return result;
             }
     };
+
+    /**
+     * @class SearchIndex
+     * @brief Full-text (FTS5) index over the books.
+     *
+     * The index covers title, description, genre (form) and author's name of every book and, optionally, the text
+     * of the downloaded book. Rows of the index share IDs with the `Book` table and are maintained by triggers, so
+     * any change of the books (e.g. by the miner) is reflected in the index automatically. The only exception is
+     * the text of the book, which has to be set explicitly by setText().
+     *
+     * @throw DBError
+     */
+    class SearchIndex {
+        private:
+            const std::shared_ptr<db::Connection> _con;
+
+            void _exec(const std::string& sql);
+            bool _isTableExists();
+
+        public:
+            explicit SearchIndex(const std::shared_ptr<db::Connection>& connection) : _con(connection) {}
+
+            static std::string getTable() {return "BookSearch";}
+            static std::string getCrateTableQuery();
+
+            /**
+             * @brief Converts free text into FTS5 query.
+             *
+             * Every word of the text is quoted (so, characters like `-` or `"` don't break the query syntax) and
+             * turned into prefix query. All words have to be found in a book to match it.
+             *
+             * @param text The text to convert, e.g. "Локи фанф"
+             * @return FTS5 query, e.g. `"Локи"* "фанф"*`
+             */
+            static std::string toMatchQuery(const std::string& text);
+
+            /**
+             * @return true if SQLite is built with FTS5, i.e. the index can be created
+             */
+            static bool isAvailable();
+
+            /**
+             * @brief Creates the index (if needed) and fills it with all known books when it's just created.
+             *
+             * Note, the `Book` table must exist at this point.
+             *
+             * @throw DBError if SQLite is built without FTS5
+             */
+            void createIndex();
+
+            /**
+             * @brief Re-creates content of the index from the `Book` table, the text of the books is lost.
+             */
+            void rebuild();
+
+            /**
+             * @brief Sets (replaces) the indexed text of the book.
+             *
+             * @param bookId ID of the book
+             * @param text Plain (i.e. without HTML tags) text of the book
+             */
+            void setText(unsigned int bookId, const std::string& text);
+
+            /**
+             * @brief Searches books.
+             *
+             * @param query Free text to search, see toMatchQuery()
+             * @param limit Max number of books to return
+             *
+             * @return books ordered by relevance (the most relevant first)
+             */
+            Books search(const std::string& query, unsigned int limit = 20);
+    };
 }
 #endif //SAMLIBINFO_DB_H
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_EXECUTOR_H
+#define SAMLIBINFO_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "errors.h"
+
+namespace executor {
+    class ExecutorError : public SamLibError {
+        public:
+            explicit ExecutorError(const std::string& arg) : SamLibError("ExecutorError: " + arg) {}
+            explicit ExecutorError(const char* arg) : SamLibError(std::string("ExecutorError: ") + arg) {}
+    };
+
+    /**
+     * @brief The future of a task which was cancelled before it started (see TaskGroup::cancel()) throws it.
+     */
+    class Cancelled : public ExecutorError {
+        public:
+            explicit Cancelled(const std::string& arg) : ExecutorError("Cancelled: " + arg) {}
+            explicit Cancelled(const char* arg) : ExecutorError(std::string("Cancelled: ") + arg) {}
+    };
+
+    /**
+     * @brief Move-only type-erased `void()` callable, unlike std::function it may own a std::promise.
+     */
+    class Task {
+        private:
+            struct Callable {
+                virtual ~Callable() = default;
+                virtual void run() = 0;
+            };
+
+            template <typename F>
+            struct CallableImpl : Callable {
+                F function;
+                explicit CallableImpl(F&& function) : function(std::move(function)) {}
+                void run() override {this->function();}
+            };
+
+            std::unique_ptr<Callable> _callable;
+
+        public:
+            Task() = default;
+
+            template <typename F> requires (!std::is_same_v<std::decay_t<F>, Task>)
+            explicit Task(F&& function) :
+                _callable(std::make_unique<CallableImpl<std::decay_t<F>>>(std::decay_t<F>(std::forward<F>(function)))) {}
+
+            void operator()() {this->_callable->run();}
+            explicit operator bool() const {return static_cast<bool>(this->_callable);}
+    };
+
+    /**
+     * @class Executor
+     *
+     * @brief The work-stealing pool of threads for the CPU-bound work (e.g. conversion and parsing of the pages).
+     *
+     * Every worker has its own deque of tasks: the tasks submitted by a worker go to its deque and it takes the
+     * latest one first (its data is still in the cache), while the idle workers steal the oldest ones from the others.
+     * The tasks submitted by the other threads go to the shared queue.
+     *
+     * Don't block the workers on I/O (e.g. HTTP requests), they are as many as the cores.
+     *
+     * @note it's thread-safe
+     */
+    class Executor {
+        private:
+            struct Worker {
+                std::mutex mutex;
+                std::deque<Task> tasks;
+            };
+
+            std::vector<std::unique_ptr<Worker>> _workers;
+            std::mutex _mutex;
+            std::condition_variable_any _wakeUp;
+            std::deque<Task> _injected;     // guarded by the _mutex
+            std::atomic<std::size_t> _pending{0};
+            std::vector<std::jthread> _threads;
+
+            std::optional<Task> _take(std::size_t index);
+            void _work(const std::stop_token& stopToken, std::size_t index);
+
+        public:
+            /**
+             * @param concurrency Number of the workers, 0 means the number of the cores (see getDefaultConcurrency())
+             */
+            explicit Executor(unsigned int concurrency = 0);
+
+            /**
+             * @brief Runs the tasks which are already submitted and stops the workers.
+             */
+            ~Executor();
+
+            Executor(const Executor&) = delete;
+            Executor& operator=(const Executor&) = delete;
+
+            void post(Task task);
+
+            /**
+             * @brief Runs the function on one of the workers.
+             *
+             * @return the future of the result (or of the exception) of the function
+             */
+            template <typename F>
+            auto submit(F&& function) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+                using Result = std::invoke_result_t<std::decay_t<F>>;
+
+                std::packaged_task<Result()> task(std::forward<F>(function));
+                auto future = task.get_future();
+                this->post(Task(std::move(task)));
+                return future;
+            }
+
+            /**
+             * @brief Runs one of the pending tasks on the calling thread, so a thread which waits for some tasks helps
+             *        to complete them instead of blocking a worker.
+             *
+             * @return false if there are no pending tasks
+             */
+            bool runPendingTask();
+
+            [[nodiscard]] unsigned int getConcurrency() const {return static_cast<unsigned int>(this->_workers.size());}
+
+            /**
+             * @return true if the calling thread is one of the workers of this executor
+             */
+            [[nodiscard]] bool isWorker() const;
+    };
+
+    /**
+     * @return the number of the cores (at least 1)
+     */
+    [[nodiscard]] unsigned int getDefaultConcurrency();
+
+    /**
+     * @return the executor shared by all components, it's created on the first call with getDefaultConcurrency()
+     *         workers
+     */
+    Executor& getShared();
+
+    /**
+     * @class TaskGroup
+     *
+     * @brief The tasks which are cancelled and awaited together, so none of them outlives the group.
+     *
+     * A task gets the std::stop_token of the group if it accepts one, so the long tasks can stop in the middle. The
+     * tasks which haven't started yet when the group is cancelled aren't run at all, their futures throw Cancelled.
+     * The first failed task cancels the rest of the group.
+     *
+     * The destructor cancels the tasks which aren't awaited by wait() and waits for the running ones.
+     */
+    class TaskGroup {
+        private:
+            Executor& _executor;
+            std::stop_source _stopSource;
+            std::mutex _mutex;
+            std::condition_variable _finished;
+            std::size_t _active = 0;
+            std::exception_ptr _error;
+
+            void _onStarted();
+            void _onFinished(std::exception_ptr error);
+            void _waitAll();
+
+        public:
+            explicit TaskGroup(Executor& executor = getShared());
+            ~TaskGroup();
+
+            TaskGroup(const TaskGroup&) = delete;
+            TaskGroup& operator=(const TaskGroup&) = delete;
+
+            /**
+             * @param function Called as `function(std::stop_token)` or as `function()`
+             *
+             * @return the future of the result of the function
+             */
+            template <typename F>
+            auto submit(F&& function) {
+                using Function = std::decay_t<F>;
+                constexpr bool isStoppable = std::is_invocable_v<Function&, std::stop_token>;
+                using Result = typename std::conditional_t<
+                    isStoppable, std::invoke_result<Function&, std::stop_token>, std::invoke_result<Function&>
+                >::type;
+
+                std::promise<Result> promise;
+                auto future = promise.get_future();
+
+                this->_onStarted();
+                this->_executor.post(Task(
+                    [this, promise = std::move(promise), function = Function(std::forward<F>(function)),
+                     stopToken = this->_stopSource.get_token()]() mutable {
+                        if (stopToken.stop_requested()) {
+                            promise.set_exception(std::make_exception_ptr(Cancelled("the task group is cancelled")));
+                            this->_onFinished(nullptr);
+                            return;
+                        }
+
+                        std::exception_ptr error;
+                        try {
+                            if constexpr (std::is_void_v<Result>) {
+                                if constexpr (isStoppable) {function(stopToken);} else {function();}
+                                promise.set_value();
+                            } else {
+                                if constexpr (isStoppable) {
+                                    promise.set_value(function(stopToken));
+                                } else {
+                                    promise.set_value(function());
+                                }
+                            }
+                        } catch (...) {
+                            error = std::current_exception();
+                            promise.set_exception(error);
+                        }
+                        this->_onFinished(error);
+                    }
+                ));
+
+                return future;
+            }
+
+            /**
+             * @brief Asks the running tasks to stop and skips the ones which haven't started yet.
+             */
+            void cancel();
+
+            [[nodiscard]] std::stop_token getStopToken() const {return this->_stopSource.get_token();}
+
+            /**
+             * @brief Waits for all tasks of the group, the calling thread runs the pending tasks meanwhile.
+             *
+             * @throw the exception of the first failed task
+             */
+            void wait();
+    };
+}
+
+#endif //SAMLIBINFO_EXECUTOR_H
@@ -21,9 +21,13 @@
 #include "logger.h"
 #include "parser.h"
 #include "db.h"
+#include <chrono>
+#include <functional>
 #include <string>
 #include <vector>
+#include "async.h"
 #include "errors.h"
+#include "limiter.h"
 
 namespace http {
     using Page = std::string;
@@ -38,20 +42,120 @@ namespace http {
     const std::string S_PROTOCOL = "http";
     const std::string S_DOMAIN = "samlib.ru";
 
+    // the politeness limits of the requests to a single host (see HostLimiter)
+    const double S_REQUESTS_PER_SECOND = 2;
+    const unsigned int S_BURST = 4;
+    const unsigned int S_MAX_CONNECTIONS = 2;
+
+    // the transient failures are repeated with the exponential backoff: the delay before the attempt N is a random
+    // value in [D/2, D], where D = min(S_RETRY_DELAY * 2^N, S_MAX_RETRY_DELAY)
+    const unsigned int S_RETRIES = 3;
+    const std::chrono::milliseconds S_RETRY_DELAY{500};
+    const std::chrono::milliseconds S_MAX_RETRY_DELAY{30 * 1000};
+    const std::chrono::seconds S_TIMEOUT{60};
+
     struct Settings {
-        std::string protocol;
-        std::string domain;
+        std::string protocol = S_PROTOCOL;
+        std::string domain = S_DOMAIN;  // may contain the port, e.g. "127.0.0.1:8080"
+        double requestsPerSecond = S_REQUESTS_PER_SECOND;   // 0 means unlimited
+        unsigned int burst = S_BURST;
+        unsigned int maxConnections = S_MAX_CONNECTIONS;    // 0 means unlimited
+        unsigned int retries = S_RETRIES;
+        std::chrono::milliseconds retryDelay = S_RETRY_DELAY;
+        std::chrono::milliseconds maxRetryDelay = S_MAX_RETRY_DELAY;
+        std::chrono::seconds timeout = S_TIMEOUT;           // of the whole request
+        bool compression = true;    // ask for the compressed (gzip, brotli etc, if supported by curl) responses
+    };
+
+    enum class Status {
+        Ok,
+        NotFound,   // the page doesn't exist (404 or 410)
+        Transient,  // the failure may go away by itself: timeouts, network errors, 408, 429, 5xx
+        Permanent,  // any other failure, e.g. 403 or an invalid URL
+    };
+
+    [[nodiscard]] const char* getName(Status status);
+
+    struct Response {
+        Status status = Status::Permanent;
+        long httpCode = 0;      // 0 if there was no response at all
+        Page text;              // UTF-8 (but see fetchRaw()), empty unless the status is `Ok`
+        std::string error;      // description of the failure
+        std::size_t wireSize = 0;   // size of the body as it was received (i.e. compressed)
+
+        [[nodiscard]] bool isOk() const {return status == Status::Ok;}
     };
 
+    /**
+     * @brief Sets the site to work with, e.g. a local mirror or a mock server, and the limits of the requests to it.
+     *
+     * @note it isn't thread-safe, so call it before any request
+     */
+    void configure(const Settings& settings);
+
+    /**
+     * @return The settings of the site to work with (by default it's http://samlib.ru)
+     */
+    const Settings& getSettings();
+
+    /**
+     * @brief Converts the text from cp1251 (the encoding of the site) to UTF-8.
+     *
+     * @throws HTTPError
+     */
+    std::string toUtf8(const std::string& str);
+
+    /**
+     * @brief Sends an HTTP GET request to the given URL and classifies the result.
+     *
+     * The request waits for the permission of the host's limiter (see HostLimiter), the transient failures are
+     * repeated up to `Settings::retries` times.
+     *
+     * @throws HTTPError if the page cannot be converted to UTF-8
+     *
+     * @param url The URL to send the GET request to.
+     * @return The response, it never throws on the network or HTTP errors
+     */
+    Response fetch(const std::string& url);
+
+    /**
+     * @brief The same as fetch(), but the text of the response is left in the encoding of the site (see toUtf8()).
+     */
+    Response fetchRaw(const std::string& url);
+
+    /**
+     * @brief Sends the request without blocking: all such requests are run by the single thread of the event loop.
+     *
+     * The same limits and retries are applied as for fetch().
+     *
+     * @param url The URL to send the GET request to.
+     * @param onDone Called with the response (in the encoding of the site) by the thread of the event loop, so it
+     *               must be short, e.g. schedule a coroutine
+     */
+    void submit(const std::string& url, std::function<void(Response)> onDone);
+
+    /**
+     * @brief The awaitable fetchRaw(): the request is sent by the event loop (see submit()), the awaiting coroutine
+     *        is resumed on the shared executor (see executor::getShared()).
+     */
+    async::Task<Response> fetchRawAsync(std::string url);
+
+    /**
+     * @brief The awaitable fetch(): the response is converted to UTF-8 on the shared executor.
+     *
+     * @throws HTTPError if the page cannot be converted to UTF-8
+     */
+    async::Task<Response> fetchAsync(std::string url);
+
     /**
      * @brief Get the content from the given URL.
      *
      * This function sends an HTTP GET request to the specified URL and
-     * retrieves the content from the response.
+     * retrieves the content from the response (see fetch()).
      *
-     * @note in case response status code is not `200 OK` the function returns an empty string
+     * @note in case the page is not found the function returns an empty string
      *
-     * @throws HTTPError
+     * @throws HTTPError in case of any other failure
      *
      * @param url The URL to send the GET request to.
      * @return The content retrieved from the response as a string.
@@ -66,11 +170,10 @@ namespace http {
      * @param url The URL of the file to be fetched.
      * @param filePath The file path where the fetched file will be saved.
      *
-     * @throws HTTPError in case of any errors
-     *
-     * @return True if the file was successfully fetched and saved, false otherwise.
+     * @return Status::Ok if the file was successfully fetched and saved, the reason of the failure otherwise (the file
+     *         is removed in this case)
      */
-    bool fetchToFile(const std::string &url, const std::string &filePath);
+    Status fetchToFile(const std::string &url, const std::string &filePath);
 
 
     /**
@@ -107,7 +210,7 @@ namespace http {
     }
 
     template<typename... Paths>
-    inline std::string toUrl(Paths... paths) {return toUrl(S_PROTOCOL, S_DOMAIN, paths...);}
+    inline std::string toUrl(Paths... paths) {return toUrl(getSettings().protocol, getSettings().domain, paths...);}
 }
 
 #endif //SAMLIBINFO_HTTP_H
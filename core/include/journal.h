@@ -0,0 +1,70 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_JOURNAL_H
+#define SAMLIBINFO_JOURNAL_H
+
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <unordered_set>
+#include "db.h"
+
+namespace journal {
+    /**
+     * @class SyncJournal
+     *
+     * @brief Remembers which authors have been checked by the current sync run, so an interrupted run (e.g. by a
+     * crash or Ctrl-C) can be resumed instead of being started from the first author.
+     *
+     * Every checked author is recorded right after its changes are saved, i.e. the interruption costs at most the
+     * work on a single author. The records of a run are dropped once the run is finished.
+     *
+     * @throw DBError
+     */
+    class SyncJournal {
+        private:
+            const std::shared_ptr<db::DB<db::SyncRun>> _tRun;
+            const std::shared_ptr<db::DB<db::SyncRunAuthor>> _tRunAuthor;
+
+        public:
+            explicit SyncJournal(const std::shared_ptr<db::Connection>& connection);
+
+            void createTable();
+
+            /**
+             * @brief Starts a new run and removes the previous ones, so the interrupted run cannot be resumed.
+             */
+            db::SyncRunData begin(unsigned int authorsCount, std::time_t now);
+
+            /**
+             * @return the latest run if it was interrupted
+             */
+            [[nodiscard]] std::optional<db::SyncRunData> getInterrupted() const;
+
+            /**
+             * @return IDs of the authors already checked by the run
+             */
+            [[nodiscard]] std::unordered_set<int> getChecked(const db::SyncRunData& run) const;
+
+            void markChecked(const db::SyncRunData& run, const db::AuthorData& author, std::time_t now);
+
+            void finish(db::SyncRunData& run, std::time_t now);
+    };
+}
+
+#endif //SAMLIBINFO_JOURNAL_H
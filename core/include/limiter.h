@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_LIMITER_H
+#define SAMLIBINFO_LIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace http {
+    // the lowest rate the limiter slows down to after the server asked to slow down (requests per second)
+    const double MIN_REQUESTS_PER_SECOND = 0.1;
+    // the rate grows by this step after every successful request, until it reaches the configured one
+    const double REQUESTS_PER_SECOND_STEP = 0.1;
+
+    // the pause after the first "429 Too Many Requests" without the `Retry-After` header, every next one doubles it
+    const std::chrono::milliseconds INITIAL_BACKOFF{1000};
+    const std::chrono::milliseconds MAX_BACKOFF{5 * 60 * 1000};
+
+    /**
+     * @return true if the server asks to slow down, i.e. responds "429 Too Many Requests" or "503 Service Unavailable"
+     */
+    inline bool isThrottled(long httpCode) {return httpCode == 429 || httpCode == 503;}
+
+    /**
+     * @class HostLimiter
+     *
+     * @brief The politeness limiter of the requests to a single host.
+     *
+     * It's a token bucket, which limits the rate of the requests, and a semaphore, which limits the number of
+     * simultaneous connections. The rate adapts to the server: it's halved and the requests are paused when the server
+     * asks to slow down (for the time from the `Retry-After` header or with the exponential backoff), and it grows
+     * back slowly (additively) after every successful request.
+     *
+     * @note it's thread-safe
+     */
+    class HostLimiter {
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            std::mutex _mutex;
+            std::condition_variable _released;
+            const double _maxRate;   // 0 means unlimited
+            const double _burst;
+            const unsigned int _maxConnections;  // 0 means unlimited
+            double _rate;
+            double _tokens;
+            unsigned int _connections;
+            Clock::time_point _lastRefill;
+            Clock::time_point _pausedUntil;
+            std::chrono::milliseconds _backoff;
+
+            void _refill(Clock::time_point now);
+            bool _tryAcquire(Clock::time_point now, Clock::time_point& retryAt);
+
+        public:
+            /**
+             * @param requestsPerSecond The max rate of the requests, 0 means unlimited
+             * @param burst How many requests may be sent at once after a pause
+             * @param maxConnections The max number of simultaneous requests, 0 means unlimited
+             */
+            HostLimiter(double requestsPerSecond, unsigned int burst, unsigned int maxConnections);
+
+            HostLimiter(const HostLimiter&) = delete;
+            HostLimiter& operator=(const HostLimiter&) = delete;
+
+            /**
+             * @brief Blocks until the request may be sent.
+             *
+             * Every acquire() must be followed by the release() (see Permit).
+             */
+            void acquire();
+
+            /**
+             * @brief The same as acquire(), but it doesn't block.
+             *
+             * @param retryAt Set to the time the request may be allowed if it isn't allowed now,
+             *                `time_point::max()` means when another request releases its connection
+             *
+             * @return true if the request may be sent, it must be followed by the release() in this case
+             */
+            bool tryAcquire(std::chrono::steady_clock::time_point& retryAt);
+
+            /**
+             * @brief Returns the connection to the pool and adapts the rate to the response.
+             *
+             * @param httpCode The status code of the response, 0 if there was no response (e.g. a network error)
+             * @param retryAfter The value of the `Retry-After` header, 0 if there was no such header
+             */
+            void release(long httpCode, std::chrono::seconds retryAfter);
+
+            [[nodiscard]] double getRate();
+    };
+
+    /**
+     * @class Permit
+     *
+     * @brief Holds the permission of the limiter of the URL's host to send a single request.
+     *
+     * It's acquired in the constructor (i.e. it may block) and released in the destructor.
+     */
+    class Permit {
+        private:
+            HostLimiter& _limiter;
+            long _httpCode;
+            std::chrono::seconds _retryAfter;
+
+        public:
+            explicit Permit(const std::string& url);
+            ~Permit();
+
+            Permit(const Permit&) = delete;
+            Permit& operator=(const Permit&) = delete;
+
+            void setResponse(long httpCode, std::chrono::seconds retryAfter);
+    };
+
+    /**
+     * @return the limiter of the URL's host, it's created with the current settings (see http::configure())
+     */
+    HostLimiter& getLimiter(const std::string& url);
+
+    /**
+     * @brief Drops all limiters, so they will be recreated with the new settings.
+     *
+     * @note call it only if there are no requests in progress
+     */
+    void resetLimiters();
+}
+
+#endif //SAMLIBINFO_LIMITER_H
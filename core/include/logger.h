@@ -24,6 +24,47 @@
 #include <sstream>
 #include <vector>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <variant>
+#include <type_traits>
+
+// log records below this level are compiled out: 0 - debug, 1 - info, 2 - warning, 3 - error
+#ifndef SAMLIB_LOG_MIN_LEVEL
+    #define SAMLIB_LOG_MIN_LEVEL 0
+#endif
+
+// the same for the structured events (e.g. the metrics of the sync), they're kept by default in all builds, since they
+// are written only to the sinks which ask for them (see `--log-json`)
+#ifndef SAMLIB_LOG_EVENT_MIN_LEVEL
+    #define SAMLIB_LOG_EVENT_MIN_LEVEL 0
+#endif
+
+/**
+ * The macros below check the log level before any argument is evaluated or formatted, e.g.
+ *     LOG_DEBUG(this->_logger) << "Book \"" << book.title << "\" is new." << std::endl;
+ * costs nothing when the debug level is disabled, and it's completely removed by the compiler when the level is
+ * below SAMLIB_LOG_MIN_LEVEL. The `switch` makes a macro a single statement, so an `else` after it is never bound to
+ * one of its `if`s.
+ */
+#define SAMLIB_LOG(loggerPtr, stream, level) \
+    switch (0) case 0: default: \
+    if constexpr (static_cast<int>(logger::LogLevel::level) < SAMLIB_LOG_MIN_LEVEL) {} \
+    else if (!(loggerPtr)->stream.isEnabled()) {} \
+    else (loggerPtr)->stream
+
+#define LOG_DEBUG(loggerPtr) SAMLIB_LOG(loggerPtr, debug, Debug)
+#define LOG_INFO(loggerPtr) SAMLIB_LOG(loggerPtr, info, Info)
+#define LOG_WARNING(loggerPtr) SAMLIB_LOG(loggerPtr, warning, Warning)
+#define LOG_ERROR(loggerPtr) SAMLIB_LOG(loggerPtr, error, Error)
+
+// the same for structured events: LOG_EVENT(this->_logger, Debug, "sync.fetch", {{"bytes", 1024}});
+#define LOG_EVENT(loggerPtr, level, name, ...) \
+    switch (0) case 0: default: \
+    if constexpr (static_cast<int>(logger::LogLevel::level) < SAMLIB_LOG_EVENT_MIN_LEVEL) {} \
+    else if (!(loggerPtr)->isEventEnabled(logger::LogLevel::level)) {} \
+    else (loggerPtr)->event(logger::LogLevel::level, name, __VA_ARGS__)
 
 namespace logger {
     enum class LogLevel {
@@ -33,10 +74,32 @@ namespace logger {
         Error
     };
 
+    constexpr LogLevel MIN_LOG_LEVEL = static_cast<LogLevel>(SAMLIB_LOG_MIN_LEVEL);
+    constexpr LogLevel MIN_EVENT_LEVEL = static_cast<LogLevel>(SAMLIB_LOG_EVENT_MIN_LEVEL);
+
+    using LogFieldValue = std::variant<std::string, long long, double, bool>;
+
+    /**
+     * @brief Typed key/value attached to a log record, e.g. `{"books_added", 3}`.
+     */
+    struct LogField {
+        std::string key;
+        LogFieldValue value;
+
+        LogField(std::string key, const char* value) : key(std::move(key)), value(std::string(value)) {}
+        LogField(std::string key, std::string value) : key(std::move(key)), value(std::move(value)) {}
+        LogField(std::string key, bool value) : key(std::move(key)), value(value) {}
+        LogField(std::string key, double value) : key(std::move(key)), value(value) {}
+        template <typename T> requires std::is_integral_v<T>
+        LogField(std::string key, T value) : key(std::move(key)), value(static_cast<long long>(value)) {}
+    };
+    using LogFields = std::vector<LogField>;
+
     struct LogEntry {
         std::chrono::system_clock::time_point time;
         LogLevel level;
         std::string message;
+        LogFields fields{};
     };
 
     class ILogFilter {
@@ -58,39 +121,162 @@ namespace logger {
         public:
             explicit MinimalLogLevelFilter(LogLevel level) : _level(level) {}
             [[nodiscard]] bool filter(const LogEntry& entry) override { return entry.level >= this->_level; }
+            [[nodiscard]] LogLevel getLevel() const { return this->_level; }
     };
 
 
+    /**
+     * @brief Human-readable format: `[2024-01-14T17:31:10.123] [INFO] message key=value ...`
+     */
     class ISO8601LogFormatter : public ILogFormatter {
         public:
             std::string format(const LogEntry& entry) override;
     };
 
+    /**
+     * @brief Machine-readable format, one JSON object per record (i.e. JSON lines):
+     *     {"time":"2024-01-14T14:31:10.123Z","level":"info","message":"sync.diff","fields":{"books_added":3}}
+     */
+    class JSONLinesLogFormatter : public ILogFormatter {
+        public:
+            std::string format(const LogEntry& entry) override;
+    };
+
+
+    /**
+     * @brief Defines what the asynchronous logger does when its queue is full.
+     */
+    enum class OverflowPolicy {
+        Block,  // the caller waits until the writer thread frees a slot, no message is lost
+        Drop    // the message is dropped (and counted), the caller never waits
+    };
+
+    // max size of a message (with its fields) in the asynchronous mode, the longer messages are cut
+    const std::size_t LOG_RECORD_SIZE = 1024;
+
+    class AsyncWriter;
 
     class Logger {
         private:
-            std::ostream* _os;
+            struct Sink {
+                std::ostream* os;
+                std::unique_ptr<ILogFormatter> formatter;
+                LogLevel level;
+                std::unique_ptr<std::ostream> ownStream;
+            };
+
+            std::vector<Sink> _sinks;
             std::vector<std::unique_ptr<ILogFilter>> _filters;
-            std::unique_ptr<ILogFormatter> _formatter;
+            std::mutex _writeMutex;
+            std::unique_ptr<AsyncWriter> _asyncWriter;
+            LogLevel _filterLevel;
+            std::atomic<LogLevel> _minLevel;
+
+            void _updateMinLevel();
 
             friend struct LoggerStream;
+            friend class AsyncWriter;
+
+            void _dispatch(const LogEntry& entry);
+            void _write(const LogEntry& entry, bool doFlush);
+            void _flushSinks();
 
         public:
             Logger(
                     std::ostream* os = &std::cout,
-                    std::unique_ptr<ILogFormatter> formatter = std::make_unique<ISO8601LogFormatter>()
+                    std::unique_ptr<ILogFormatter> formatter = std::make_unique<ISO8601LogFormatter>(),
+                    LogLevel level = LogLevel::Debug
             );
-            ~Logger() = default;
+            ~Logger();
 
             void addFilter(std::unique_ptr<ILogFilter> filter);
             void setLogLevel(LogLevel level);
 
+            /**
+             * @brief Adds one more destination for the log records.
+             *
+             * @param os The stream to write records into, it must outlive the logger
+             * @param formatter The format of the records in this sink
+             * @param level Minimal level of the records written into this sink
+             */
+            void addSink(std::ostream* os, std::unique_ptr<ILogFormatter> formatter, LogLevel level = LogLevel::Debug);
+
+            /**
+             * @brief Adds the file as one more destination for the log records, new records are appended to the file.
+             *
+             * @throw std::runtime_error if the file cannot be opened
+             */
+            void addSink(const std::string& path, std::unique_ptr<ILogFormatter> formatter,
+                         LogLevel level = LogLevel::Debug);
+
+            /**
+             * @brief Emits a structured event, i.e. a record which carries typed fields, e.g.
+             *     logger->event(LogLevel::Debug, "sync.diff", {{"author_id", 1}, {"books_added", 3}});
+             *
+             * @param level The level of the record
+             * @param name The name of the event, it's used as the message of the record
+             * @param fields The payload of the event
+             */
+            void event(LogLevel level, const std::string& name, LogFields fields);
+
+            /**
+             * @brief Checks the level of the records before they're formatted.
+             *
+             * Note, only the level filters (see setLogLevel() and MinimalLogLevelFilter) are taken into account,
+             * the rest of the filters are applied to the complete record.
+             *
+             * @return false if records of the given level are discarded anyway
+             */
+            [[nodiscard]] bool isEnabled(LogLevel level) const {
+                return level >= MIN_LOG_LEVEL && level >= this->_minLevel.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief The same as isEnabled() for the structured events (see event() and SAMLIB_LOG_EVENT_MIN_LEVEL).
+             */
+            [[nodiscard]] bool isEventEnabled(LogLevel level) const {
+                return level >= MIN_EVENT_LEVEL && level >= this->_minLevel.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @brief Switches the logger into asynchronous mode.
+             *
+             * In this mode the callers only put fixed-size records into a bounded lock-free queue, while formatting
+             * and writing happen in a background thread. So, the memory used by the logger is bounded by the
+             * `capacity * LOG_RECORD_SIZE` and the callers don't wait for I/O.
+             *
+             * @note It isn't safe to call this method (as well as stopAsync()) while other threads are logging.
+             *
+             * @param capacity Max number of queued records, it's rounded up to the nearest power of 2
+             * @param policy What to do when the queue is full
+             */
+            void startAsync(std::size_t capacity = 4096, OverflowPolicy policy = OverflowPolicy::Block);
+
+            /**
+             * @brief Writes all queued records, stops the background thread and switches the logger back into
+             *        synchronous mode.
+             */
+            void stopAsync();
+
+            /**
+             * @brief Waits until all records queued so far are written (no-op in synchronous mode).
+             */
+            void flush();
+
+            /**
+             * @return number of records dropped because of the full queue (see OverflowPolicy::Drop)
+             */
+            [[nodiscard]] unsigned long getDroppedCount() const;
+
             struct LoggerStream {
                 protected:
                     Logger* _logger;
-                    std::ostringstream _ss;
+                    const unsigned long _id;
                     LogLevel _level;
 
+                    // every thread has its own buffer for every stream, so threads never mix parts of their messages;
+                    // the buffer is released when the message is flushed
+                    std::ostringstream& _buffer();
                     LogEntry _getEntry();
                     bool _isAvailable();
                     bool _isAvailable(const LogEntry& entry);
@@ -106,6 +292,7 @@ namespace logger {
 
                     LoggerStream(Logger* logger, LogLevel level);
                     ~LoggerStream();
+                    [[nodiscard]] bool isEnabled() const { return this->_logger->isEnabled(this->_level); }
                     void flush();
                     void clear();
             };
@@ -18,16 +18,24 @@
 #ifndef SAMLIBINFO_MINER_H
 #define SAMLIBINFO_MINER_H
 
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
 #include <string>
 #include "db.h"
 #include "http.h"
 #include "parser.h"
 #include "logger.h"
+#include "stats.h"
+#include "scheduler.h"
+#include "journal.h"
+#include "staging.h"
+#include "pipeline.h"
+#include "async.h"
 #include "errors.h"
 
 
 namespace miner {
-//    http::Settings Settings = http::Settings {"http", "samlib.ru"};
 //    const std::vector<std::string> KnownDomains{"samlib.ru", "zhurnal.lib.ru"};
     const auto AUTHOR_URL_PATTERN =
           R"lit(^(?:http:\/\/(?:(?:samlib\.ru)|(?:zhurnal\.lib\.ru)))?)lit" // may contain domain
@@ -35,6 +43,19 @@ namespace miner {
           R"lit(|^([a-z0-9-_]+\/?)$)lit" // or just contain meaningful part of the url
     ;
 
+    // minimal similarity (see getSimilarity()) of two names to treat one of them as a rename of the other one
+    const auto RENAME_SIMILARITY_THRESHOLD = 0.75;
+    // minimal part of the books of an abandoned group which should be found in a new group to treat them as the same one
+    const auto RENAME_GROUP_OVERLAP_THRESHOLD = 0.5;
+    // max difference of the sizes (a part of the larger one) of a book which moves to a new URL and into another group
+    const auto RENAME_SIZE_TOLERANCE = 0.2;
+    // fuzzy matching of book titles is quadratic, so it's skipped for huge lists of added/removed books
+    const auto RENAME_MAX_FUZZY_PAIRS = 10000;
+    // max number of the extended groups of an author fetched at once (the host's limiter may allow even less)
+    const unsigned int MAX_PARALLEL_FETCHES = 8;
+    // the first block of the arena of the sync, it's enough for the temporaries of an author with a few hundred books
+    const std::size_t ARENA_INITIAL_SIZE = 64 * 1024;
+
     class MinerError : public SamLibError {
         public:
             explicit MinerError(const std::string& arg) : SamLibError("MinerError: " + arg) {}
@@ -69,6 +90,27 @@ namespace miner {
         [[nodiscard]] bool empty() const {return added.empty() && updated.empty() && removed.empty() && !isPageRemoved;}
     };
 
+    /**
+     * @brief The stages of the sync of several authors (see Miner::setPipeline()) and the number of their workers.
+     *
+     * The changes are saved by the thread which runs the sync, all reads of the DB by the other stages wait for it.
+     */
+    struct PipelineSettings {
+        bool isEnabled = true;          // otherwise the authors are synced one by one
+        unsigned int fetchWorkers = 4;  // download the authors' pages
+        unsigned int decodeWorkers = 1; // convert them to UTF-8
+        unsigned int parseWorkers = 2;  // find the groups and books on them
+        unsigned int groupWorkers = 2;  // download and parse the extended groups, up to MAX_PARALLEL_FETCHES pages each
+        unsigned int diffWorkers = 2;   // compare the found books with the stored ones
+        std::size_t queueDepth = 8;     // max number of the authors waiting for every stage
+    };
+
+    enum class DiffEngine {
+        Registry,   // the stored books are loaded and matched in memory (see Miner::getDifference())
+        Staging,    // the web books are matched inside SQLite (see Miner::getStagedDifference())
+        Verify,     // both; the mismatches are reported, the result of the Registry is used
+    };
+
     class Miner {
         private:
             const std::shared_ptr<logger::Logger> _logger;
@@ -76,29 +118,190 @@ namespace miner {
             const std::shared_ptr<db::DB<db::Book>> _tBook;
             const std::shared_ptr<db::DB<db::GroupBook>> _tGroup;
             const std::shared_ptr<db::DB<db::Author>> _tAuthor;
+            const std::shared_ptr<scheduler::Scheduler> _scheduler;
+            const std::shared_ptr<journal::SyncJournal> _journal;
+            staging::StagingDiff _staging;
+            DiffEngine _diffEngine = DiffEngine::Registry;
+            // the connection is shared by the stages of the pipeline, so they take turns
+            std::mutex _dbMutex;
+            PipelineSettings _pipelineSettings;
+
+            struct SyncJob;
+            mutable std::mutex _pipelineMutex;
+            const pipeline::Pipeline<std::unique_ptr<SyncJob>>* _pipeline = nullptr;  // the running one
+            std::vector<pipeline::StageStats> _pipelineStats;  // of the last run
+
+            // the steps of getUpdates(), every one is a stage of the pipeline
+            std::string _getPageUrl(const SyncJob& job) const;
+            void _checkPage(SyncJob& job) const;
+            void _fetchPage(SyncJob& job) const;
+            void _decodePage(SyncJob& job) const;
+            void _parsePage(SyncJob& job) const;
+            std::vector<std::string> _getGroupUrls(const SyncJob& job, std::vector<std::size_t>& extendedGroups) const;
+            void _mergeGroups(SyncJob& job, const std::vector<std::size_t>& extendedGroups) const;
+            void _fetchGroups(SyncJob& job) const;
+            void _findDifference(SyncJob& job);
 
+            // reports the changes found by one engine only (see DiffEngine::Verify)
+            void _verifyDifference(const Difference& diff, const Difference& stagedDiff,
+                                   const db::AuthorData& author) const;
             void _logDiff(const Difference& diff, const db::AuthorData& author);
             std::string _getAuthorUrl(const std::string& url) const;
+            db::AuthorData _toAuthor(const std::string& canonicalURL, const http::Page& pageText) const;
+            void _logFetch(const std::string& url, const http::Response& response,
+                           std::chrono::steady_clock::time_point start) const;
+            http::Response _fetch(const std::string& url, stats::Stage stage, bool decode = true) const;
+            // the author has to outlive the task, the measurements are attributed to the author (see stats::AuthorScope)
+            async::Task<http::Response> _fetchAsync(const db::AuthorData& author, std::string url, stats::Stage stage,
+                                                    bool decode) const;
+            std::vector<http::Response> _fetchAll(const db::AuthorData& author, const std::vector<std::string>& urls,
+                                                  stats::Stage stage) const;
+            void _logStats();
+            void _save(db::AuthorData& author, Difference& diff,
+                       const std::function<void(const db::AuthorData&)>& onSynced);
+            void _logSynced(const db::AuthorData& author, std::chrono::steady_clock::time_point start) const;
+            void _sync(db::AuthorData& author, const std::function<void(const db::AuthorData&)>& onSynced);
+            async::Task<db::AuthorData> _syncAsync(db::AuthorData author, async::Strand& dbStrand,
+                                                   std::function<void(const db::AuthorData&)> onSynced);
+            // syncs the authors one by one, while the other coroutines do the same (see syncAllAsync())
+            async::Task<void> _syncNext(db::Authors& authors, std::atomic<std::size_t>& next,
+                                        async::Strand& dbStrand,
+                                        const std::function<void(const db::AuthorData&)>& onSynced,
+                                        std::atomic<unsigned int>& failedCount);
+            void _logFailure(const db::AuthorData& author, const SamLibError& error);
+            void _syncPipelined(
+                db::Authors& authors,
+                const std::function<void(const db::AuthorData&)>& onSynced,
+                const std::function<void(const db::AuthorData&, const std::exception_ptr&)>& onChecked
+            );
+            void _syncAuthors(
+                db::Authors& authors,
+                const std::function<void(const db::AuthorData&, unsigned int current, unsigned int total)>& progressCallback,
+                const std::function<void(const db::AuthorData&)>& onSynced
+            );
 
         public:
-            Miner(const std::shared_ptr<db::Connection>& connection, const std::shared_ptr<logger::Logger>& logger);
+            Miner(const std::shared_ptr<db::Connection>& connection, const std::shared_ptr<logger::Logger>& logger,
+                  const std::shared_ptr<scheduler::Scheduler>& scheduler = nullptr,
+                  const std::shared_ptr<journal::SyncJournal>& journal = nullptr);
             Miner(
                     const std::shared_ptr<db::Connection>& connection,
                     const std::shared_ptr<logger::Logger>& logger,
                     const std::shared_ptr<db::DB<db::Author>>& authorDB,
                     const std::shared_ptr<db::DB<db::GroupBook>>& groupDB,
-                    const std::shared_ptr<db::DB<db::Book>>& bookDB
+                    const std::shared_ptr<db::DB<db::Book>>& bookDB,
+                    const std::shared_ptr<scheduler::Scheduler>& scheduler = nullptr,
+                    const std::shared_ptr<journal::SyncJournal>& journal = nullptr
                   );
             ~Miner() = default;
 
             db::AuthorData getAuthor(const std::string& url) const;
+
+            /**
+             * @brief The awaitable getAuthor(), the page is fetched by the event loop (see http::fetchAsync()).
+             */
+            async::Task<db::AuthorData> getAuthorAsync(std::string url) const;
+
             Difference getUpdates(const db::AuthorData& author);
+
+            /**
+             * @brief Compares the books and groups of the author stored in the DB with the ones found on the site.
+             *
+             * @param author The author
+             * @param storedBooks The author's books from the DB
+             * @param storedGroups The author's groups from the DB
+             * @param webBookGroups The groups found on the author's page (with books of the extended groups), the pages
+             *                      they reference must be alive until the call returns
+             * @param resource The memory of the temporaries, the result doesn't use it
+             *
+             * @return the changes to apply to the DB
+             */
+            Difference getDifference(const db::AuthorData& author, const db::Books& storedBooks,
+                                     const db::GroupBooks& storedGroups,
+                                     const parser::BookGroupViewsList& webBookGroups,
+                                     std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+            /**
+             * @brief The same as getDifference(), but the books are matched inside SQLite (see staging::StagingDiff),
+             *        so the stored books of the author aren't loaded.
+             *
+             * The stored books are loaded only if some books or groups are removed, to detect the renames.
+             */
+            Difference getStagedDifference(const db::AuthorData& author,
+                                           const parser::BookGroupViewsList& webBookGroups,
+                                           std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+            /**
+             * @brief Chooses how getUpdates() finds the changes.
+             */
+            void setDiffEngine(DiffEngine engine);
+
+            /**
+             * @brief Chooses how syncAll() and syncDue() pass the authors through the stages of the sync.
+             */
+            void setPipeline(const PipelineSettings& settings);
+
+            /**
+             * @return the queues and the utilization of the stages of the running sync, or of the last one
+             *
+             * @note it's thread-safe
+             */
+            [[nodiscard]] std::vector<pipeline::StageStats> getPipelineStats() const;
+
+            /**
+             * @brief Makes the other users of the connection take turns with the running syncs (see syncAsync()).
+             *
+             * @note don't sync while it's held
+             */
+            [[nodiscard]] std::unique_lock<std::mutex> lockDB();
+
             void apply(Difference& diff, db::AuthorData& author);
             void sync(db::AuthorData& author);
             void syncAll(
                 const std::function<void(const db::AuthorData&, unsigned int current, unsigned int total)>& progressCallback
             );
             void syncAll();
+
+            /**
+             * @brief Syncs all authors and records the progress in the journal (see SyncJournal), if the miner has one.
+             *
+             * @param resume Continue the interrupted run (if any) instead of starting from the first author
+             * @param progressCallback Called after every synced author
+             */
+            void syncAll(
+                bool resume,
+                const std::function<void(const db::AuthorData&, unsigned int current, unsigned int total)>& progressCallback
+            );
+
+            /**
+             * @brief Syncs only the authors whose check is due according to the scheduler (see Scheduler).
+             *
+             * Falls back to syncAll() if the miner has no scheduler.
+             *
+             * @param unreadFirst Sync the authors with unread updates before the other ones
+             * @param progressCallback Called after every synced author
+             */
+            void syncDue(
+                bool unreadFirst,
+                const std::function<void(const db::AuthorData&, unsigned int current, unsigned int total)>& progressCallback
+            );
+
+            /**
+             * @brief The coroutine version of sync(): the pages are fetched by the event loop (see http::fetchAsync()),
+             *        the CPU-bound steps are run by the shared executor and the changes are saved by the strand.
+             *
+             * @param dbStrand Runs the writes to the DB, it must outlive the task
+             *
+             * @return the synced author
+             */
+            async::Task<db::AuthorData> syncAsync(db::AuthorData author, async::Strand& dbStrand);
+
+            /**
+             * @brief The coroutine version of syncAll(): up to `concurrency` authors are synced at once.
+             *
+             * The run is recorded in the journal, but it can't be resumed by this function.
+             */
+            async::Task<void> syncAllAsync(async::Strand& dbStrand, unsigned int concurrency);
         };
 }
 
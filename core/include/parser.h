@@ -19,7 +19,11 @@
 #define SAMLIBINFO_PARSER_H
 
 #include <vector>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <regex>
+#include "executor.h"
 
 namespace parser {
     // const auto DEFAULT_BOOK_PATTERN = R"lit(^<DL><DT><li>(?:<font.*?<\/font>)?<A\s+HREF=([^<>]+)\.html><b>(.*?)<\/b><\/A>\s+&nbsp;\s+<b>(\d+)k<\/b>\s+&nbsp;\s+<small>(?:.*?<\/b>\s+&nbsp;)?\s+([^<>]+)?\s+(?:<A\s+HREF="\/comment.*?<DD>)?(?:<font\s+color="#555555">([^<>]+)<\/font>)?.*<\/DL>$)lit";
@@ -54,6 +58,8 @@ namespace parser {
             R"lit(|(?:<\/dl>)))lit"                                           // or end of the main page content
     ;
 
+    // the books of the large pages are parsed in parallel, by the batches of the groups of about this size (in bytes)
+    const std::size_t PARALLEL_PARSE_BATCH_SIZE = 32 * 1024;
 
     const auto DEFAULT_AUTHOR_PATTERN =
             R"lit(^<h3>)lit"              // author's name tag
@@ -92,10 +98,118 @@ namespace parser {
 
     using BookGroupsList = std::vector<BookGroup>;
 
+    class TextCleaner;
+
+    /**
+     * @brief The book as it's found on the page, without any copying.
+     *
+     * The fields reference the text of the page, so the page must outlive the view. The description is kept as is
+     * (i.e. with HTML tags), it's cleaned only when the book is materialized (see toBook()).
+     */
+    struct BookView {
+        unsigned int size;
+        std::string_view url;
+        std::string_view title;
+        std::string_view genre;
+        std::string_view description;
+
+        BookView(): size(0) {}
+
+        [[nodiscard]] Book toBook(const TextCleaner& cleaner) const;
+    };
+    using BookViewsList = std::pmr::vector<BookView>;
+
+    /**
+     * @brief The group of books as it's found on the page, see BookView.
+     */
+    struct BookGroupView {
+        // the list of books uses the memory of the list of groups (see std::uses_allocator)
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        BookGroupType type;
+        std::string_view url;
+        std::string_view name;
+        BookViewsList books;
+
+        BookGroupView(): type(BookGroupPlain) {}
+        explicit BookGroupView(const allocator_type& allocator): type(BookGroupPlain), books(allocator) {}
+        BookGroupView(const BookGroupView& other, const allocator_type& allocator) :
+            type(other.type), url(other.url), name(other.name), books(other.books, allocator) {}
+        BookGroupView(BookGroupView&& other, const allocator_type& allocator) :
+            type(other.type), url(other.url), name(other.name), books(std::move(other.books), allocator) {}
+
+        BookGroupView(const BookGroupView&) = default;
+        BookGroupView(BookGroupView&&) = default;
+        BookGroupView& operator=(const BookGroupView&) = default;
+        BookGroupView& operator=(BookGroupView&&) = default;
+    };
+    using BookGroupViewsList = std::pmr::vector<BookGroupView>;
+
+    /**
+     * @class TextCleaner
+     *
+     * @brief Class to clean text by removing HTML tags, newlines, and multiple spaces.
+     *
+     * The TextCleaner class provides methods to clean text strings by removing HTML tags, replacing HTML newlines with
+     * newlines removing multiple spaces, trimming the leading and trailing spaces, and replacing certain special
+     * characters
+     */
+    class TextCleaner {
+        public:
+            /**
+             * @brief Cleans the given text by removing HTML tags, newlines, and multiple spaces.
+             *
+             * This function takes a string `text` as input and performs the following operations to clean the text:
+             * 1. Replaces HTML newlines with actual newlines.
+             * 2. Removes HTML tags from the text.
+             * 3. Replaces multiple spaces with a single space.
+             * 4. Trims leading and trailing spaces.
+             * 5. Replaces the special character "&#8212;" with a hyphen "-".
+             *
+             * All of it is done in a single pass over the text (see cleanHtml()).
+             *
+             * @param text The text to be cleaned.
+             * @return The cleaned version of the input text.
+             */
+            [[nodiscard]] std::string clean(std::string_view text) const;
+    };
+
+
+    /**
+     * @brief Finds the books on the page without copying any part of it (see BookView).
+     *
+     * @param resource The memory of the list, e.g. an arena which is released when the list isn't needed anymore
+     */
+    BookViewsList getBookViews(std::string_view pageText, const std::string& bookPattern = DEFAULT_BOOK_PATTERN,
+                               std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief Finds the groups of books on the page without copying any part of it (see BookGroupView).
+     *
+     * The first pass finds the groups, the second one parses their books: on the executor, if the page is larger than
+     * PARALLEL_PARSE_BATCH_SIZE. The groups are listed in the order of the page anyway.
+     *
+     * @param resource The memory of the lists of groups and their books
+     * @param executor The executor of the second pass, the one with a single worker makes it serial
+     */
+    BookGroupViewsList getBookGroupViews(std::string_view pageText,
+                                         const std::string& bookGroupPattern = DEFAULT_BOOK_GROUPS_PATTERN,
+                                         std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                                         executor::Executor& executor = executor::getShared());
 
     BooksList getBooks(const std::string& pageText, const std::string& bookPattern = DEFAULT_BOOK_PATTERN);
     BookGroupsList getBookGroupList(const std::string& pageText, const std::string& bookGroupPattern = DEFAULT_BOOK_GROUPS_PATTERN);
     Author getAuthor(const std::string& pageText, const std::string& pattern = DEFAULT_AUTHOR_PATTERN);
+
+    /**
+     * @brief Extracts plain text from the HTML page of a book (e.g. to index it for the full-text search).
+     *
+     * All HTML tags are dropped, runs of whitespace characters are collapsed into single space.
+     *
+     * @param pageText The HTML text of the book
+     * @return plain text of the book
+     */
+    std::string getText(const std::string& pageText);
 }
 
 #endif //SAMLIBINFO_PARSER_H
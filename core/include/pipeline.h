@@ -0,0 +1,366 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_PIPELINE_H
+#define SAMLIBINFO_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pipeline {
+    using Clock = std::chrono::steady_clock;
+
+    struct QueueStats {
+        std::size_t capacity = 0;
+        std::size_t depth = 0;              // number of the items in the queue right now
+        std::size_t maxDepth = 0;
+        double averageDepth = 0.0;          // weighted by time
+        unsigned long long pushed = 0;
+        std::chrono::nanoseconds blocked{0};    // time the producers waited for a free slot
+    };
+
+    /**
+     * @class BoundedQueue
+     *
+     * @brief Multi-producer multi-consumer FIFO queue of a limited size, the producers wait while it's full and the
+     *        consumers wait while it's empty.
+     *
+     * @note it's thread-safe
+     */
+    template <typename T>
+    class BoundedQueue {
+        private:
+            mutable std::mutex _mutex;
+            std::condition_variable _notEmpty;
+            std::condition_variable _notFull;
+            std::deque<T> _items;
+            const std::size_t _capacity;
+            bool _isClosed = false;
+
+            std::size_t _maxDepth = 0;
+            unsigned long long _pushed = 0;
+            std::chrono::nanoseconds _blocked{0};
+            double _depthTime = 0.0;    // integral of the depth over time (in nanoseconds)
+            const Clock::time_point _created = Clock::now();
+            Clock::time_point _lastChange = _created;
+
+            // must be called under the lock before the depth is changed
+            void _onChange(Clock::time_point now) {
+                this->_depthTime += static_cast<double>(this->_items.size())
+                                  * static_cast<double>((now - this->_lastChange).count());
+                this->_lastChange = now;
+            }
+
+        public:
+            explicit BoundedQueue(std::size_t capacity) : _capacity(std::max<std::size_t>(capacity, 1)) {}
+
+            BoundedQueue(const BoundedQueue&) = delete;
+            BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+            /**
+             * @brief Blocks while the queue is full.
+             *
+             * @return false if the queue is closed, the item is dropped in this case
+             */
+            bool push(T item) {
+                std::unique_lock lock(this->_mutex);
+                if (this->_items.size() >= this->_capacity && !this->_isClosed) {
+                    const auto start = Clock::now();
+                    this->_notFull.wait(lock, [this] {
+                        return this->_items.size() < this->_capacity || this->_isClosed;
+                    });
+                    this->_blocked += Clock::now() - start;
+                }
+                if (this->_isClosed) {
+                    return false;
+                }
+
+                this->_onChange(Clock::now());
+                this->_items.push_back(std::move(item));
+                this->_pushed++;
+                this->_maxDepth = std::max(this->_maxDepth, this->_items.size());
+                lock.unlock();
+
+                this->_notEmpty.notify_one();
+                return true;
+            }
+
+            /**
+             * @brief Blocks while the queue is empty.
+             *
+             * @return the oldest item, std::nullopt if the queue is closed and there are no items left
+             */
+            std::optional<T> pop() {
+                std::unique_lock lock(this->_mutex);
+                this->_notEmpty.wait(lock, [this] {return !this->_items.empty() || this->_isClosed;});
+                if (this->_items.empty()) {
+                    return std::nullopt;
+                }
+
+                this->_onChange(Clock::now());
+                std::optional<T> item(std::move(this->_items.front()));
+                this->_items.pop_front();
+                lock.unlock();
+
+                this->_notFull.notify_one();
+                return item;
+            }
+
+            /**
+             * @brief No more items will be pushed, the consumers get the remaining ones and then std::nullopt.
+             */
+            void close() {
+                {
+                    const std::lock_guard lock(this->_mutex);
+                    this->_isClosed = true;
+                }
+                this->_notEmpty.notify_all();
+                this->_notFull.notify_all();
+            }
+
+            /**
+             * @brief Closes the queue and drops the remaining items.
+             */
+            void cancel() {
+                std::deque<T> items;
+                {
+                    const std::lock_guard lock(this->_mutex);
+                    this->_onChange(Clock::now());
+                    this->_isClosed = true;
+                    items.swap(this->_items);
+                }
+                this->_notEmpty.notify_all();
+                this->_notFull.notify_all();
+            }
+
+            [[nodiscard]] QueueStats getStats() const {
+                const std::lock_guard lock(this->_mutex);
+                const auto now = Clock::now();
+                const auto depthTime = this->_depthTime + static_cast<double>(this->_items.size())
+                                     * static_cast<double>((now - this->_lastChange).count());
+                const auto lifetime = static_cast<double>((now - this->_created).count());
+
+                QueueStats stats;
+                stats.capacity = this->_capacity;
+                stats.depth = this->_items.size();
+                stats.maxDepth = this->_maxDepth;
+                stats.averageDepth = lifetime > 0 ? depthTime / lifetime : 0.0;
+                stats.pushed = this->_pushed;
+                stats.blocked = this->_blocked;
+                return stats;
+            }
+    };
+
+    struct StageStats {
+        std::string name;
+        unsigned int workers = 0;
+        unsigned long long items = 0;       // processed ones
+        std::chrono::nanoseconds busy{0};   // total time of the handlers of all workers
+        std::chrono::nanoseconds elapsed{0};    // since the start of the pipeline
+        QueueStats input;
+
+        /**
+         * @return part of the time the workers of the stage were busy, in [0, 1]
+         */
+        [[nodiscard]] double getUtilization() const;
+    };
+
+    /**
+     * @brief Renders the stats of the stages as a human-readable table.
+     */
+    [[nodiscard]] std::string getReport(const std::vector<StageStats>& stages);
+
+    /**
+     * @class Pipeline
+     *
+     * @brief Passes the items through the chain of the stages, every stage has its own workers and the bounded queue
+     *        of the input items.
+     *
+     * So the stages bound by the different resources (e.g. network, CPU, disk) work simultaneously, while the memory
+     * is bounded by the depth of the queues: a stage waits if the next one can't keep up. The items leave the
+     * stages with several workers not necessarily in the order they came in. The last stage is run by the thread
+     * which calls run().
+     *
+     * @note the handlers must not throw, the item should carry its failure to the next stages
+     */
+    template <typename T>
+    class Pipeline {
+        public:
+            using Handler = std::function<void(T&)>;
+
+        private:
+            struct Stage {
+                std::string name;
+                unsigned int workers;
+                Handler handler;
+                BoundedQueue<T> input;
+                std::atomic<unsigned int> active{0};
+                std::atomic<unsigned long long> items{0};
+                std::atomic<long long> busy{0};     // nanoseconds
+
+                Stage(std::string name, unsigned int workers, Handler handler, std::size_t queueDepth) :
+                    name(std::move(name)), workers(workers), handler(std::move(handler)), input(queueDepth) {}
+            };
+
+            const std::size_t _queueDepth;
+            std::vector<std::unique_ptr<Stage>> _stages;
+            std::atomic<Clock::time_point> _start{Clock::time_point{}};
+            std::atomic<Clock::time_point> _finish{Clock::time_point{}};
+
+            void _work(std::size_t index) {
+                auto& stage = *this->_stages[index];
+                const auto next = index + 1 < this->_stages.size() ? this->_stages[index + 1].get() : nullptr;
+
+                while (auto item = stage.input.pop()) {
+                    const auto start = Clock::now();
+                    stage.handler(*item);
+                    stage.busy.fetch_add((Clock::now() - start).count(), std::memory_order_relaxed);
+                    stage.items.fetch_add(1, std::memory_order_relaxed);
+
+                    if (next) {
+                        next->input.push(std::move(*item));
+                    }
+                }
+
+                // the last worker of the stage tells the next one that nothing else is coming
+                if (stage.active.fetch_sub(1) == 1 && next) {
+                    next->input.close();
+                }
+            }
+
+            void _cancel() {
+                for (auto& stage : this->_stages) {
+                    stage->input.cancel();
+                }
+            }
+
+        public:
+            /**
+             * @param queueDepth Max number of the items waiting for every stage
+             */
+            explicit Pipeline(std::size_t queueDepth) : _queueDepth(queueDepth) {}
+
+            Pipeline(const Pipeline&) = delete;
+            Pipeline& operator=(const Pipeline&) = delete;
+
+            /**
+             * @brief Appends the stage to the chain, it must be called before run().
+             *
+             * @param name Name of the stage in the stats
+             * @param workers Number of the threads of the stage, the last stage always has a single one
+             * @param handler Processes the item, it's called by several threads at once if there are several workers
+             */
+            void addStage(std::string name, unsigned int workers, Handler handler) {
+                this->_stages.push_back(
+                    std::make_unique<Stage>(std::move(name), std::max(workers, 1u), std::move(handler), this->_queueDepth)
+                );
+            }
+
+            /**
+             * @brief Passes all items through the stages and waits until the last stage processes them.
+             *
+             * If the last stage throws, the rest of the items are dropped, the workers are stopped and the exception
+             * is rethrown.
+             */
+            void run(std::vector<T> items) {
+                if (this->_stages.empty()) {
+                    return;
+                }
+
+                this->_start = Clock::now();
+                auto& last = *this->_stages.back();
+                last.workers = 1;
+
+                std::vector<std::thread> threads;
+                threads.emplace_back([this, items = std::move(items)]() mutable {
+                    auto& first = this->_stages.front()->input;
+                    for (auto& item : items) {
+                        if (!first.push(std::move(item))) {
+                            break;  // cancelled
+                        }
+                    }
+                    first.close();
+                });
+
+                for (std::size_t i = 0; i < this->_stages.size(); i++) {
+                    auto& stage = *this->_stages[i];
+                    stage.active = stage.workers;
+                    if (&stage == &last) {
+                        continue;
+                    }
+                    for (unsigned int worker = 0; worker < stage.workers; worker++) {
+                        threads.emplace_back([this, i] {this->_work(i);});
+                    }
+                }
+
+                std::exception_ptr error;
+                try {
+                    this->_work(this->_stages.size() - 1);
+                } catch (...) {
+                    error = std::current_exception();
+                    this->_cancel();
+                }
+
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                this->_finish = Clock::now();
+
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            /**
+             * @note it may be called while the pipeline is running
+             */
+            [[nodiscard]] std::vector<StageStats> getStats() const {
+                const auto start = this->_start.load();
+                auto finish = this->_finish.load();
+                if (finish == Clock::time_point{}) {
+                    finish = Clock::now();
+                }
+
+                std::vector<StageStats> stats;
+                stats.reserve(this->_stages.size());
+                for (const auto& stage : this->_stages) {
+                    StageStats stageStats;
+                    stageStats.name = stage->name;
+                    stageStats.workers = stage->workers;
+                    stageStats.items = stage->items.load(std::memory_order_relaxed);
+                    stageStats.busy = std::chrono::nanoseconds(stage->busy.load(std::memory_order_relaxed));
+                    stageStats.elapsed = start == Clock::time_point{} ? std::chrono::nanoseconds(0) : finish - start;
+                    stageStats.input = stage->input.getStats();
+                    stats.push_back(std::move(stageStats));
+                }
+
+                return stats;
+            }
+    };
+}
+
+#endif //SAMLIBINFO_PIPELINE_H
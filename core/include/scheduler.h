@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_SCHEDULER_H
+#define SAMLIBINFO_SCHEDULER_H
+
+#include <ctime>
+#include <memory>
+#include "db.h"
+
+namespace scheduler {
+    // all the timestamps and intervals are in milliseconds, as the MTIME of the authors and books
+    const std::time_t HOUR = 60 * 60 * 1000;
+    const std::time_t DAY = 24 * HOUR;
+
+    // bounds of the interval between two checks of the same author
+    const std::time_t MIN_CHECK_INTERVAL = HOUR;
+    const std::time_t MAX_CHECK_INTERVAL = 30 * DAY;
+
+    // the expected interval between updates of an author without any history
+    const std::time_t DEFAULT_UPDATE_INTERVAL = 7 * DAY;
+
+    // weight of the latest observation in the exponentially weighted moving average of the update interval
+    const double SMOOTHING_FACTOR = 0.3;
+
+    // an author is checked a few times per his expected update interval, so the updates are found in time
+    const double CHECK_RATIO = 0.5;
+
+    // how many of the latest changes (see Book.MTIME) are used to guess the update interval of a new author; the
+    // books changed within MIN_CHECK_INTERVAL are treated as a single change
+    const unsigned int HISTORY_DEPTH = 10;
+
+    /**
+     * @class Scheduler
+     *
+     * @brief Learns how often every author updates his page and decides when to check it next time.
+     *
+     * The expected interval between the updates is an exponentially weighted moving average of the observed ones.
+     * It's seeded by the history of the changes already stored in the DB (i.e. distinct modification times of the
+     * author's books). A long silence stretches the interval as well, so abandoned pages are checked rarely, while
+     * active authors are checked a few times per their usual update interval.
+     *
+     * @throw DBError
+     */
+    class Scheduler {
+        private:
+            const std::shared_ptr<db::Connection> _con;
+            const std::shared_ptr<db::DB<db::Schedule>> _tSchedule;
+            const std::shared_ptr<db::DB<db::Author>> _tAuthor;
+
+            [[nodiscard]] std::time_t _getHistoricalInterval(const db::AuthorData& author) const;
+
+        public:
+            Scheduler(const std::shared_ptr<db::Connection>& connection,
+                      const std::shared_ptr<db::DB<db::Author>>& authorDB);
+
+            void createTable();
+
+            /**
+             * @brief Learns from the result of the check and plans the next one.
+             *
+             * @param author The checked author
+             * @param hasChanges Whether any changes were found on the author's page
+             * @param now Time of the check
+             */
+            void onChecked(const db::AuthorData& author, bool hasChanges, std::time_t now);
+
+            /**
+             * @brief Forgets the schedule of the author (e.g. the author is removed).
+             */
+            void remove(unsigned int authorId);
+
+            /**
+             * @brief Returns the authors whose check is due, the most overdue first.
+             *
+             * The authors who have never been checked by the scheduler are always due.
+             *
+             * @param now Current time
+             * @param unreadFirst Put the authors with unread updates before the other ones
+             */
+            [[nodiscard]] db::Authors getDueAuthors(std::time_t now, bool unreadFirst = false) const;
+
+            [[nodiscard]] db::ScheduleData getSchedule(unsigned int authorId) const;
+    };
+}
+
+#endif //SAMLIBINFO_SCHEDULER_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_STAGING_H
+#define SAMLIBINFO_STAGING_H
+
+#include <memory>
+#include <vector>
+#include "db.h"
+#include "parser.h"
+
+namespace staging {
+    /**
+     * @brief The web book which is new or differs from the stored one by size or group.
+     */
+    struct ChangedBook {
+        std::size_t groupIndex = 0;     // index of the group in the list of the web groups
+        std::size_t bookIndex = 0;      // index of the book in its web group
+        bool isNew = true;
+        db::BookData stored;            // the stored book (only its ID, SIZE, GROUP_ID and DATE), unless it's new
+    };
+    using ChangedBooks = std::vector<ChangedBook>;
+
+    /**
+     * @class StagingDiff
+     *
+     * @brief Matches the books and groups found on the author's page with the stored ones inside SQLite.
+     *
+     * The web books and groups are bulk-inserted into the temporary (i.e. per connection, never written to the DB
+     * file) staging tables, and the new, changed and removed ones are found by the indexed joins with the Book and
+     * GroupBook tables. So the stored books of the author are never loaded into memory, only the changed ones are.
+     *
+     * Note, the links of the stored books of an author are expected to be unique (see Book.LINK).
+     *
+     * @throw DBError
+     */
+    class StagingDiff {
+        private:
+            const std::shared_ptr<db::Connection> _con;
+            const std::shared_ptr<db::DB<db::Book>> _tBook;
+            const std::shared_ptr<db::DB<db::GroupBook>> _tGroup;
+            bool _isCreated = false;
+
+            void _createTables();
+
+        public:
+            StagingDiff(const std::shared_ptr<db::Connection>& connection,
+                        const std::shared_ptr<db::DB<db::Book>>& bookDB,
+                        const std::shared_ptr<db::DB<db::GroupBook>>& groupDB);
+
+            /**
+             * @brief Replaces the content of the staging tables with the books and groups from the author's page.
+             */
+            void stage(const db::AuthorData& author, const parser::BookGroupViewsList& webBookGroups);
+
+            /**
+             * @return IDs of the stored groups with the same names as the staged ones (in the order of the web
+             *         groups), the new groups get the negative IDs: -1 for the first web group, -2 for the second etc
+             */
+            [[nodiscard]] std::vector<int> getGroupIds() const;
+
+            /**
+             * @return the staged books which are new or differ from the stored ones, in the order of the web books
+             */
+            [[nodiscard]] ChangedBooks getChangedBooks(const db::AuthorData& author) const;
+
+            /**
+             * @return the stored books of the author which aren't staged
+             */
+            [[nodiscard]] db::Books getRemovedBooks(const db::AuthorData& author) const;
+
+            /**
+             * @return the stored groups of the author which aren't staged
+             */
+            [[nodiscard]] db::GroupBooks getRemovedGroups(const db::AuthorData& author) const;
+    };
+}
+
+#endif //SAMLIBINFO_STAGING_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SAMLIBINFO_STATS_H
+#define SAMLIBINFO_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Lightweight timing instrumentation of the sync pipeline.
+ *
+ * The stages are measured by the scoped timers, e.g.
+ *     {
+ *         stats::ScopedTimer timer(stats::Stage::ParseGroups);
+ *         groups = parser::getBookGroupList(pageText);
+ *     }
+ * Every measurement is added to the aggregated histogram of the stage and to the one of the current author
+ * (see AuthorScope). The collecting is disabled by default, in this case a timer costs one relaxed atomic load.
+ */
+namespace stats {
+    /**
+     * @note the stages may be nested, e.g. FetchGroup includes Download and Decode of the group page
+     */
+    enum class Stage {
+        Author,       // the whole sync of an author
+        FetchPage,    // getting the author's page
+        FetchGroup,   // getting the page of an extended group
+        Download,     // HTTP request itself
+        Throttle,     // waiting for the permission of the rate limiter (see http::HostLimiter)
+        Decode,       // conversion of the page to UTF-8
+        ParseGroups,  // parser::getBookGroupList
+        ParseBooks,   // parser::getBooks on the pages of the extended groups
+        Retrieve,     // reading of the stored books and groups
+        Diff,         // matching of the books on the page with the stored ones (see miner::DiffEngine)
+        Apply,        // writing of the changes into the DB
+        Count
+    };
+
+    enum class Counter {
+        Requests,
+        BytesOnWire,      // the response bodies as they were received, i.e. compressed
+        BytesDownloaded,  // the response bodies after the content decoding (e.g. gzip)
+        BytesDecoded,     // the pages after the conversion to UTF-8
+        Throttled,    // responses "429 Too Many Requests" and "503 Service Unavailable"
+        Retries,      // repeated requests after the transient failures
+        Failures,     // authors whose sync has failed
+        Count
+    };
+
+    const std::size_t STAGES_COUNT = static_cast<std::size_t>(Stage::Count);
+    const std::size_t COUNTERS_COUNT = static_cast<std::size_t>(Counter::Count);
+
+    // the bucket `i` holds the durations in [2^(i-1), 2^i) microseconds
+    const std::size_t HISTOGRAM_BUCKETS = 32;
+
+    struct StageSummary {
+        unsigned long long count = 0;
+        std::chrono::nanoseconds total{0};
+        std::chrono::nanoseconds max{0};
+        std::array<unsigned long long, HISTOGRAM_BUCKETS> buckets{};
+
+        /**
+         * @brief Estimates the percentile by the histogram, i.e. returns the upper bound of the bucket.
+         *
+         * @param percentile Value in [0, 100]
+         */
+        [[nodiscard]] std::chrono::microseconds getPercentile(double percentile) const;
+    };
+
+    struct Summary {
+        std::array<StageSummary, STAGES_COUNT> stages{};
+        std::array<unsigned long long, COUNTERS_COUNT> counters{};
+    };
+
+    struct AuthorSummary {
+        unsigned int authorId;
+        std::string name;
+        Summary summary;
+    };
+
+    void setEnabled(bool isEnabled);
+    bool isEnabled();
+
+    /**
+     * @brief Forgets all collected measurements.
+     */
+    void reset();
+
+    void record(Stage stage, std::chrono::nanoseconds duration);
+    void add(Counter counter, unsigned long long value);
+
+    /**
+     * @brief Attributes the value to the current author (see AuthorScope) only, e.g. when it's already added by
+     *        the thread which doesn't know the author (like the event loop of http::submit()).
+     */
+    void attribute(Counter counter, unsigned long long value);
+
+    [[nodiscard]] const char* getName(Stage stage);
+    [[nodiscard]] const char* getName(Counter counter);
+
+    [[nodiscard]] Summary getSummary();
+    [[nodiscard]] std::vector<AuthorSummary> getAuthorSummaries();
+
+    /**
+     * @brief Renders the collected measurements as a human-readable table: the aggregated latency of every stage
+     * and the per-author totals ordered by the time spent.
+     */
+    [[nodiscard]] std::string getReport();
+
+    class ScopedTimer {
+        private:
+            const Stage _stage;
+            const bool _isEnabled;
+            std::chrono::steady_clock::time_point _start;
+
+        public:
+            explicit ScopedTimer(Stage stage);
+            ~ScopedTimer();
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+    /**
+     * @brief Measures the call of the given function, e.g.
+     *     const auto books = stats::measure(stats::Stage::ParseBooks, [&] { return parser::getBooks(text); });
+     */
+    template <typename Callable>
+    auto measure(Stage stage, Callable&& callable) {
+        ScopedTimer timer(stage);
+        return callable();
+    }
+
+    /**
+     * @brief Attributes the measurements of the current thread to the given author while the object is alive.
+     */
+    class AuthorScope {
+        private:
+            const bool _isEnabled;
+
+        public:
+            AuthorScope(unsigned int authorId, const std::string& name);
+            ~AuthorScope();
+
+            AuthorScope(const AuthorScope&) = delete;
+            AuthorScope& operator=(const AuthorScope&) = delete;
+    };
+}
+
+#endif //SAMLIBINFO_STATS_H
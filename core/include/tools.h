@@ -19,7 +19,10 @@
 #define SAMLIBINFO_TOOLS_H
 
 #include <iostream>
-#include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
 
 // todo: refactor this macros to the normal logging system/class
 // Check if the configuration is Debug
@@ -36,10 +39,35 @@
 
 using Predicate = bool(*)(unsigned char);
 
+// the classes of the bytes (see CHAR_CLASSES), the non-ASCII ones have none
+enum CharClass : unsigned char {
+    CharSpace = 1,          // std::isspace() and `\s` of std::regex in the "C" locale
+    CharPunctuation = 2,    // trimmed from the names and titles (see noisyChar())
+    CharMarkup = 4,         // `<` and `;`, the bytes cleanHtml() has to look at
+};
+
+inline constexpr std::array<unsigned char, 256> CHAR_CLASSES = [] {
+    std::array<unsigned char, 256> classes{};
+    for (const unsigned char ch : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+        classes[ch] |= CharSpace;
+    }
+    for (const unsigned char ch : {',', '.', ':', ';', '@', '-'}) {
+        classes[ch] |= CharPunctuation;
+    }
+    for (const unsigned char ch : {'<', ';'}) {
+        classes[ch] |= CharMarkup;
+    }
+    return classes;
+}();
+
+inline bool isSpaceChar(unsigned char ch)
+{
+    return CHAR_CLASSES[ch] & CharSpace;
+}
+
 inline bool noisyChar(unsigned char ch)
 {
-    static const std::unordered_set<unsigned char> punct = {',', '.', ':', ';', '@', '-'};
-    return !std::isspace(ch) && !punct.contains(ch);
+    return !(CHAR_CLASSES[ch] & (CharSpace | CharPunctuation));
 }
 
 inline void ltrim(std::string &s, Predicate until)
@@ -68,11 +96,16 @@ inline void trim(std::string &s, Predicate until)
     ltrim(s, until);
 }
 
-inline std::string trim_copy(std::string s, Predicate until)
+inline std::string_view trim_view(std::string_view s, Predicate until)
 {
-    rtrim(s, until);
-    ltrim(s, until);
-    return s;
+    const auto begin = std::find_if(s.begin(), s.end(), until);
+    const auto end = std::find_if(s.rbegin(), std::make_reverse_iterator(begin), until).base();
+    return {begin, end};
+}
+
+inline std::string trim_copy(std::string_view s, Predicate until)
+{
+    return std::string(trim_view(s, until));
 }
 
 inline void trim(std::string &s)
@@ -83,6 +116,28 @@ inline void trim(std::string &s)
 
 unsigned long getLevenshteinDistance(const std::string& text1, const std::string& text2);
 
+/**
+ * @brief Calculates normalized similarity of two strings based on the Levenshtein distance.
+ *
+ * @return value in range [0, 1], where 1 means the strings are equal and 0 - they have nothing in common
+ */
+double getSimilarity(const std::string& text1, const std::string& text2);
+
+/**
+ * @brief Replaces all occurrences of the `search` (if it isn't empty), in linear time.
+ */
 void replaceAll(std::string& input, const std::string& search, const std::string& replacement);
 
+/**
+ * @brief Converts the HTML fragment (e.g. the description of a book) to the plain text in a single pass.
+ *
+ * The result is the same as of the sequence of the replacements:
+ * 1. `<dd>`, `<br>` and `<br/>` (in any case) with `\n`;
+ * 2. the tags (`<\/?(\S+?)[^>]*?>`) with nothing;
+ * 3. the runs of 2 or more whitespaces with a single space;
+ * 4. the leading and trailing spaces with nothing;
+ * 5. `&#8212;` with `-`.
+ */
+std::string cleanHtml(std::string_view html);
+
 #endif //SAMLIBINFO_TOOLS_H
@@ -23,6 +23,9 @@ void Agent::initDB() {
     this->_tAuthor->createTable();
     this->_tGroup->createTable();
     this->_tBook->createTable();
+    this->_scheduler->createTable();
+    this->_journal->createTable();
+    // the search index is created by the first search or indexing (it needs FTS5, the rest of the commands don't)
 }
 
 Agent::Agent(const std::string& dbPath, const std::string& bookStorageLocation, const std::shared_ptr<logger::Logger>& logger) :
@@ -31,8 +34,11 @@ Agent::Agent(const std::string& dbPath, const std::string& bookStorageLocation,
   _tAuthor(std::make_shared<db::DB<db::Author>>(_con)),
   _tBook(std::make_shared<db::DB<db::Book>>(_con)),
   _tGroup(std::make_shared<db::DB<db::GroupBook>>(_con)),
-  _miner(std::make_unique<miner::Miner>(_con, _logger, _tAuthor, _tGroup, _tBook)),
-  _storage(std::make_unique<fs::BookStorage>(bookStorageLocation))
+  _scheduler(std::make_shared<scheduler::Scheduler>(_con, _tAuthor)),
+  _journal(std::make_shared<journal::SyncJournal>(_con)),
+  _miner(std::make_unique<miner::Miner>(_con, _logger, _tAuthor, _tGroup, _tBook, _scheduler, _journal)),
+  _storage(std::make_unique<fs::BookStorage>(bookStorageLocation)),
+  _searchIndex(std::make_unique<db::SearchIndex>(_con))
   {}
 
 Agent::Agent(const std::string& dbPath, const std::string& bookStorageLocation) :
@@ -41,12 +47,19 @@ Agent::Agent(const std::string& dbPath, const std::string& bookStorageLocation)
     _tAuthor(std::make_shared<db::DB<db::Author>>(_con)),
     _tBook(std::make_shared<db::DB<db::Book>>(_con)),
     _tGroup(std::make_shared<db::DB<db::GroupBook>>(_con)),
-    _miner(std::make_unique<miner::Miner>(_con, _logger, _tAuthor, _tGroup, _tBook)),
-    _storage(std::make_unique<fs::BookStorage>(bookStorageLocation))
+    _scheduler(std::make_shared<scheduler::Scheduler>(_con, _tAuthor)),
+    _journal(std::make_shared<journal::SyncJournal>(_con)),
+    _miner(std::make_unique<miner::Miner>(_con, _logger, _tAuthor, _tGroup, _tBook, _scheduler, _journal)),
+    _storage(std::make_unique<fs::BookStorage>(bookStorageLocation)),
+    _searchIndex(std::make_unique<db::SearchIndex>(_con))
 {}
 
-void Agent::checkUpdates() {
-    this->_miner->syncAll();
+void Agent::checkUpdates(bool resume) {
+    this->_miner->syncAll(resume, [](const db::AuthorData&, unsigned int, unsigned int){});
+}
+
+void Agent::checkDueUpdates(bool unreadFirst) {
+    this->_miner->syncDue(unreadFirst, [](const db::AuthorData&, unsigned int, unsigned int){});
 }
 
 db::Authors Agent::getAuthors(bool updatesOnly) {
@@ -278,6 +291,7 @@ void Agent::removeAuthor(unsigned int id) {
     try {
         this->_tBook->remove(whereAuthorId);
         this->_tGroup->remove(whereAuthorId);
+        this->_scheduler->remove(id);
         this->_tAuthor->remove(db::WhereMe(id));
     } catch (const db::DBError &err) {
         this->_logger->error << "Cannot remove data for the author #" << id
@@ -286,35 +300,59 @@ void Agent::removeAuthor(unsigned int id) {
         return;
     }
     this->_tAuthor->commit();
-    this->_logger->debug << "All data about author #" << id << "\" was removed from the DB." << std::endl;
+    LOG_DEBUG(this->_logger) << "All data about author #" << id << "\" was removed from the DB." << std::endl;
 }
 
 void Agent::removeAuthor(const db::AuthorData &author) {
     this->removeAuthor(author.id);
 }
 
-std::string Agent::_fetchBookAsHTML(const db::BookData &book) const {
+std::string Agent::_storeBook(const db::BookData& book, const std::string& content, fs::BookType bookType) const {
     auto bookUrl = book.link;
-    auto url = http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, bookUrl + ".shtml");
-    auto bookText = http::get(url);
+    auto fileName = this->_storage->ensurePath(bookUrl, bookType);
+
+    std::ofstream outFile(fileName, std::ios::binary);
 
-    if (bookText.empty()) {
-        this->_logger->warning << "Cannot get text of the book \"" << book.title << "\" (" << url << ")" << std::endl;
+    if (!outFile.is_open()) {
         return std::string{};
     }
 
-    auto fileName = this->_storage->ensurePath(bookUrl, fs::BookType::HTML);
+    outFile << content;
+    outFile.close();
 
-    std::ofstream outFile(fileName);
+    LOG_DEBUG(this->_logger) << "The book \"" << book.title << "\" is downloaded into file://" << fileName << std::endl;
 
-    if (!outFile.is_open()) {
-        return std::string{};
+    return fileName;
+}
+
+void Agent::_indexBook(const db::BookData& book, const std::string& text) const {
+    try {
+        this->_searchIndex->setText(book.id, text);
+    } catch (const db::DBError& err) {
+        this->_logger->warning << "Cannot index text of the book \"" << book.title << "\": " << err.what()
+                               << std::endl;
     }
+}
 
-    outFile << bookText;
-    outFile.close();
+std::string Agent::_getBookUrl(const db::BookData& book, fs::BookType bookType) {
+    const auto& site = http::getSettings();
+    return http::toUrl(site.protocol, site.domain, book.link + (bookType == fs::BookType::FB2 ? ".fb2.zip" : ".shtml"));
+}
+
+std::string Agent::_fetchBookAsHTML(const db::BookData &book) const {
+    const auto url = _getBookUrl(book, fs::BookType::HTML);
+    const auto response = http::fetch(url);
+
+    if (!response.isOk()) {
+        this->_logger->warning << "Cannot get text of the book \"" << book.title << "\" (" << url << "): "
+                               << response.error << std::endl;
+        return std::string{};
+    }
 
-    this->_logger->debug << "The book \"" << book.title << "\" is downloaded into file://" << fileName << std::endl;
+    auto fileName = this->_storeBook(book, response.text, fs::BookType::HTML);
+    if (!fileName.empty() && this->_indexBookText) {
+        this->_indexBook(book, parser::getText(response.text));
+    }
 
     return fileName;
 }
@@ -322,14 +360,15 @@ std::string Agent::_fetchBookAsHTML(const db::BookData &book) const {
 std::string Agent::_fetchBookAsFB2(const db::BookData &book) const {
     auto bookUrl = book.link;
     const auto fileName = this->_storage->ensurePath(bookUrl);
-    auto url = http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, bookUrl + ".fb2.zip");
 
-    if (!http::fetchToFile(url, fileName)) {
-        this->_logger->warning << "Cannot download book \"" << book.title << "\" in FB2 format." << std::endl;
+    const auto status = http::fetchToFile(_getBookUrl(book, fs::BookType::FB2), fileName);
+    if (status != http::Status::Ok) {
+        this->_logger->warning << "Cannot download book \"" << book.title << "\" in FB2 format ("
+                               << http::getName(status) << ")." << std::endl;
         return std::string{};
     }
 
-    this->_logger->debug << "The book \"" << book.title << "\" is downloaded into file://" << fileName << std::endl;
+    LOG_DEBUG(this->_logger) << "The book \"" << book.title << "\" is downloaded into file://" << fileName << std::endl;
     return fileName;
 }
 
@@ -359,3 +398,100 @@ std::string Agent::getPathToBook(const db::BookData& book) {
 
     return this->fetchBook(book);
 }
+
+db::Books Agent::search(const std::string& query, unsigned int limit) {
+    this->_searchIndex->createIndex();
+    return this->_searchIndex->search(query, limit);
+}
+
+void Agent::setBookTextIndexing(bool enable) {
+    if (enable) {
+        this->_searchIndex->createIndex();
+    }
+    this->_indexBookText = enable;
+}
+
+void Agent::setDiffEngine(miner::DiffEngine engine) {
+    this->_miner->setDiffEngine(engine);
+}
+
+void Agent::setPipeline(const miner::PipelineSettings& settings) {
+    this->_miner->setPipeline(settings);
+}
+
+std::vector<pipeline::StageStats> Agent::getPipelineStats() const {
+    return this->_miner->getPipelineStats();
+}
+
+
+
+AsyncAgent::AsyncAgent(Agent& agent) : _agent(agent) {}
+
+async::Task<db::AuthorData> AsyncAgent::addAuthor(std::string url) {
+    db::AuthorData author;
+    try {
+        author = co_await this->_agent._miner->getAuthorAsync(std::move(url));
+    }
+    catch (miner::AuthorNotFound& err) {
+        co_return author;
+    }
+    catch (miner::InvalidURL& err) {
+        co_return author;
+    }
+
+    author = co_await this->_dbStrand.run([this, &author] {
+        const auto lock = this->_agent._miner->lockDB();
+        auto whereUrl = db::Where("URL='" + author.url + "'");
+        if (this->_agent._tAuthor->exists(whereUrl)) {
+            this->_agent._logger->warning << "Author \"" << author.name << "\" already is in the DB. " << std::endl;
+            return this->_agent._tAuthor->get(whereUrl);
+        }
+        return this->_agent._tAuthor->add(author);
+    });
+
+    co_return co_await this->_agent._miner->syncAsync(std::move(author), this->_dbStrand);
+}
+
+async::Task<db::AuthorData> AsyncAgent::sync(db::AuthorData author) {
+    co_return co_await this->_agent._miner->syncAsync(std::move(author), this->_dbStrand);
+}
+
+async::Task<void> AsyncAgent::checkUpdates(unsigned int concurrency) {
+    co_await this->_agent._miner->syncAllAsync(this->_dbStrand, concurrency);
+}
+
+async::Task<std::string> AsyncAgent::fetchBook(db::BookData book, fs::BookType bookType) {
+    if (bookType == fs::BookType::FB2) {
+        const auto response = co_await http::fetchRawAsync(Agent::_getBookUrl(book, fs::BookType::FB2));
+        if (response.isOk()) {
+            co_return this->_agent._storeBook(book, response.text, fs::BookType::FB2);
+        }
+
+        this->_agent._logger->warning << "Cannot download book \"" << book.title << "\" in FB2 format ("
+                                      << http::getName(response.status) << ")." << std::endl;
+        this->_agent._logger->info << "Trying to load book \"" << book.title << "\" as HTML..." << std::endl;
+    }
+
+    const auto url = Agent::_getBookUrl(book, fs::BookType::HTML);
+    const auto response = co_await http::fetchAsync(url);
+    if (!response.isOk()) {
+        this->_agent._logger->warning << "Cannot get text of the book \"" << book.title << "\" (" << url << "): "
+                                      << response.error << std::endl;
+        co_return std::string{};
+    }
+
+    auto fileName = this->_agent._storeBook(book, response.text, fs::BookType::HTML);
+    if (!fileName.empty() && this->_agent._indexBookText) {
+        co_await this->_dbStrand.run([this, &book, text = parser::getText(response.text)] {
+            const auto lock = this->_agent._miner->lockDB();
+            this->_agent._indexBook(book, text);
+        });
+    }
+
+    co_return fileName;
+}
+
+async::Task<std::string> AsyncAgent::fetchBook(unsigned int bookId, fs::BookType bookType) {
+    auto book = co_await this->query([bookId](Agent& agent) {return agent.getBook(bookId);});
+    co_return co_await this->fetchBook(std::move(book), bookType);
+}
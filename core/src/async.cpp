@@ -0,0 +1,61 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "async.h"
+
+using namespace async;
+
+
+Strand::Strand() : _thread([this] {this->_work();}) {}
+
+Strand::~Strand() {
+    {
+        const std::lock_guard lock(this->_mutex);
+        this->_isStopped = true;
+    }
+    this->_wakeUp.notify_one();
+    this->_thread.join();
+}
+
+void Strand::post(executor::Task task) {
+    {
+        const std::lock_guard lock(this->_mutex);
+        this->_tasks.push_back(std::move(task));
+    }
+    this->_wakeUp.notify_one();
+}
+
+bool Strand::isCurrent() const {
+    return std::this_thread::get_id() == this->_thread.get_id();
+}
+
+void Strand::_work() {
+    while (true) {
+        executor::Task task;
+        {
+            std::unique_lock lock(this->_mutex);
+            this->_wakeUp.wait(lock, [this] {return !this->_tasks.empty() || this->_isStopped;});
+            if (this->_tasks.empty()) {
+                return;     // stopped
+            }
+
+            task = std::move(this->_tasks.front());
+            this->_tasks.pop_front();
+        }
+
+        task();
+    }
+}
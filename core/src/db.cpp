@@ -36,10 +36,67 @@ Connection::Connection(const std::string& dbPath) {
     if(rc!= SQLITE_OK) {
         throw DBError(static_cast<std::string>("Can't open database: ") + sqlite3_errmsg(this->session));
     }
+    sqlite3_busy_timeout(this->session, BUSY_TIMEOUT_MS);
 }
 
 Connection::~Connection() { sqlite3_close(this->session); }
 
+void Connection::_exec(const std::string& sql) {
+    char *zErrMsg = nullptr;
+    if (sqlite3_exec(this->session, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK) {
+        const std::string errMsg(zErrMsg);
+        sqlite3_free(zErrMsg);
+        throw QueryError(errMsg);
+    }
+    sqlite3_free(zErrMsg);
+}
+
+void Connection::begin() {
+    if (this->_transactionDepth == 0) {
+        // the transactions are used to write, so the lock is taken at once: the busy timeout isn't applied to
+        // a transaction which has read the DB and then waits for another one to write
+        this->_exec("BEGIN IMMEDIATE TRANSACTION;");
+    } else {
+        this->_exec("SAVEPOINT sp_" + std::to_string(this->_transactionDepth) + ";");
+    }
+    this->_transactionDepth++;
+}
+
+void Connection::commit() {
+    if (this->_transactionDepth <= 1) {
+        try {
+            this->_exec("COMMIT;");
+        } catch (const QueryError&) {
+            // SQLite keeps the transaction open if it cannot be committed (e.g. the DB is busy), so the following
+            // changes would never be committed as well
+            sqlite3_exec(this->session, "ROLLBACK;", NULL, NULL, nullptr);
+            this->_transactionDepth = 0;
+            throw;
+        }
+        this->_transactionDepth = 0;
+        return;
+    }
+
+    this->_exec("RELEASE SAVEPOINT sp_" + std::to_string(this->_transactionDepth - 1) + ";");
+    this->_transactionDepth--;
+}
+
+void Connection::rollback() {
+    if (this->_transactionDepth <= 1) {
+        sqlite3_exec(this->session, "ROLLBACK;", NULL, NULL, nullptr);
+        this->_transactionDepth = 0;
+        return;
+    }
+
+    // rolling back to a savepoint doesn't remove it, so it's released as well
+    const auto savepoint = "sp_" + std::to_string(this->_transactionDepth - 1);
+    sqlite3_exec(
+        this->session, ("ROLLBACK TO SAVEPOINT " + savepoint + "; RELEASE SAVEPOINT " + savepoint + ";").c_str(),
+        NULL, NULL, nullptr
+    );
+    this->_transactionDepth--;
+}
+
 
 Where::Where(const Where& other) : _value(other._value) {}
 Where::operator std::string() const { return this->_value; }
@@ -91,3 +148,157 @@ template<> WhereIdIs<db::GroupBookData>::WhereIdIs(unsigned int id) : Where("GRO
 WhereBookIs::WhereBookIs(const BookData& book) : Where("BOOK_ID = " + std::to_string(book.id)) {}
 WhereGroupIs::WhereGroupIs(const GroupBookData& group) : Where("GROUP_ID = " + std::to_string(group.id)) {}
 WhereAuthorIs::WhereAuthorIs(const AuthorData& author) : Where("AUTHOR_ID = " + std::to_string(author.id)) {}
+
+
+void SearchIndex::_exec(const std::string& sql) {
+    char *zErrMsg = nullptr;
+    if (sqlite3_exec(this->_con->session, sql.c_str(), nullptr, nullptr, &zErrMsg) != SQLITE_OK) {
+        const std::string errMsg(zErrMsg);
+        sqlite3_free(zErrMsg);
+        throw QueryError(errMsg);
+    }
+}
+
+bool SearchIndex::_isTableExists() {
+    bool exists = false;
+    const std::string sql = "SELECT name FROM sqlite_master WHERE type='table' AND name='" + getTable() + "'";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(this->_con->session, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+
+    return exists;
+}
+
+std::string SearchIndex::getCrateTableQuery() {
+    const auto table = getTable();
+    const auto book = Book::getTable();
+
+    return std::string(
+        "CREATE VIRTUAL TABLE IF NOT EXISTS " + table + " USING fts5(\n"
+        "    TITLE, DESCRIPTION, FORM, AUTHOR, TEXT,\n"
+        "    tokenize = 'unicode61 remove_diacritics 2'\n"
+        ");\n"
+        "\n"
+        "CREATE TRIGGER IF NOT EXISTS trg_book_search_insert AFTER INSERT ON " + book + " BEGIN\n"
+        "    INSERT INTO " + table + " (rowid, TITLE, DESCRIPTION, FORM, AUTHOR, TEXT)\n"
+        "    VALUES (new._id, new.TITLE, new.DESCRIPTION, new.FORM, new.AUTHOR, '');\n"
+        "END;\n"
+        "CREATE TRIGGER IF NOT EXISTS trg_book_search_update\n"
+        "AFTER UPDATE OF TITLE, DESCRIPTION, FORM, AUTHOR ON " + book + " BEGIN\n"
+        "    UPDATE " + table + " SET TITLE = new.TITLE, DESCRIPTION = new.DESCRIPTION, FORM = new.FORM,\n"
+        "                             AUTHOR = new.AUTHOR\n"
+        "    WHERE rowid = old._id;\n"
+        "END;\n"
+        "CREATE TRIGGER IF NOT EXISTS trg_book_search_delete AFTER DELETE ON " + book + " BEGIN\n"
+        "    DELETE FROM " + table + " WHERE rowid = old._id;\n"
+        "END;\n"
+    );
+}
+
+std::string SearchIndex::toMatchQuery(const std::string& text) {
+    std::string query;
+    std::istringstream words(text);
+    std::string word;
+
+    while (words >> word) {
+        std::erase(word, '"');
+        if (word.empty()) {
+            continue;
+        }
+
+        if (!query.empty()) {
+            query += " ";
+        }
+        query += "\"" + word + "\"*";
+    }
+
+    return query;
+}
+
+bool SearchIndex::isAvailable() {
+    return sqlite3_compileoption_used("ENABLE_FTS5");
+}
+
+void SearchIndex::createIndex() {
+    if (!isAvailable()) {
+        throw DBError("The full-text search isn't available: SQLite is built without FTS5");
+    }
+
+    const bool isNew = !this->_isTableExists();
+    this->_exec(getCrateTableQuery());
+
+    if (isNew) {
+        this->rebuild();
+    }
+}
+
+void SearchIndex::rebuild() {
+    this->_exec(
+        "DELETE FROM " + getTable() + ";\n"
+        "INSERT INTO " + getTable() + " (rowid, TITLE, DESCRIPTION, FORM, AUTHOR, TEXT)\n"
+        "SELECT _id, TITLE, DESCRIPTION, FORM, AUTHOR, '' FROM " + Book::getTable() + ";"
+    );
+}
+
+void SearchIndex::setText(unsigned int bookId, const std::string& text) {
+    const std::string sql = "UPDATE " + getTable() + " SET TEXT = ? WHERE rowid = ?";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(this->_con->session, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw QueryError(sqlite3_errmsg(this->_con->session));
+    }
+
+    sqlite3_bind_text(stmt, 1, text.c_str(), static_cast<int>(text.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, static_cast<int>(bookId));
+    const auto rc = sqlite3_step(stmt);
+    const std::string errMsg = rc == SQLITE_DONE ? "" : sqlite3_errmsg(this->_con->session);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        throw QueryError(errMsg);
+    }
+}
+
+Books SearchIndex::search(const std::string& query, unsigned int limit) {
+    Books books;
+    const auto matchQuery = toMatchQuery(query);
+    if (matchQuery.empty()) {
+        return books;
+    }
+
+    // weights of the columns: TITLE, DESCRIPTION, FORM, AUTHOR, TEXT
+    const std::string sql =
+        "SELECT " + Book::getTable() + ".* FROM " + getTable() +
+        " JOIN " + Book::getTable() + " ON " + Book::getTable() + "._id = " + getTable() + ".rowid"
+        " WHERE " + getTable() + " MATCH ?"
+        " ORDER BY bm25(" + getTable() + ", 10.0, 2.0, 3.0, 5.0, 1.0)"
+        " LIMIT ?";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(this->_con->session, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw QueryError(sqlite3_errmsg(this->_con->session));
+    }
+
+    sqlite3_bind_text(stmt, 1, matchQuery.c_str(), static_cast<int>(matchQuery.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, static_cast<int>(limit));
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        BookData book;
+        for (int i = 0; i < sqlite3_column_count(stmt); i++) {
+            Book::load(book, sqlite3_column_name(stmt, i), reinterpret_cast<const char*>(sqlite3_column_text(stmt, i)));
+        }
+        books.push_back(std::move(book));
+    }
+    const std::string errMsg = rc == SQLITE_DONE ? "" : sqlite3_errmsg(this->_con->session);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        throw QueryError(errMsg);
+    }
+
+    return books;
+}
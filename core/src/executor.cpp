@@ -0,0 +1,215 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include "executor.h"
+
+using namespace executor;
+
+namespace {
+    // the executor and the index of the worker the current thread belongs to
+    thread_local const Executor* currentExecutor = nullptr;
+    thread_local std::size_t currentWorker = 0;
+
+    // how long TaskGroup::wait() sleeps before it checks the queues again (the tasks of the group may be run by the
+    // workers, while new tasks of the other groups appear)
+    const std::chrono::milliseconds WAIT_SLICE{1};
+}
+
+
+unsigned int executor::getDefaultConcurrency() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+Executor& executor::getShared() {
+    static Executor shared;
+    return shared;
+}
+
+
+Executor::Executor(unsigned int concurrency) {
+    if (!concurrency) {
+        concurrency = getDefaultConcurrency();
+    }
+
+    this->_workers.reserve(concurrency);
+    for (unsigned int i = 0; i < concurrency; i++) {
+        this->_workers.push_back(std::make_unique<Worker>());
+    }
+
+    this->_threads.reserve(concurrency);
+    for (std::size_t i = 0; i < concurrency; i++) {
+        this->_threads.emplace_back([this, i](const std::stop_token& stopToken) {this->_work(stopToken, i);});
+    }
+}
+
+Executor::~Executor() {
+    for (auto& thread : this->_threads) {
+        thread.request_stop();
+    }
+    this->_wakeUp.notify_all();
+    this->_threads.clear();     // joins
+}
+
+bool Executor::isWorker() const {
+    return currentExecutor == this;
+}
+
+void Executor::post(Task task) {
+    if (this->isWorker()) {
+        auto& worker = *this->_workers[currentWorker];
+        const std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    } else {
+        const std::lock_guard lock(this->_mutex);
+        this->_injected.push_back(std::move(task));
+    }
+
+    this->_pending.fetch_add(1);
+    {
+        // the waiting worker checks the counter under this lock, so the notification can't get lost
+        const std::lock_guard lock(this->_mutex);
+    }
+    this->_wakeUp.notify_one();
+}
+
+std::optional<Task> Executor::_take(std::size_t index) {
+    if (!this->_pending.load()) {
+        return std::nullopt;
+    }
+
+    const auto count = this->_workers.size();
+    if (index < count) {
+        // own tasks first, the newest one
+        auto& worker = *this->_workers[index];
+        const std::lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            std::optional<Task> task(std::move(worker.tasks.back()));
+            worker.tasks.pop_back();
+            this->_pending.fetch_sub(1);
+            return task;
+        }
+    }
+
+    {
+        const std::lock_guard lock(this->_mutex);
+        if (!this->_injected.empty()) {
+            std::optional<Task> task(std::move(this->_injected.front()));
+            this->_injected.pop_front();
+            this->_pending.fetch_sub(1);
+            return task;
+        }
+    }
+
+    // steal the oldest task of another worker, starting from the next one so the thieves don't crowd the same deque
+    for (std::size_t i = 1; i <= count; i++) {
+        auto& victim = *this->_workers[(index + i) % count];
+        const std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            std::optional<Task> task(std::move(victim.tasks.front()));
+            victim.tasks.pop_front();
+            this->_pending.fetch_sub(1);
+            return task;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void Executor::_work(const std::stop_token& stopToken, std::size_t index) {
+    currentExecutor = this;
+    currentWorker = index;
+
+    while (true) {
+        if (auto task = this->_take(index)) {
+            (*task)();
+            continue;
+        }
+        if (stopToken.stop_requested()) {
+            break;  // the queued tasks are done, the running ones take their own new tasks
+        }
+
+        std::unique_lock lock(this->_mutex);
+        this->_wakeUp.wait(lock, stopToken, [this] {return this->_pending.load() > 0;});
+    }
+}
+
+bool Executor::runPendingTask() {
+    auto task = this->_take(this->isWorker() ? currentWorker : this->_workers.size());
+    if (!task) {
+        return false;
+    }
+
+    (*task)();
+    return true;
+}
+
+
+TaskGroup::TaskGroup(Executor& executor) : _executor(executor) {}
+
+TaskGroup::~TaskGroup() {
+    this->cancel();
+    this->_waitAll();
+}
+
+void TaskGroup::_onStarted() {
+    const std::lock_guard lock(this->_mutex);
+    this->_active++;
+}
+
+void TaskGroup::_onFinished(std::exception_ptr error) {
+    if (error) {
+        this->cancel();
+    }
+
+    // notified under the lock: the group may be destroyed as soon as the waiting thread sees no active tasks
+    const std::lock_guard lock(this->_mutex);
+    if (error && !this->_error) {
+        this->_error = std::move(error);
+    }
+    this->_active--;
+    this->_finished.notify_all();
+}
+
+void TaskGroup::_waitAll() {
+    std::unique_lock lock(this->_mutex);
+    while (this->_active) {
+        lock.unlock();
+        const auto hasRun = this->_executor.runPendingTask();
+        lock.lock();
+
+        if (!hasRun) {
+            this->_finished.wait_for(lock, WAIT_SLICE, [this] {return !this->_active;});
+        }
+    }
+}
+
+void TaskGroup::cancel() {
+    this->_stopSource.request_stop();
+}
+
+void TaskGroup::wait() {
+    this->_waitAll();
+
+    std::exception_ptr error;
+    {
+        const std::lock_guard lock(this->_mutex);
+        std::swap(error, this->_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -54,7 +54,7 @@ std::filesystem::path fs::path::ensure(const std::string &path, bool stripFileNa
     }
 
     try {
-        if (std::filesystem::create_directories(directory)) {
+        if (!std::filesystem::create_directories(directory)) {
             throw FSError("Cannot create directories for the path \"" + directory.string() + "\"");
         }
     }
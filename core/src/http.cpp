@@ -19,13 +19,30 @@
 #include <curl/curl.h>
 #include <filesystem>
 #include <cstdio>
+#include <functional>
+#include <list>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include "http.h"
+#include "stats.h"
 
 using namespace http;
 
+static Settings settings;
 
-std::string toUtf8(const std::string& str)
+void http::configure(const Settings& newSettings) {
+    settings = newSettings;
+    resetLimiters();
+}
+
+const Settings& http::getSettings() {
+    return settings;
+}
+
+std::string http::toUtf8(const std::string& str)
 {
+    stats::ScopedTimer timer(stats::Stage::Decode);
     const auto fromCode = "WINDOWS-1251";
     const auto toCode = "UTF-8";
     const auto ERROR_ICONV_OPEN = (iconv_t) - 1;
@@ -50,6 +67,7 @@ std::string toUtf8(const std::string& str)
     *outBuf = 0; // Null-terminate the output string
 
     std::string result(origOutBuf);
+    stats::add(stats::Counter::BytesDecoded, result.size());
 
     delete[] origInBuf;
     delete[] origOutBuf;
@@ -60,82 +78,467 @@ std::string toUtf8(const std::string& str)
 }
 
 
+const char* http::getName(Status status) {
+    switch (status) {
+        case Status::Ok:        return "ok";
+        case Status::NotFound:  return "not found";
+        case Status::Transient: return "transient";
+        case Status::Permanent: return "permanent";
+        default:                return "unknown";
+    }
+}
+
 // The libcurl callback function that is called after each chunk of data is received
 static size_t _writeCallback(void* contents, size_t size, size_t nmemb, void* userp)
 {
     // probably it might be convenient to change encoding here
     ((std::string*)userp)->append((char*)contents, size * nmemb);
+    stats::add(stats::Counter::BytesDownloaded, size * nmemb);
     return size * nmemb;
 }
 
 size_t _writeDataFoFile(void* ptr, size_t size, size_t nmemb, FILE* stream) {
     size_t written = fwrite(ptr, size, nmemb, stream);
+    stats::add(stats::Counter::BytesDownloaded, written * size);
     return written;
 }
 
+static std::chrono::seconds getRetryAfter(CURL* curl) {
+    curl_off_t retryAfter = 0;
+    curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retryAfter);
+    return std::chrono::seconds(retryAfter);
+}
+
+static Status classify(CURLcode code) {
+    switch (code) {
+        case CURLE_OK:
+            return Status::Ok;
+        case CURLE_COULDNT_RESOLVE_PROXY:
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+            return Status::Transient;
+        default:
+            return Status::Permanent;
+    }
+}
+
+static Status classify(long httpCode) {
+    if (httpCode == 200) {
+        return Status::Ok;
+    }
+    if (httpCode == 404 || httpCode == 410) {
+        return Status::NotFound;
+    }
+    if (httpCode == 408 || httpCode == 429 || httpCode >= 500) {
+        return Status::Transient;
+    }
+    return Status::Permanent;
+}
+
+// the exponential backoff with the jitter, so the clients that failed together don't retry together
+static std::chrono::milliseconds getRetryDelay(unsigned int attempt) {
+    thread_local std::mt19937 generator{std::random_device{}()};
+
+    const auto& site = getSettings();
+    const auto delay = std::min<std::chrono::milliseconds>(
+        site.retryDelay * (1LL << std::min(attempt, 20u)), site.maxRetryDelay
+    );
+    std::uniform_int_distribution<long long> distribution(delay.count() / 2, delay.count());
+    return std::chrono::milliseconds(distribution(generator));
+}
+
+static void prepare(CURL* curl, const std::string& url) {
+    const auto& site = getSettings();
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(site.timeout.count()));
+    if (site.compression) {
+        // the empty string means all encodings supported by curl, it decodes the body before the write callback
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
+}
+
+// fills the response by the result of the attempt, returns the HTTP code to report to the host's limiter
+static long readResult(CURL* curl, CURLcode res, Response& response) {
+    stats::add(stats::Counter::Requests, 1);
+
+    curl_off_t wireSize = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wireSize);
+    response.wireSize = static_cast<std::size_t>(wireSize);
+    stats::add(stats::Counter::BytesOnWire, response.wireSize);
+
+    response.httpCode = 0;
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.httpCode);
+        response.status = classify(response.httpCode);
+        response.error = response.isOk() ? "" : "HTTP status " + std::to_string(response.httpCode);
+    } else {
+        response.status = classify(res);
+        response.error = curl_easy_strerror(res);
+    }
+
+    if (isThrottled(response.httpCode)) {
+        stats::add(stats::Counter::Throttled, 1);
+    }
+
+    return response.httpCode;
+}
+
+static bool isRetried(const Response& response, unsigned int attempt) {
+    if (response.status != Status::Transient || attempt >= getSettings().retries) {
+        return false;
+    }
+
+    stats::add(stats::Counter::Retries, 1);
+    return true;
+}
+
+/**
+ * Performs the request prepared in the `curl` handle: waits for the permission of the host's limiter and repeats the
+ * request in case of transient failures. The `reset` is called before every attempt to drop the partial result.
+ */
+static Response perform(CURL* curl, const std::string& url, const std::function<void()>& reset) {
+    prepare(curl, url);
+
+    Response response;
+    for (unsigned int attempt = 0; ; attempt++) {
+        {
+            Permit permit(url);
+            reset();
+
+            CURLcode res;
+            {
+                stats::ScopedTimer timer(stats::Stage::Download);
+                res = curl_easy_perform(curl);
+            }
+            permit.setResponse(readResult(curl, res, response), getRetryAfter(curl));
+        }
+
+        if (!isRetried(response, attempt)) {
+            return response;
+        }
+        std::this_thread::sleep_for(getRetryDelay(attempt));
+    }
+}
+
 // The fetchHtml function that accepts a URL as input and uses libcurl to make a GET request to that URL, returning the HTML contents as a string
-Page http::get(const std::string &url) {
+Response http::fetchRaw(const std::string &url) {
     CURL* curl = curl_easy_init();
-    CURLcode res;
+    if (!curl) {
+        throw HTTPError("cannot initialize curl");
+    }
+
     Page readBuffer;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+    auto response = perform(curl, url, [&readBuffer] { readBuffer.clear(); });
+    curl_easy_cleanup(curl);
+
+    if (response.isOk()) {
+        response.text = std::move(readBuffer);
+    }
 
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-        res = curl_easy_perform(curl);
+    return response;
+}
+
+Response http::fetch(const std::string &url) {
+    auto response = fetchRaw(url);
+    if (response.isOk()) {
+        response.text = toUtf8(response.text);
+    }
+
+    return response;
+}
+
+Page http::get(const std::string &url) {
+    auto response = fetch(url);
+    switch (response.status) {
+        case Status::Ok:
+            return std::move(response.text);
+        case Status::NotFound:
+            return Page{};
+        default:
+            throw HTTPError("cannot get \"" + url + "\" (" + getName(response.status) + "): " + response.error);
+    }
+}
+
+
+Status http::fetchToFile(const std::string& url, const std::string& filePath) {
+    FILE* fp = fopen(filePath.c_str(),"wb");
+    if (!fp) {
+        return Status::Permanent;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        fclose(fp);
+        std::remove(filePath.c_str());
+        return Status::Permanent;
+    }
 
-        // Check for errors
-        if (res != CURLE_OK) {
-            auto errorMessage = curl_easy_strerror(res);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _writeDataFoFile);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+    const auto response = perform(curl, url, [&] {
+        // drop the content of the failed attempt
+        fflush(fp);
+        rewind(fp);
+        std::filesystem::resize_file(filePath, 0);
+    });
+    curl_easy_cleanup(curl);
+    fclose(fp);
+
+    if (!response.isOk()) {
+        if (std::filesystem::exists(filePath)) {
+            std::remove(filePath.c_str());
+        }
+    }
+
+    return response.status;
+}
+
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // the event loop checks the limiters at least this often, the connections may be released by the blocking
+    // requests of the other threads, which don't wake it up
+    const std::chrono::milliseconds MAX_POLL_INTERVAL{50};
+
+    struct Transfer {
+        std::string url;
+        std::function<void(Response)> onDone;
+        HostLimiter* limiter = nullptr;
+        CURL* curl = nullptr;
+        Page body;
+        unsigned int attempt = 0;
+        Clock::time_point notBefore;    // the next attempt is delayed (see getRetryDelay())
+        Clock::time_point queued = Clock::now();   // since the transfer waits for the limiter
+        Clock::time_point started;
+    };
+
+    /**
+     * The single thread which runs all non-blocking requests (see http::submit()) with the curl's multi interface.
+     */
+    class EventLoop {
+        private:
+            std::mutex _mutex;
+            std::vector<std::unique_ptr<Transfer>> _submitted;  // guarded by the _mutex
+            bool _isStopped = false;                            // guarded by the _mutex
+            CURLM* _multi;
+
+            // the rest is used by the thread of the loop only
+            std::list<std::unique_ptr<Transfer>> _waiting;      // for the limiter or the retry delay
+            std::unordered_map<CURL*, std::unique_ptr<Transfer>> _running;
+            std::thread _thread;
+
+            // starts the transfers allowed by their limiters, returns the time to check the rest of them again
+            Clock::time_point _startWaiting();
+            void _start(std::unique_ptr<Transfer> transfer);
+            void _finish(CURL* curl, CURLcode res);
+            void _run();
+
+        public:
+            EventLoop();
+            ~EventLoop();
+
+            void submit(std::unique_ptr<Transfer> transfer);
+    };
+
+    EventLoop::EventLoop() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        this->_multi = curl_multi_init();
+        if (!this->_multi) {
+            throw HTTPError("cannot initialize curl");
+        }
+        this->_thread = std::thread([this] {this->_run();});
+    }
+
+    // the transfers in progress are dropped, their callbacks aren't called
+    EventLoop::~EventLoop() {
+        {
+            const std::lock_guard lock(this->_mutex);
+            this->_isStopped = true;
+        }
+        curl_multi_wakeup(this->_multi);
+        this->_thread.join();
+
+        for (auto& [curl, transfer] : this->_running) {
+            curl_multi_remove_handle(this->_multi, curl);
             curl_easy_cleanup(curl);
-            throw HTTPError(errorMessage);
+            transfer->limiter->release(0, std::chrono::seconds(0));
+        }
+        for (auto& transfer : this->_waiting) {
+            if (transfer->curl) {
+                curl_easy_cleanup(transfer->curl);
+            }
         }
+        curl_multi_cleanup(this->_multi);
+    }
 
-        long httpCode = 0;
-        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        if (httpCode != 200 ) { // todo: add explicit status "not found"
-            readBuffer = "";
+    void EventLoop::submit(std::unique_ptr<Transfer> transfer) {
+        {
+            const std::lock_guard lock(this->_mutex);
+            this->_submitted.push_back(std::move(transfer));
         }
+        curl_multi_wakeup(this->_multi);
+    }
 
-        curl_easy_cleanup(curl);
+    Clock::time_point EventLoop::_startWaiting() {
+        const auto now = Clock::now();
+        auto wakeUpAt = now + MAX_POLL_INTERVAL;
+
+        for (auto it = this->_waiting.begin(); it != this->_waiting.end();) {
+            auto& transfer = **it;
+            if (transfer.notBefore > now) {
+                wakeUpAt = std::min(wakeUpAt, transfer.notBefore);
+                ++it;
+                continue;
+            }
+
+            Clock::time_point retryAt;
+            if (!transfer.limiter->tryAcquire(retryAt)) {
+                wakeUpAt = std::min(wakeUpAt, retryAt);
+                ++it;
+                continue;
+            }
+
+            stats::record(stats::Stage::Throttle, now - transfer.queued);
+            this->_start(std::move(*it));
+            it = this->_waiting.erase(it);
+        }
+
+        return wakeUpAt;
     }
 
-    return toUtf8(readBuffer);
-}
+    void EventLoop::_start(std::unique_ptr<Transfer> transfer) {
+        if (!transfer->curl) {
+            transfer->curl = curl_easy_init();
+            if (!transfer->curl) {
+                transfer->limiter->release(0, std::chrono::seconds(0));
+                Response response;
+                response.error = "cannot initialize curl";
+                transfer->onDone(std::move(response));
+                return;
+            }
 
+            prepare(transfer->curl, transfer->url);
+            curl_easy_setopt(transfer->curl, CURLOPT_WRITEFUNCTION, _writeCallback);
+            curl_easy_setopt(transfer->curl, CURLOPT_WRITEDATA, &transfer->body);
+        }
+
+        transfer->body.clear();
+        transfer->started = Clock::now();
+        curl_multi_add_handle(this->_multi, transfer->curl);
+        auto curl = transfer->curl;
+        this->_running.emplace(curl, std::move(transfer));
+    }
+
+    void EventLoop::_finish(CURL* curl, CURLcode res) {
+        curl_multi_remove_handle(this->_multi, curl);
+        const auto found = this->_running.find(curl);
+        auto transfer = std::move(found->second);
+        this->_running.erase(found);
+
+        const auto now = Clock::now();
+        stats::record(stats::Stage::Download, now - transfer->started);
+
+        Response response;
+        transfer->limiter->release(readResult(curl, res, response), getRetryAfter(curl));
+
+        if (isRetried(response, transfer->attempt)) {
+            transfer->notBefore = now + getRetryDelay(transfer->attempt);
+            transfer->queued = transfer->notBefore;
+            transfer->attempt++;
+            this->_waiting.push_back(std::move(transfer));
+            return;
+        }
 
-bool http::fetchToFile(const std::string& url, const std::string& filePath) {
-    CURL* curl = curl_easy_init();
-    CURLcode res;
-    FILE* fp;
-
-    if (curl) {
-        fp = fopen(filePath.c_str(),"wb");
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _writeDataFoFile);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-        res = curl_easy_perform(curl);
         curl_easy_cleanup(curl);
-        fclose(fp);
+        if (response.isOk()) {
+            response.text = std::move(transfer->body);
+        }
+        transfer->onDone(std::move(response));
+    }
 
-        // Check for errors
-        if (res != CURLE_OK) {
-            if (std::filesystem::exists(filePath)) {
-                std::remove(filePath.c_str());
+    void EventLoop::_run() {
+        while (true) {
+            {
+                const std::lock_guard lock(this->_mutex);
+                if (this->_isStopped) {
+                    return;
+                }
+                for (auto& transfer : this->_submitted) {
+                    this->_waiting.push_back(std::move(transfer));
+                }
+                this->_submitted.clear();
             }
-            return false;
-        }
 
-        long httpCode = 0;
-        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        if (httpCode != 200 ) { // todo: add explicit status "not found"
-            if (std::filesystem::exists(filePath)) {
-                std::remove(filePath.c_str());
+            const auto wakeUpAt = this->_startWaiting();
+
+            int running = 0;
+            curl_multi_perform(this->_multi, &running);
+
+            int left = 0;
+            while (const auto message = curl_multi_info_read(this->_multi, &left)) {
+                if (message->msg == CURLMSG_DONE) {
+                    this->_finish(message->easy_handle, message->data.result);
+                }
             }
-            return false;
+
+            // the poll is shortened to the timeouts of the running transfers by curl itself
+            const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wakeUpAt - Clock::now());
+            curl_multi_poll(this->_multi, nullptr, 0, static_cast<int>(std::max<long long>(timeout.count(), 0)),
+                            nullptr);
         }
     }
 
-    return true;
+    EventLoop& getEventLoop() {
+        static EventLoop loop;
+        return loop;
+    }
+
+    class FetchAwaiter {
+        private:
+            std::string _url;
+            Response _response;
+
+        public:
+            explicit FetchAwaiter(std::string url) : _url(std::move(url)) {}
+
+            bool await_ready() const noexcept {return false;}
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                http::submit(this->_url, [this, handle](Response response) {
+                    this->_response = std::move(response);
+                    executor::getShared().post(executor::Task([handle] {handle.resume();}));
+                });
+            }
+
+            Response await_resume() {return std::move(this->_response);}
+    };
+}
+
+void http::submit(const std::string& url, std::function<void(Response)> onDone) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->url = url;
+    transfer->onDone = std::move(onDone);
+    transfer->limiter = &getLimiter(url);
+    getEventLoop().submit(std::move(transfer));
+}
+
+async::Task<Response> http::fetchRawAsync(std::string url) {
+    co_return co_await FetchAwaiter(std::move(url));
+}
+
+async::Task<Response> http::fetchAsync(std::string url) {
+    auto response = co_await FetchAwaiter(std::move(url));
+    if (response.isOk()) {
+        response.text = toUtf8(response.text);
+    }
+
+    co_return response;
 }
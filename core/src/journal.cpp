@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "journal.h"
+
+using namespace journal;
+
+
+SyncJournal::SyncJournal(const std::shared_ptr<db::Connection>& connection) :
+    _tRun(std::make_shared<db::DB<db::SyncRun>>(connection)),
+    _tRunAuthor(std::make_shared<db::DB<db::SyncRunAuthor>>(connection))
+{}
+
+void SyncJournal::createTable() {
+    this->_tRun->createTable();
+    this->_tRunAuthor->createTable();
+}
+
+db::SyncRunData SyncJournal::begin(unsigned int authorsCount, std::time_t now) {
+    db::SyncRunData run;
+    run.started_at = now;
+    run.authors_count = authorsCount;
+
+    this->_tRun->begin();
+    try {
+        run = this->_tRun->add(run);
+
+        // the previous runs (both finished and interrupted) are useless from now on
+        const auto runId = std::to_string(run.id);
+        this->_tRunAuthor->remove(db::Where("RUN_ID < " + runId));
+        this->_tRun->remove(db::Where("_id < " + runId));
+    } catch (const db::DBError&) {
+        this->_tRun->rollback();
+        throw;
+    }
+    this->_tRun->commit();
+
+    return run;
+}
+
+std::optional<db::SyncRunData> SyncJournal::getInterrupted() const {
+    // the latest run only, the `_id` is the primary key, so it's a lookup rather than a scan of the table
+    const db::Where latest("_id = (SELECT MAX(_id) FROM " + db::SyncRun::getTable() + ")");
+    const auto runs = this->_tRun->retrieve(latest, 1);
+    if (runs.empty() || runs.front().finished_at) {
+        return std::nullopt;
+    }
+
+    return runs.front();
+}
+
+std::unordered_set<int> SyncJournal::getChecked(const db::SyncRunData& run) const {
+    std::unordered_set<int> authorIds;
+    for (const auto& item : this->_tRunAuthor->retrieve(db::Where("RUN_ID = " + std::to_string(run.id)))) {
+        authorIds.insert(item.author_id);
+    }
+
+    return authorIds;
+}
+
+void SyncJournal::markChecked(const db::SyncRunData& run, const db::AuthorData& author, std::time_t now) {
+    db::SyncRunAuthorData item;
+    item.run_id = run.id;
+    item.author_id = author.id;
+    item.checked_at = now;
+    this->_tRunAuthor->add(item);
+}
+
+void SyncJournal::finish(db::SyncRunData& run, std::time_t now) {
+    run.finished_at = now;
+
+    this->_tRun->begin();
+    try {
+        this->_tRun->update(run);
+        this->_tRunAuthor->remove(db::Where("RUN_ID = " + std::to_string(run.id)));
+    } catch (const db::DBError&) {
+        this->_tRun->rollback();
+        throw;
+    }
+    this->_tRun->commit();
+}
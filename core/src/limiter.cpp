@@ -0,0 +1,164 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include "limiter.h"
+#include "http.h"
+#include "stats.h"
+
+using namespace http;
+
+
+HostLimiter::HostLimiter(double requestsPerSecond, unsigned int burst, unsigned int maxConnections) :
+    _maxRate(std::max(requestsPerSecond, 0.0)),
+    _burst(std::max(burst, 1u)),
+    _maxConnections(maxConnections),
+    _rate(_maxRate),
+    _tokens(_burst),
+    _connections(0),
+    _lastRefill(Clock::now()),
+    _pausedUntil(Clock::now()),
+    _backoff(0)
+{}
+
+void HostLimiter::_refill(Clock::time_point now) {
+    const std::chrono::duration<double> elapsed = now - this->_lastRefill;
+    this->_tokens = std::min(this->_burst, this->_tokens + elapsed.count() * this->_rate);
+    this->_lastRefill = now;
+}
+
+bool HostLimiter::_tryAcquire(Clock::time_point now, Clock::time_point& retryAt) {
+    if (now < this->_pausedUntil) {
+        retryAt = this->_pausedUntil;
+        return false;
+    }
+
+    if (this->_maxConnections && this->_connections >= this->_maxConnections) {
+        retryAt = Clock::time_point::max();     // until a connection is released
+        return false;
+    }
+
+    if (this->_maxRate > 0) {
+        this->_refill(now);
+        if (this->_tokens < 1) {
+            const std::chrono::duration<double> delay((1 - this->_tokens) / this->_rate);
+            retryAt = now + std::chrono::duration_cast<Clock::duration>(delay);
+            return false;
+        }
+        this->_tokens -= 1;
+    }
+
+    this->_connections++;
+    return true;
+}
+
+void HostLimiter::acquire() {
+    std::unique_lock lock(this->_mutex);
+    Clock::time_point retryAt;
+    while (!this->_tryAcquire(Clock::now(), retryAt)) {
+        if (retryAt == Clock::time_point::max()) {
+            this->_released.wait(lock);
+        } else {
+            this->_released.wait_until(lock, retryAt);
+        }
+    }
+}
+
+bool HostLimiter::tryAcquire(std::chrono::steady_clock::time_point& retryAt) {
+    const std::lock_guard lock(this->_mutex);
+    return this->_tryAcquire(Clock::now(), retryAt);
+}
+
+void HostLimiter::release(long httpCode, std::chrono::seconds retryAfter) {
+    {
+        const std::lock_guard lock(this->_mutex);
+        this->_connections--;
+
+        if (isThrottled(httpCode)) {
+            const auto now = Clock::now();
+            if (this->_maxRate > 0) {
+                this->_refill(now);
+                this->_rate = std::max(MIN_REQUESTS_PER_SECOND, this->_rate / 2);
+                this->_tokens = 0;
+            }
+
+            if (retryAfter.count() > 0) {
+                this->_backoff = std::min<std::chrono::milliseconds>(retryAfter, MAX_BACKOFF);
+            } else {
+                this->_backoff = this->_backoff.count() ? std::min(this->_backoff * 2, MAX_BACKOFF) : INITIAL_BACKOFF;
+            }
+            this->_pausedUntil = std::max(this->_pausedUntil, now + this->_backoff);
+        } else if (httpCode > 0) {
+            // the server has answered, so it isn't overloaded
+            if (this->_maxRate > 0) {
+                this->_refill(Clock::now());
+                this->_rate = std::min(this->_maxRate, this->_rate + REQUESTS_PER_SECOND_STEP);
+            }
+            this->_backoff = std::chrono::milliseconds(0);
+        }
+    }
+
+    this->_released.notify_all();
+}
+
+double HostLimiter::getRate() {
+    const std::lock_guard lock(this->_mutex);
+    return this->_rate;
+}
+
+
+Permit::Permit(const std::string& url) : _limiter(getLimiter(url)), _httpCode(0), _retryAfter(0) {
+    stats::ScopedTimer timer(stats::Stage::Throttle);
+    this->_limiter.acquire();
+}
+
+Permit::~Permit() {
+    this->_limiter.release(this->_httpCode, this->_retryAfter);
+}
+
+void Permit::setResponse(long httpCode, std::chrono::seconds retryAfter) {
+    this->_httpCode = httpCode;
+    this->_retryAfter = retryAfter;
+}
+
+
+static std::mutex limitersMutex;
+static std::unordered_map<std::string, std::unique_ptr<HostLimiter>> limiters;
+
+// e.g. "samlib.ru" for "http://samlib.ru/s/sedrik/"
+static std::string getHost(const std::string& url) {
+    const auto schemeEnd = url.find("://");
+    const auto hostStart = schemeEnd == std::string::npos ? 0 : schemeEnd + 3;
+    return url.substr(hostStart, url.find('/', hostStart) - hostStart);
+}
+
+HostLimiter& http::getLimiter(const std::string& url) {
+    const std::lock_guard lock(limitersMutex);
+    auto& limiter = limiters[getHost(url)];
+    if (!limiter) {
+        const auto& settings = getSettings();
+        limiter = std::make_unique<HostLimiter>(settings.requestsPerSecond, settings.burst, settings.maxConnections);
+    }
+
+    return *limiter;
+}
+
+void http::resetLimiters() {
+    const std::lock_guard lock(limitersMutex);
+    limiters.clear();
+}
@@ -15,11 +15,327 @@
  */
 
 
+#include <algorithm>  // for std::max
 #include <iomanip>  // for std::put_time
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <unordered_map>
+#include <fstream>
+#include <cmath>
+#include <limits>
+#include <string_view>
 #include "logger.h"
 
 using namespace logger;
 
+namespace logger {
+    struct LogRecord {
+        std::chrono::system_clock::time_point time;
+        LogLevel level;
+        std::uint32_t length;        // length of the message
+        std::uint32_t fieldsLength;  // length of the encoded fields which follow the message
+        std::uint16_t fieldsCount;
+        char message[LOG_RECORD_SIZE];
+    };
+
+    /**
+     * @brief Packs the fields into the record right after the message: `type, key length, key, value`.
+     *
+     * The fields which don't fit into the record are dropped.
+     */
+    void encodeFields(LogRecord& record, const LogFields& fields) {
+        char* const begin = record.message + record.length;
+        char* const end = record.message + LOG_RECORD_SIZE;
+        char* position = begin;
+
+        record.fieldsCount = 0;
+        for (const auto& field : fields) {
+            const auto keyLength = static_cast<std::uint8_t>(std::min<std::size_t>(field.key.size(), UINT8_MAX));
+            std::size_t valueLength;
+            std::uint32_t stringLength = 0;
+            switch (field.value.index()) {
+                case 0:
+                    stringLength = static_cast<std::uint32_t>(std::get<std::string>(field.value).size());
+                    valueLength = sizeof(stringLength) + stringLength;
+                    break;
+                case 1: valueLength = sizeof(long long); break;
+                case 2: valueLength = sizeof(double); break;
+                default: valueLength = sizeof(bool); break;
+            }
+
+            if (static_cast<std::size_t>(end - position) < 2 + keyLength + valueLength) {
+                break;
+            }
+
+            *position++ = static_cast<char>(field.value.index());
+            *position++ = static_cast<char>(keyLength);
+            std::memcpy(position, field.key.data(), keyLength);
+            position += keyLength;
+
+            switch (field.value.index()) {
+                case 0:
+                    std::memcpy(position, &stringLength, sizeof(stringLength));
+                    std::memcpy(position + sizeof(stringLength), std::get<std::string>(field.value).data(),
+                                stringLength);
+                    break;
+                case 1: std::memcpy(position, &std::get<long long>(field.value), valueLength); break;
+                case 2: std::memcpy(position, &std::get<double>(field.value), valueLength); break;
+                default: std::memcpy(position, &std::get<bool>(field.value), valueLength); break;
+            }
+            position += valueLength;
+            record.fieldsCount++;
+        }
+
+        record.fieldsLength = static_cast<std::uint32_t>(position - begin);
+    }
+
+    LogFields decodeFields(const LogRecord& record) {
+        LogFields fields;
+        fields.reserve(record.fieldsCount);
+
+        const char* position = record.message + record.length;
+        for (std::uint16_t i = 0; i < record.fieldsCount; i++) {
+            const auto type = static_cast<std::uint8_t>(*position++);
+            const auto keyLength = static_cast<std::uint8_t>(*position++);
+            std::string key(position, keyLength);
+            position += keyLength;
+
+            switch (type) {
+                case 0: {
+                    std::uint32_t stringLength;
+                    std::memcpy(&stringLength, position, sizeof(stringLength));
+                    position += sizeof(stringLength);
+                    fields.emplace_back(std::move(key), std::string(position, stringLength));
+                    position += stringLength;
+                    break;
+                }
+                case 1: {
+                    long long value;
+                    std::memcpy(&value, position, sizeof(value));
+                    position += sizeof(value);
+                    fields.emplace_back(std::move(key), value);
+                    break;
+                }
+                case 2: {
+                    double value;
+                    std::memcpy(&value, position, sizeof(value));
+                    position += sizeof(value);
+                    fields.emplace_back(std::move(key), value);
+                    break;
+                }
+                default: {
+                    bool value;
+                    std::memcpy(&value, position, sizeof(value));
+                    position += sizeof(value);
+                    fields.emplace_back(std::move(key), value);
+                    break;
+                }
+            }
+        }
+
+        return fields;
+    }
+
+    /**
+     * @class AsyncWriter
+     *
+     * @brief Bounded lock-free MPSC queue of log records with the background thread which formats and writes them.
+     *
+     * The queue is the well-known Vyukov's bounded queue: every cell has a sequence number which tells producers and
+     * the consumer whether the cell is free or filled, so producers only compete for the enqueue position.
+     */
+    class AsyncWriter {
+        private:
+            struct Cell {
+                std::atomic<std::size_t> sequence;
+                LogRecord record;
+            };
+
+            Logger* _logger;
+            const OverflowPolicy _policy;
+            const std::size_t _mask;
+            std::unique_ptr<Cell[]> _cells;
+
+            alignas(64) std::atomic<std::size_t> _enqueuePos;
+            alignas(64) std::atomic<std::size_t> _dequeuePos;
+            std::atomic<std::uint32_t> _signal;
+            std::atomic<bool> _isStopping;
+            std::atomic<unsigned long> _dropped;
+            std::atomic<unsigned long> _droppedTotal;
+            std::thread _thread;
+
+            static std::size_t _getCapacity(std::size_t capacity) {
+                std::size_t result = 2;
+                while (result < capacity) {
+                    result <<= 1;
+                }
+                return result;
+            }
+
+            bool _tryPush(const LogEntry& entry) {
+                auto pos = this->_enqueuePos.load(std::memory_order_relaxed);
+                Cell* cell;
+
+                for (;;) {
+                    cell = &this->_cells[pos & this->_mask];
+                    const auto sequence = cell->sequence.load(std::memory_order_acquire);
+                    const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+
+                    if (difference == 0) {
+                        if (this->_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    } else if (difference < 0) {
+                        return false;   // the queue is full
+                    } else {
+                        pos = this->_enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+
+                auto& record = cell->record;
+                record.time = entry.time;
+                record.level = entry.level;
+                record.length = static_cast<std::uint32_t>(std::min(entry.message.size(), LOG_RECORD_SIZE));
+                std::memcpy(record.message, entry.message.data(), record.length);
+                encodeFields(record, entry.fields);
+
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // there's only one consumer, so it doesn't compete for the dequeue position
+            bool _tryWriteNext() {
+                const auto pos = this->_dequeuePos.load(std::memory_order_relaxed);
+                auto& cell = this->_cells[pos & this->_mask];
+                const auto sequence = cell.sequence.load(std::memory_order_acquire);
+
+                if (static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1) < 0) {
+                    return false;   // the queue is empty
+                }
+
+                const auto& record = cell.record;
+                this->_logger->_write(
+                    LogEntry{record.time, record.level, std::string(record.message, record.length), decodeFields(record)},
+                    false
+                );
+
+                cell.sequence.store(pos + this->_mask + 1, std::memory_order_release);
+                this->_dequeuePos.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            void _reportDropped() {
+                const auto dropped = this->_dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped) {
+                    this->_logger->_write(LogEntry{
+                        std::chrono::system_clock::now(),
+                        LogLevel::Warning,
+                        std::to_string(dropped) + " log message(s) were dropped because of the full queue."
+                    }, false);
+                }
+            }
+
+            void _run() {
+                for (;;) {
+                    const auto signal = this->_signal.load(std::memory_order_acquire);
+
+                    bool isWritten = false;
+                    while (this->_tryWriteNext()) {
+                        isWritten = true;
+                    }
+
+                    this->_reportDropped();
+
+                    if (isWritten) {
+                        this->_logger->_flushSinks();
+                        this->_dequeuePos.notify_all();
+                        continue;
+                    }
+
+                    if (this->_isStopping.load(std::memory_order_acquire)) {
+                        break;
+                    }
+
+                    this->_signal.wait(signal, std::memory_order_acquire);
+                }
+            }
+
+            void _wakeUp() {
+                this->_signal.fetch_add(1, std::memory_order_release);
+                this->_signal.notify_one();
+            }
+
+        public:
+            AsyncWriter(Logger* logger, std::size_t capacity, OverflowPolicy policy) :
+                _logger(logger),
+                _policy(policy),
+                _mask(_getCapacity(capacity) - 1),
+                _cells(std::make_unique<Cell[]>(_mask + 1)),
+                _enqueuePos(0),
+                _dequeuePos(0),
+                _signal(0),
+                _isStopping(false),
+                _dropped(0),
+                _droppedTotal(0)
+            {
+                for (std::size_t i = 0; i <= this->_mask; i++) {
+                    this->_cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+
+                this->_thread = std::thread(&AsyncWriter::_run, this);
+            }
+
+            ~AsyncWriter() {
+                this->_isStopping.store(true, std::memory_order_release);
+                this->_wakeUp();
+                this->_thread.join();
+            }
+
+            void push(const LogEntry& entry) {
+                while (!this->_tryPush(entry)) {
+                    if (this->_policy == OverflowPolicy::Drop) {
+                        this->_dropped.fetch_add(1, std::memory_order_relaxed);
+                        this->_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    this->_wakeUp();
+                    std::this_thread::yield();  // backpressure: wait until the writer frees a slot
+                }
+
+                this->_wakeUp();
+            }
+
+            void flush() {
+                const auto target = this->_enqueuePos.load(std::memory_order_acquire);
+                this->_wakeUp();
+
+                auto pos = this->_dequeuePos.load(std::memory_order_acquire);
+                while (pos < target) {
+                    this->_dequeuePos.wait(pos, std::memory_order_acquire);
+                    pos = this->_dequeuePos.load(std::memory_order_acquire);
+                }
+            }
+
+            [[nodiscard]] unsigned long getDroppedCount() const {
+                return this->_droppedTotal.load(std::memory_order_relaxed);
+            }
+    };
+}
+
+static std::string toString(const LogFieldValue& value) {
+    std::ostringstream stream;
+    std::visit([&stream](const auto& v) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, bool>) {
+            stream << (v ? "true" : "false");
+        } else {
+            stream << v;
+        }
+    }, value);
+    return stream.str();
+}
+
 std::string ISO8601LogFormatter::format(const LogEntry& entry) {
     auto time_t = std::chrono::system_clock::to_time_t(entry.time);
     auto duration = entry.time.time_since_epoch();
@@ -39,20 +355,144 @@ std::string ISO8601LogFormatter::format(const LogEntry& entry) {
     }
 
     stream << entry.message;
+    for (const auto& field : entry.fields) {
+        stream << " " << field.key << "=" << toString(field.value);
+    }
+
+    return stream.str();
+}
+
+static void writeJSONString(std::ostream& stream, const std::string& text) {
+    static const char* const HEX = "0123456789abcdef";
+
+    stream << '"';
+    for (const auto c : text) {
+        switch (c) {
+            case '"':  stream << "\\\""; break;
+            case '\\': stream << "\\\\"; break;
+            case '\n': stream << "\\n"; break;
+            case '\r': stream << "\\r"; break;
+            case '\t': stream << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    stream << "\\u00" << HEX[(c >> 4) & 0xF] << HEX[c & 0xF];
+                } else {
+                    stream << c;   // UTF-8 sequences are valid JSON as is
+                }
+        }
+    }
+    stream << '"';
+}
+
+static void writeJSONValue(std::ostream& stream, const LogFieldValue& value) {
+    std::visit([&stream](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            writeJSONString(stream, v);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            stream << (v ? "true" : "false");
+        } else if constexpr (std::is_same_v<T, double>) {
+            if (std::isfinite(v)) {
+                stream << std::setprecision(std::numeric_limits<double>::max_digits10) << v;
+            } else {
+                stream << "null";   // JSON has neither NaN nor infinity
+            }
+        } else {
+            stream << v;
+        }
+    }, value);
+}
+
+std::string JSONLinesLogFormatter::format(const LogEntry& entry) {
+    auto time_t = std::chrono::system_clock::to_time_t(entry.time);
+    auto duration = entry.time.time_since_epoch();
+    auto milliseconds = duration_cast<std::chrono::milliseconds>(duration).count() % 1000; // get milliseconds only
+
+    std::tm utc{};
+    gmtime_r(&time_t, &utc);
+
+    std::ostringstream stream;
+    stream << R"({"time":")" << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S")
+           << "." << std::setw(3) << std::setfill('0') << milliseconds << R"(Z","level":")";
+
+    switch(entry.level) {
+        case LogLevel::Debug:   stream << "debug"; break;
+        case LogLevel::Info:    stream << "info"; break;
+        case LogLevel::Warning: stream << "warning"; break;
+        case LogLevel::Error:   stream << "error"; break;
+    }
+
+    stream << R"(","message":)";
+    writeJSONString(stream, entry.message);
+
+    if (!entry.fields.empty()) {
+        stream << R"(,"fields":{)";
+        bool isFirst = true;
+        for (const auto& field : entry.fields) {
+            if (!isFirst) {
+                stream << ',';
+            }
+            isFirst = false;
+
+            writeJSONString(stream, field.key);
+            stream << ':';
+            writeJSONValue(stream, field.value);
+        }
+        stream << '}';
+    }
+    stream << '}';
 
     return stream.str();
 }
 
-Logger::Logger(std::ostream* os, std::unique_ptr<ILogFormatter> formatter) :
-    _os(os),
-    _formatter(std::move(formatter)),
+Logger::Logger(std::ostream* os, std::unique_ptr<ILogFormatter> formatter, LogLevel level) :
+    _filterLevel(LogLevel::Debug),
+    _minLevel(LogLevel::Debug),
     debug{this, LogLevel::Debug},
     info{this, LogLevel::Info},
     warning{this, LogLevel::Warning},
     error{this, LogLevel::Error}
-{}
+{
+    this->addSink(os, std::move(formatter), level);
+}
+
+Logger::~Logger() {
+    this->stopAsync();
+}
+
+void Logger::addSink(std::ostream* os, std::unique_ptr<ILogFormatter> formatter, LogLevel level) {
+    std::lock_guard<std::mutex> lock(this->_writeMutex);
+    this->_sinks.push_back(Sink{os, std::move(formatter), level, nullptr});
+    this->_updateMinLevel();
+}
+
+void Logger::addSink(const std::string& path, std::unique_ptr<ILogFormatter> formatter, LogLevel level) {
+    auto file = std::make_unique<std::ofstream>(path, std::ios::app);
+    if (!file->is_open()) {
+        throw std::runtime_error("Cannot open the log file " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(this->_writeMutex);
+    this->_sinks.push_back(Sink{file.get(), std::move(formatter), level, std::move(file)});
+    this->_updateMinLevel();
+}
+
+void Logger::_updateMinLevel() {
+    auto sinksLevel = LogLevel::Error;
+    for (const auto& sink : this->_sinks) {
+        sinksLevel = std::min(sinksLevel, sink.level);
+    }
+
+    // the compile-time levels are checked by isEnabled() and isEventEnabled(), they differ for messages and events
+    this->_minLevel.store(std::max(this->_filterLevel, sinksLevel));
+}
 
 void Logger::addFilter(std::unique_ptr<ILogFilter> filter) {
+    if (const auto levelFilter = dynamic_cast<MinimalLogLevelFilter*>(filter.get())) {
+        this->_filterLevel = std::max(this->_filterLevel, levelFilter->getLevel());
+        this->_updateMinLevel();
+    }
+
     this->_filters.push_back(std::move(filter));
 }
 
@@ -60,8 +500,82 @@ void Logger::setLogLevel(logger::LogLevel level) {
     this->addFilter(std::make_unique<MinimalLogLevelFilter>(level));
 }
 
+void Logger::event(LogLevel level, const std::string& name, LogFields fields) {
+    if (!this->isEventEnabled(level)) {
+        return;
+    }
+
+    const LogEntry entry{std::chrono::system_clock::now(), level, name, std::move(fields)};
+    for (const auto& _filter : this->_filters) {
+        if (!_filter->filter(entry)) {
+            return;
+        }
+    }
+
+    this->_dispatch(entry);
+}
+
+void Logger::startAsync(std::size_t capacity, OverflowPolicy policy) {
+    this->stopAsync();
+    this->_asyncWriter = std::make_unique<AsyncWriter>(this, capacity, policy);
+}
+
+void Logger::stopAsync() {
+    this->_asyncWriter.reset();   // the writer drains the queue before it stops
+}
+
+void Logger::flush() {
+    if (this->_asyncWriter) {
+        this->_asyncWriter->flush();
+    }
+}
+
+unsigned long Logger::getDroppedCount() const {
+    return this->_asyncWriter ? this->_asyncWriter->getDroppedCount() : 0;
+}
+
+void Logger::_dispatch(const LogEntry& entry) {
+    if (this->_asyncWriter) {
+        this->_asyncWriter->push(entry);
+    } else {
+        this->_write(entry, true);
+    }
+}
+
+void Logger::_write(const LogEntry& entry, bool doFlush) {
+    std::lock_guard<std::mutex> lock(this->_writeMutex);
+    for (auto& sink : this->_sinks) {
+        if (entry.level < sink.level) {
+            continue;
+        }
+
+        *sink.os << sink.formatter->format(entry) << '\n';
+        if (doFlush) {
+            sink.os->flush();
+        }
+    }
+}
+
+void Logger::_flushSinks() {
+    std::lock_guard<std::mutex> lock(this->_writeMutex);
+    for (auto& sink : this->_sinks) {
+        sink.os->flush();
+    }
+}
+
+// the buffer of a stream exists only while a message is being composed, so the streams of the destroyed loggers
+// leave nothing behind in the threads which used them
+static std::unordered_map<unsigned long, std::ostringstream>& getStreamBuffers() {
+    thread_local std::unordered_map<unsigned long, std::ostringstream> buffers;
+    return buffers;
+}
+
+std::ostringstream& Logger::LoggerStream::_buffer() {
+    return getStreamBuffers()[this->_id];
+}
+
 LogEntry Logger::LoggerStream::_getEntry() {
-    return LogEntry{std::chrono::system_clock::now(), this->_level, this->_ss.str()};
+    return LogEntry{std::chrono::system_clock::now(), this->_level, this->_buffer().str()};
 }
 
 bool Logger::LoggerStream::_isAvailable(const LogEntry& entry) {
@@ -82,42 +596,49 @@ bool Logger::LoggerStream::_isAvailable() { return this->_isAvailable(this->_get
 
 template<typename T>
 Logger::LoggerStream& Logger::LoggerStream::operator<<(const T& message) {
-    this->_ss << message;
+    if (this->isEnabled()) {
+        this->_buffer() << message;
+    }
     return *this;
 }
 
 Logger::LoggerStream& Logger::LoggerStream::operator<<(const char* const& message) {
-    this->_ss << message;
+    if (this->isEnabled()) {
+        this->_buffer() << message;
+    }
     return *this;
 }
 
-Logger::LoggerStream& Logger::LoggerStream::operator<<(StandardEndLine handler) {
-    if (this->_isAvailable()) {
-        this->flush();
-        handler(*this->_logger->_os);
-    }
+Logger::LoggerStream& Logger::LoggerStream::operator<<(StandardEndLine) {
+    this->flush();
     return *this;
 }
 
-Logger::LoggerStream::LoggerStream(Logger* logger, LogLevel level) : _logger(logger), _level(level) {};
+static std::atomic<unsigned long> lastLoggerStreamId{0};
+
+Logger::LoggerStream::LoggerStream(Logger* logger, LogLevel level) :
+    _logger(logger), _id(++lastLoggerStreamId), _level(level) {};
 
 void Logger::LoggerStream::clear() {
-    this->_ss.str("");
-    this->_ss.clear();
+    getStreamBuffers().erase(this->_id);
 }
 
 void Logger::LoggerStream::flush() {
-    *(this->_logger->_os) << this->_logger->_formatter->format(this->_getEntry());
-    this->clear();
+    if (this->isEnabled()) {
+        const auto entry = this->_getEntry();
+        if (this->_isAvailable(entry)) {
+            this->_logger->_dispatch(entry);
+        }
+    }
+    this->clear();  // the level may have been changed since the message was buffered
 }
 
 Logger::LoggerStream::~LoggerStream() {
-    if (this->_isAvailable()) {
-        this->flush();
-    }
+    this->flush();
 }
 
 template Logger::LoggerStream& Logger::LoggerStream::operator<< <std::string>(const std::string& message);
+template Logger::LoggerStream& Logger::LoggerStream::operator<< <std::string_view>(const std::string_view& message);
 template Logger::LoggerStream& Logger::LoggerStream::operator<< <int>(const int& message);
 template Logger::LoggerStream& Logger::LoggerStream::operator<< <unsigned int>(const unsigned int& message);
 template Logger::LoggerStream& Logger::LoggerStream::operator<< <bool>(const bool& message);
@@ -14,22 +14,23 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <cstdlib>
 #include <chrono>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
 #include <ranges>
 #include <regex>
+#include <thread>
 #include "miner.h"
 #include "tools.h"
 #include "http.h"
 
 using namespace miner;
 
-using GroupName = std::string;
-using Url = std::string;
-
 std::time_t getNow() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()
@@ -39,101 +40,145 @@ std::time_t getNow() {
 class DbUrlMixin {
     protected:
         const db::AuthorData& _author;
+        const std::string_view _urlPrefix;  // the author's URL without the leading slash, e.g. "a/author/"
 
     public:
-        explicit DbUrlMixin(const db::AuthorData& author): _author(author) {}
+        explicit DbUrlMixin(const db::AuthorData& author):
+            _author(author), _urlPrefix(std::string_view(author.url).substr(1)) {}
+
+        [[nodiscard]] inline std::string _getDBUrl(const parser::BookView &webBook) const {
+            std::string url;
+            url.reserve(this->_urlPrefix.size() + webBook.url.size());
+            url.append(this->_urlPrefix).append(webBook.url);
+            return url;
+        }
+};
+
+/**
+ * @brief The URL of a book in the DB (see Book.LINK) which isn't concatenated: the author's URL and the book's one.
+ */
+struct DbUrl {
+    std::string_view prefix;
+    std::string_view suffix;
+};
 
-        [[nodiscard]] inline std::string _getDBUrl(const parser::Book &webBook) const {
-            return this->_author.url.substr(1) + webBook.url;
+/**
+ * @brief Transparent FNV-1a hash and equality of the book URLs, so the stored URLs (std::string_view) are looked up by
+ *        the pair of parts (DbUrl) without building the whole URL.
+ */
+struct DbUrlHash {
+    using is_transparent = void;
+
+    static constexpr std::size_t OFFSET_BASIS = 14695981039346656037ULL;
+    static constexpr std::size_t PRIME = 1099511628211ULL;
+
+    static std::size_t _hash(std::string_view text, std::size_t hash) {
+        for (const unsigned char ch : text) {
+            hash = (hash ^ ch) * PRIME;
         }
+        return hash;
+    }
+
+    std::size_t operator()(std::string_view url) const {return _hash(url, OFFSET_BASIS);}
+    std::size_t operator()(const DbUrl& url) const {return _hash(url.suffix, _hash(url.prefix, OFFSET_BASIS));}
+};
+
+struct DbUrlEqual {
+    using is_transparent = void;
+
+    bool operator()(std::string_view a, std::string_view b) const {return a == b;}
+    bool operator()(const DbUrl& a, std::string_view b) const {return (*this)(b, a);}
+    bool operator()(std::string_view a, const DbUrl& b) const {
+        return a.size() == b.prefix.size() + b.suffix.size() && a.starts_with(b.prefix) && a.ends_with(b.suffix);
+    }
+};
+
+/**
+ * @brief The stored book matched with the web one, it's stable while the registry is alive.
+ */
+struct StoredBook {
+    const db::BookData& book;
+    bool isKnown = false;   // the book is still on the author's page
 };
 
 class StoredBookRegistry: public DbUrlMixin {
     private:
-        std::unordered_map<Url, const db::BookData&> _storedBooksMap;
-        std::unordered_set<unsigned int> _knownBookIDs;
-        const db::AuthorData& _author;
+        // the keys reference the links of the stored books, so the books must outlive the registry
+        std::pmr::unordered_map<std::string_view, StoredBook, DbUrlHash, DbUrlEqual> _storedBooksMap;
 
     public:
-        StoredBookRegistry(const db::Books& storedBooks, const db::AuthorData& author):
-        _author(author), DbUrlMixin(author) {
+        StoredBookRegistry(const db::Books& storedBooks, const db::AuthorData& author,
+                           std::pmr::memory_resource* resource):
+        DbUrlMixin(author), _storedBooksMap(resource) {
+            this->_storedBooksMap.reserve(storedBooks.size());
             for(auto& storedBook : storedBooks) {
-                this->_storedBooksMap.emplace(storedBook.link, std::cref(storedBook));
+                this->_storedBooksMap.emplace(storedBook.link, StoredBook{storedBook});
             }
         }
 
-        [[nodiscard]] bool isNew(const parser::Book& webBook) const {
-            return this->_storedBooksMap.find(this->_getDBUrl(webBook)) == this->_storedBooksMap.end();
-        }
-
-        bool isUpdated(const parser::Book& webBook) {
-            const auto& dbBook = this->_storedBooksMap.find(this->_getDBUrl(webBook))->second;
-            this->_knownBookIDs.insert(dbBook.id);
-            return dbBook.size != webBook.size;
-        }
-
-        bool isMoved(const parser::Book& webBook, const db::GroupBookData& maybeNewGroup) {
-            const auto& dbBook = this->_storedBooksMap.find(this->_getDBUrl(webBook))->second;
-            this->_knownBookIDs.insert(dbBook.id);
-            return dbBook.group_id != maybeNewGroup.id;
-        }
-
-        const db::BookData& operator[] (const parser::Book& webBook) {
-            return this->_storedBooksMap.find(this->_getDBUrl(webBook))->second;
+        /**
+         * @return the stored book with the same URL as the web one, nullptr if the web book is new
+         */
+        [[nodiscard]] StoredBook* find(const parser::BookView& webBook) {
+            const auto item = this->_storedBooksMap.find(DbUrl{this->_urlPrefix, webBook.url});
+            return item == this->_storedBooksMap.end() ? nullptr : &item->second;
         }
 
         auto getAbandonedBooks() {
-            return this->_storedBooksMap | std::views::values | std::views::filter(
-                [this](const db::BookData& storedBook) { return !this->_knownBookIDs.contains(storedBook.id); }
-            );
+            return this->_storedBooksMap | std::views::values
+                | std::views::filter([](const StoredBook& storedBook) { return !storedBook.isKnown; })
+                | std::views::transform([](const StoredBook& storedBook) -> const db::BookData& {
+                    return storedBook.book;
+                });
         }
 };
 
+/**
+ * @brief The stored group matched with the web one, see StoredBook.
+ */
+struct StoredGroup {
+    const db::GroupBookData& group;
+    bool isKnown = false;
+};
+
 class StoredGroupRegistry {
     private:
-        std::unordered_map<Url, const db::GroupBookData&> _storedGroupsMap;
-        std::unordered_set<unsigned int> _knownGroupIDs;
+        // the keys reference the names of the stored groups, so the groups must outlive the registry
+        std::pmr::unordered_map<std::string_view, StoredGroup> _storedGroupsMap;
 
     public:
-        explicit StoredGroupRegistry(const db::GroupBooks &storedGroups) {
+        StoredGroupRegistry(const db::GroupBooks &storedGroups, std::pmr::memory_resource* resource) :
+            _storedGroupsMap(resource) {
+            this->_storedGroupsMap.reserve(storedGroups.size());
             for (const auto &storedGroup: storedGroups) {
-                this->_storedGroupsMap.emplace(trim_copy(storedGroup.name, noisyChar), storedGroup);
+                this->_storedGroupsMap.emplace(trim_view(storedGroup.name, noisyChar), StoredGroup{storedGroup});
             }
         }
 
-        const db::GroupBookData& operator[] (const parser::BookGroup& webGroup) {
-            return this->_storedGroupsMap.find(webGroup.name)->second;
-        }
-
-        [[nodiscard]] bool isNew(const parser::BookGroup &webGroup) {
-            //return this->_storedGroupsMap.find(webGroup.name) == this->_storedGroupsMap.end();
+        /**
+         * @return the stored group with the same name as the web one, nullptr if the web group is new
+         */
+        [[nodiscard]] StoredGroup* find(const parser::BookGroupView& webGroup) {
             const auto item = this->_storedGroupsMap.find(webGroup.name);
-
-            if (item != this->_storedGroupsMap.end()) {
-                this->_knownGroupIDs.insert(item->second.id);
-                return false;
-            }
-
-            return true;
+            return item == this->_storedGroupsMap.end() ? nullptr : &item->second;
         }
 
-        // try to implement by using getLevenshteinDistance()
-        //bool isUpdated(const parser::BookGroup& webGroup){}
-
         auto getAbandonedGroups() {
-            return this->_storedGroupsMap | std::views::values | std::views::filter(
-                [this](const db::GroupBookData& storedGroup) { return !this->_knownGroupIDs.contains(storedGroup.id); }
-            );
+            return this->_storedGroupsMap | std::views::values
+                | std::views::filter([](const StoredGroup& storedGroup) { return !storedGroup.isKnown; })
+                | std::views::transform([](const StoredGroup& storedGroup) -> const db::GroupBookData& {
+                    return storedGroup.group;
+                });
         }
 };
 
 class StoredBookBuilder: public DbUrlMixin {
     private:
-        const db::AuthorData& _author;
-        StoredBookRegistry& _bookRegistry;
         std::time_t _now;
+        std::optional<parser::TextCleaner> _textCleaner;  // its regexes are compiled only if there are changes
 
-        db::BookData _web2db(const parser::Book& webBook, db::GroupBookData& group) {
+        // the owned copies of the strings are made only for the new and changed books
+        db::BookData _web2db(const parser::BookView& webBook, db::GroupBookData& group) {
             db::BookData maybeNewBook;
             maybeNewBook.link = this->_getDBUrl(webBook);
             maybeNewBook.author = this->_author.name;
@@ -141,7 +186,10 @@ class StoredBookBuilder: public DbUrlMixin {
             maybeNewBook.form = webBook.genre;
             maybeNewBook.size = webBook.size;
             maybeNewBook.group_id = group.id;
-            maybeNewBook.description = webBook.description;
+            if (!this->_textCleaner) {
+                this->_textCleaner.emplace();
+            }
+            maybeNewBook.description = this->_textCleaner->clean(std::string(webBook.description));
             maybeNewBook.author_id = this->_author.id;
 
             return maybeNewBook;
@@ -149,12 +197,11 @@ class StoredBookBuilder: public DbUrlMixin {
 
 
 public:
-        StoredBookBuilder(const db::AuthorData& author, StoredBookRegistry& bookRegistry) :
-            _author(author), _bookRegistry(bookRegistry), DbUrlMixin(author) {
+        explicit StoredBookBuilder(const db::AuthorData& author) : DbUrlMixin(author) {
             this->_now = getNow();
         }
 
-        db::BookData buildNew(const parser::Book& webBook, db::GroupBookData& maybeNewGroup) {
+        db::BookData buildNew(const parser::BookView& webBook, db::GroupBookData& maybeNewGroup) {
             db::BookData newBook = this->_web2db(webBook, maybeNewGroup);
             newBook.date = this->_now;
             newBook.mtime = this->_now;
@@ -166,8 +213,8 @@ public:
             return newBook;
         }
 
-        db::BookData buildUpdated(const parser::Book& webBook, db::GroupBookData& maybeNewGroup) {
-            const auto& storedBook = this->_bookRegistry[webBook];
+        db::BookData buildUpdated(const parser::BookView& webBook, const db::BookData& storedBook,
+                                  db::GroupBookData& maybeNewGroup) {
             unsigned int deltaSize = std::abs((int)(storedBook.size - webBook.size));
 
             db::BookData updatedBook = this->_web2db(webBook, maybeNewGroup);
@@ -185,14 +232,12 @@ public:
 class StoredGroupBuilder {
     private:
         const db::AuthorData& _author;
-        StoredGroupRegistry& _groupRegistry;
         int _groupIndex;
 
     public:
-        StoredGroupBuilder(const db::AuthorData& author, StoredGroupRegistry& registry) :
-            _author(author), _groupRegistry(registry), _groupIndex(0) {}
+        explicit StoredGroupBuilder(const db::AuthorData& author) : _author(author), _groupIndex(0) {}
 
-        db::GroupBookData build(const parser::BookGroup& webBookGroup) {
+        db::GroupBookData build(const parser::BookGroupView& webBookGroup, const StoredGroup* storedGroup) {
             this->_groupIndex++;
 
             db::GroupBookData maybeNewGroup;
@@ -200,35 +245,314 @@ class StoredGroupBuilder {
             maybeNewGroup.display_name = webBookGroup.name;
             maybeNewGroup.author_id = this->_author.id;
 
-            if (this->_groupRegistry.isNew(webBookGroup)) {
+            if (!storedGroup) {
                 maybeNewGroup.id = -this->_groupIndex; // assuming in the BookGroup table has no negative IDs
             } else {
-                maybeNewGroup.id = this->_groupRegistry[webBookGroup].id;
+                maybeNewGroup.id = storedGroup->group.id;
             }
 
             return maybeNewGroup;
         }
 };
 
-Miner::Miner(const std::shared_ptr<db::Connection>& connection, const std::shared_ptr<logger::Logger>& logger) :
+// e.g. "Глава 5" and "Глава 6" are similar, but they're different chapters
+static bool hasSameNumbers(std::string_view title1, std::string_view title2) {
+    const auto takeNumber = [](std::string_view& title) {
+        const auto isDigit = [](char c) {return c >= '0' && c <= '9';};
+        const auto start = std::find_if(title.begin(), title.end(), isDigit);
+        const auto end = std::find_if_not(start, title.end(), isDigit);
+        title.remove_prefix(end - title.begin());
+        return std::string_view(start, end);
+    };
+
+    while (true) {
+        const auto number1 = takeNumber(title1);
+        const auto number2 = takeNumber(title2);
+        if (number1 != number2) {
+            return false;
+        }
+        if (number1.empty()) {
+            return true;
+        }
+    }
+}
+
+/**
+ * @class RenameDetector
+ *
+ * @brief Turns pairs "removed + added" of the Difference into in-place updates when they look like renames.
+ *
+ * Registries match stored and web items by exact group name/book URL only, so a renamed group or a book moved to
+ * a new URL produces a removal and an addition. This class pairs abandoned groups/books with the new ones by
+ * similarity of their names (and, for groups, by the books they contain) and rewrites the Difference, so the stored
+ * rows are updated instead of being re-created and the read state of the books is preserved.
+ */
+class RenameDetector {
+    private:
+        Difference& _diff;
+        const std::shared_ptr<logger::Logger>& _logger;
+        std::pmr::unordered_map<int, const db::BookData*> _storedBooksById;
+        std::pmr::unordered_map<int, unsigned int> _storedGroupSizes;
+        std::pmr::unordered_set<int> _renamedGroupIDs;
+
+        void _remapGroup(db::Books& books, int fromGroupId, int toGroupId) {
+            for (auto& book : books) {
+                if (book.group_id == fromGroupId) {
+                    book.group_id = toGroupId;
+                }
+            }
+        }
+
+        // the book doesn't count as new/updated anymore, so its group should not count it as well
+        void _decrementNewNumber(int groupId) {
+            for (auto& group : this->_diff.added.groups) {
+                if (group.id == groupId) {
+                    group.new_number = std::max(group.new_number - 1, 0);
+                    return;
+                }
+            }
+
+            auto& updatedGroups = this->_diff.updated.groups;
+            for (auto group = updatedGroups.begin(); group != updatedGroups.end(); ++group) {
+                if (group->id == groupId) {
+                    group->new_number = std::max(group->new_number - 1, 0);
+                    if (!group->new_number && !this->_renamedGroupIDs.contains(groupId)) {
+                        updatedGroups.erase(group);  // nothing to update anymore
+                    }
+                    return;
+                }
+            }
+        }
+
+        [[nodiscard]] double _getGroupOverlap(int newGroupId, const db::GroupBookData& storedGroup) const {
+            const auto size = this->_storedGroupSizes.find(storedGroup.id);
+            if (size == this->_storedGroupSizes.end() || !size->second) {
+                return 0.0;
+            }
+
+            unsigned int overlap = 0;
+            for (const auto& book : this->_diff.updated.books) {
+                const auto storedBook = this->_storedBooksById.find(book.id);
+                if (book.group_id == newGroupId && storedBook != this->_storedBooksById.end()
+                    && storedBook->second->group_id == storedGroup.id) {
+                    overlap++;
+                }
+            }
+
+            return static_cast<double>(overlap) / size->second;
+        }
+
+        // the books which were "moved" into renamed group in fact are in the same group, so they aren't updated
+        void _dropFakeMoves() {
+            auto& updatedBooks = this->_diff.updated.books;
+            for (auto book = updatedBooks.begin(); book != updatedBooks.end();) {
+                const auto storedBook = this->_storedBooksById.find(book->id);
+                if (storedBook != this->_storedBooksById.end()
+                    && storedBook->second->group_id == book->group_id
+                    && storedBook->second->size == book->size
+                    && storedBook->second->link == book->link) {
+                    const auto groupId = book->group_id;
+                    book = updatedBooks.erase(book);
+                    this->_decrementNewNumber(groupId);
+                } else {
+                    ++book;
+                }
+            }
+        }
+
+    public:
+        RenameDetector(const db::Books& storedBooks, Difference& diff, const std::shared_ptr<logger::Logger>& logger,
+                       std::pmr::memory_resource* resource) :
+            _diff(diff), _logger(logger), _storedBooksById(resource), _storedGroupSizes(resource),
+            _renamedGroupIDs(resource) {
+            this->_storedBooksById.reserve(storedBooks.size());
+            for (const auto& storedBook : storedBooks) {
+                this->_storedBooksById.emplace(storedBook.id, &storedBook);
+                this->_storedGroupSizes[storedBook.group_id]++;
+            }
+        }
+
+        /**
+         * @brief Pairs added groups with removed ones.
+         *
+         * The new group is considered as a renamed one if it contains at least RENAME_GROUP_OVERLAP_THRESHOLD part
+         * of the books of the abandoned group or if their names are similar enough (RENAME_SIMILARITY_THRESHOLD).
+         * Such a group keeps its ID and counter of new books, all books of the Difference are re-linked to it.
+         */
+        void detectGroups() {
+            auto& addedGroups = this->_diff.added.groups;
+            auto& removedGroups = this->_diff.removed.groups;
+
+            for (auto newGroup = addedGroups.begin(); newGroup != addedGroups.end() && !removedGroups.empty();) {
+                auto bestMatch = removedGroups.end();
+                double bestScore = 0.0;
+
+                for (auto storedGroup = removedGroups.begin(); storedGroup != removedGroups.end(); ++storedGroup) {
+                    const auto overlap = this->_getGroupOverlap(newGroup->id, *storedGroup);
+                    const auto similarity = getSimilarity(trim_copy(storedGroup->name, noisyChar), newGroup->name);
+                    if (overlap < RENAME_GROUP_OVERLAP_THRESHOLD && similarity < RENAME_SIMILARITY_THRESHOLD) {
+                        continue;
+                    }
+
+                    const auto score = std::max(overlap, similarity);
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestMatch = storedGroup;
+                    }
+                }
+
+                if (bestMatch == removedGroups.end()) {
+                    ++newGroup;
+                    continue;
+                }
+
+                this->_logger->info << "The group \"" << bestMatch->name << "\" seems to be renamed to \""
+                                    << newGroup->name << "\"." << std::endl;
+
+                auto renamedGroup = *bestMatch;
+                renamedGroup.name = newGroup->name;
+                renamedGroup.display_name = newGroup->display_name;
+                renamedGroup.new_number += newGroup->new_number;
+
+                this->_remapGroup(this->_diff.added.books, newGroup->id, renamedGroup.id);
+                this->_remapGroup(this->_diff.updated.books, newGroup->id, renamedGroup.id);
+                this->_renamedGroupIDs.insert(renamedGroup.id);
+                this->_diff.updated.groups.push_back(renamedGroup);
+
+                removedGroups.erase(bestMatch);
+                newGroup = addedGroups.erase(newGroup);
+            }
+
+            if (!this->_renamedGroupIDs.empty()) {
+                this->_dropFakeMoves();
+            }
+        }
+
+        /**
+         * @brief Pairs added books with removed ones.
+         *
+         * The new book is considered as the old one moved to a new URL if their titles are similar enough
+         * (RENAME_SIMILARITY_THRESHOLD) and have the same numbers (so the next chapter isn't taken for the removed
+         * one), and if the book stays in the same group or its size is close enough (RENAME_SIZE_TOLERANCE). Among
+         * several candidates the one with the closest size wins. If neither the title nor the size of the book
+         * changes, its read state is preserved.
+         */
+        void detectBooks() {
+            auto& addedBooks = this->_diff.added.books;
+            auto& removedBooks = this->_diff.removed.books;
+            const bool isFuzzy = addedBooks.size() * removedBooks.size() <= RENAME_MAX_FUZZY_PAIRS;
+
+            for (auto newBook = addedBooks.begin(); newBook != addedBooks.end() && !removedBooks.empty();) {
+                auto bestMatch = removedBooks.end();
+                double bestScore = 0.0;
+                unsigned int bestSizeDifference = 0;
+
+                for (auto storedBook = removedBooks.begin(); storedBook != removedBooks.end(); ++storedBook) {
+                    const auto similarity = storedBook->title == newBook->title
+                                            ? 1.0
+                                            : (isFuzzy ? getSimilarity(storedBook->title, newBook->title) : 0.0);
+                    if (similarity < RENAME_SIMILARITY_THRESHOLD || !hasSameNumbers(storedBook->title, newBook->title)) {
+                        continue;
+                    }
+
+                    const unsigned int sizeDifference = std::abs(static_cast<int>(storedBook->size - newBook->size));
+                    if (storedBook->group_id != newBook->group_id
+                        && sizeDifference > std::max(storedBook->size, newBook->size) * RENAME_SIZE_TOLERANCE) {
+                        continue;
+                    }
+
+                    if (similarity > bestScore || (similarity == bestScore && sizeDifference < bestSizeDifference)) {
+                        bestScore = similarity;
+                        bestSizeDifference = sizeDifference;
+                        bestMatch = storedBook;
+                    }
+                }
+
+                if (bestMatch == removedBooks.end()) {
+                    ++newBook;
+                    continue;
+                }
+
+                this->_logger->info << "The book \"" << bestMatch->title << "\" seems to be moved from \""
+                                    << bestMatch->link << "\" to \"" << newBook->link << "\"." << std::endl;
+
+                // the book may move into a new group, then it keeps the temporary ID of the group, which is resolved
+                // by Miner::apply() as for the new books
+                auto movedBook = *newBook;
+                movedBook.id = bestMatch->id;
+                movedBook.date = bestMatch->date;
+
+                if (movedBook.size == bestMatch->size && movedBook.title == bestMatch->title) {
+                    movedBook.is_new = bestMatch->is_new;
+                    movedBook.delta_size = bestMatch->delta_size;
+                    this->_decrementNewNumber(movedBook.group_id);
+                } else {
+                    movedBook.delta_size = bestSizeDifference;
+                }
+
+                this->_diff.updated.books.push_back(movedBook);
+
+                removedBooks.erase(bestMatch);
+                newBook = addedBooks.erase(newBook);
+            }
+        }
+};
+
+Miner::Miner(const std::shared_ptr<db::Connection>& connection, const std::shared_ptr<logger::Logger>& logger,
+             const std::shared_ptr<scheduler::Scheduler>& scheduler,
+             const std::shared_ptr<journal::SyncJournal>& journal) :
     _logger(logger),
     _con(connection),
     _tAuthor(std::make_shared<db::DB<db::Author>>(_con)),
     _tBook(std::make_shared<db::DB<db::Book>>(_con)),
-    _tGroup(std::make_shared<db::DB<db::GroupBook>>(_con))
+    _tGroup(std::make_shared<db::DB<db::GroupBook>>(_con)),
+    _scheduler(scheduler),
+    _journal(journal),
+    _staging(_con, _tBook, _tGroup)
 {}
 
 Miner::Miner(const std::shared_ptr<db::Connection>& connection,
              const std::shared_ptr<logger::Logger>& logger,
              const std::shared_ptr<db::DB<db::Author>>& authorDB,
              const std::shared_ptr<db::DB<db::GroupBook>>& groupDB,
-             const std::shared_ptr<db::DB<db::Book>>& bookDB
+             const std::shared_ptr<db::DB<db::Book>>& bookDB,
+             const std::shared_ptr<scheduler::Scheduler>& scheduler,
+             const std::shared_ptr<journal::SyncJournal>& journal
 ) :
-    _logger(logger), _con(connection), _tAuthor(authorDB), _tBook(bookDB), _tGroup(groupDB)
+    _logger(logger), _con(connection), _tAuthor(authorDB), _tBook(bookDB), _tGroup(groupDB), _scheduler(scheduler),
+    _journal(journal), _staging(_con, _tBook, _tGroup)
 {}
 
+void Miner::setDiffEngine(DiffEngine engine) {
+    this->_diffEngine = engine;
+}
+
+std::unique_lock<std::mutex> Miner::lockDB() {
+    return std::unique_lock(this->_dbMutex);
+}
+
+void Miner::setPipeline(const PipelineSettings& settings) {
+    this->_pipelineSettings = settings;
+}
+
+std::vector<pipeline::StageStats> Miner::getPipelineStats() const {
+    const std::lock_guard lock(this->_pipelineMutex);
+    return this->_pipeline ? this->_pipeline->getStats() : this->_pipelineStats;
+}
+
 
 void Miner::_logDiff(const Difference& diff, const db::AuthorData& author) {
+    LOG_EVENT(this->_logger, Debug, "sync.diff", {
+        {"author_id", author.id},
+        {"author", author.name},
+        {"books_added", diff.added.books.size()},
+        {"books_updated", diff.updated.books.size()},
+        {"books_removed", diff.removed.books.size()},
+        {"groups_added", diff.added.groups.size()},
+        {"groups_updated", diff.updated.groups.size()},
+        {"groups_removed", diff.removed.groups.size()},
+    });
+
     if (diff.empty()) {
         this->_logger->info << "The page of the author \"" << author.name << "\" has no changes." << std::endl;
     }
@@ -280,101 +604,371 @@ void Miner::_logDiff(const Difference& diff, const db::AuthorData& author) {
 }
 
 
-// todo: try to use getLevenshteinDistance() to identify if groups/books names were slightly modified
-Difference miner::Miner::getUpdates(const db::AuthorData& author) {
-    this->_logger->info << "Checking updates for the author \"" << author.name << "\"..." << std::endl;
+/**
+ * @brief The sync of a single author, it's passed from one step (see Miner::_fetchPage() etc) to another.
+ */
+struct Miner::SyncJob {
+    db::AuthorData author;
+    std::size_t index = 0;      // of the author in the list of the synced ones
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // the temporaries of the sync (the parsed pages, registries, URLs)
+    std::pmr::monotonic_buffer_resource arena{ARENA_INITIAL_SIZE};
+    http::Response page;
+    std::vector<http::Response> groupPages;     // the web books reference them as well as the author's page
+    parser::BookGroupViewsList webBookGroups{&arena};
     Difference diff;
+    std::exception_ptr error;   // the rest of the steps are skipped
 
-    this->_logger->debug << "Fetching data from the author's page \"" << author.url << "\"..."  << std::endl;
-    const auto pageText = http::get( http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, author.url));
-    if (pageText.empty()) {
+    explicit SyncJob(const db::AuthorData& author, std::size_t index = 0) : author(author), index(index) {}
+};
+
+std::string Miner::_getPageUrl(const SyncJob& job) const {
+    const auto& author = job.author;
+    this->_logger->info << "Checking updates for the author \"" << author.name << "\"..." << std::endl;
+
+    LOG_DEBUG(this->_logger) << "Fetching data from the author's page \"" << author.url << "\"..."  << std::endl;
+    const auto& site = http::getSettings();
+    return http::toUrl(site.protocol, site.domain, author.url);
+}
+
+void Miner::_checkPage(SyncJob& job) const {
+    const auto& author = job.author;
+    if (job.page.status == http::Status::NotFound) {
         this->_logger->warning << "The page of the author \"" << author.name << "\" (" << author.url
                               << ") cannot be found."  << std::endl;
-        diff.isPageRemoved = true;
-        return diff;
+        job.diff.isPageRemoved = true;
+        return;
     }
+    if (!job.page.isOk()) {
+        // the page may be temporarily unavailable, so nothing is changed until the next check
+        throw http::HTTPError("cannot get the page of the author \"" + author.name + "\" (" + author.url + "): "
+                              + job.page.error);
+    }
+}
 
-    const auto criteria =  db::WhereAuthorIs(author);
-
-    const auto storedBooks = this->_tBook->retrieve(criteria);
-    this->_logger->debug << "DB contains " << storedBooks.size() << " book(s) of the author \"" << author.name
-                        << "\". "  << std::endl;
+void Miner::_fetchPage(SyncJob& job) const {
+    job.page = this->_fetch(this->_getPageUrl(job), stats::Stage::FetchPage, false);
+    this->_checkPage(job);
+}
 
-    const auto storedGroups = this->_tGroup->retrieve(criteria);
-    this->_logger->debug << "DB contains " << storedGroups.size() << " book group(s) of the author \"" << author.name
-                        << "\". "  << std::endl;
+void Miner::_decodePage(SyncJob& job) const {
+    if (!job.diff.isPageRemoved) {
+        job.page.text = http::toUtf8(job.page.text);
+    }
+}
 
-    auto storedBooksRegistry = StoredBookRegistry(storedBooks, author);
-    auto storedGroupsRegistry = StoredGroupRegistry(storedGroups);
-    auto storedGroupsBuilder = StoredGroupBuilder(author, storedGroupsRegistry);
-    auto storedBookBuilder = StoredBookBuilder(author, storedBooksRegistry);
+void Miner::_parsePage(SyncJob& job) const {
+    if (job.diff.isPageRemoved) {
+        return;
+    }
 
     // todo: handle the case of the mixed structure: some books are in groups and some are not
-    auto webBookGroups = parser::getBookGroupList(pageText);
-    this->_logger->debug << "parser found " << webBookGroups.size() << " book group(s)."  << std::endl;
-
-    // fixme: refactor this!!!
-    // todo: do it concurrenlty (e.g. thread pool)
-    for (auto& webBookGroup : webBookGroups) {
-        if (!webBookGroup.url.empty()) {
-            this->_logger->debug << "Group \"" << webBookGroup.name << "\" is an extended group."
+    job.webBookGroups = stats::measure(stats::Stage::ParseGroups, [&] {
+        return parser::getBookGroupViews(job.page.text, parser::DEFAULT_BOOK_GROUPS_PATTERN, &job.arena);
+    });
+    LOG_DEBUG(this->_logger) << "parser found " << job.webBookGroups.size() << " book group(s)."  << std::endl;
+}
+
+std::vector<std::string> Miner::_getGroupUrls(const SyncJob& job, std::vector<std::size_t>& extendedGroups) const {
+    const auto& author = job.author;
+    const auto& webBookGroups = job.webBookGroups;
+    const auto& site = http::getSettings();
+
+    // the extended groups keep their books on the separate pages, all of them are fetched at once
+    std::vector<std::string> groupUrls;
+    for (std::size_t i = 0; i < webBookGroups.size(); i++) {
+        const auto& webBookGroup = webBookGroups[i];
+        if (webBookGroup.url.empty()) {
+            continue;
+        }
+
+        LOG_DEBUG(this->_logger) << "Group \"" << webBookGroup.name << "\" is an extended group."
                                 << " Fetching data from it (" << author.url << webBookGroup.url << ".shtml) ..."
                                 << std::endl;
-            const auto groupText = http::get(
-                http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, author.url, webBookGroup.url , ".shtml")
-            );
+        extendedGroups.push_back(i);
+        groupUrls.push_back(http::toUrl(site.protocol, site.domain, author.url, std::string(webBookGroup.url), ".shtml"));
+    }
 
-            if (groupText.empty()) {
-                this->_logger->warning << "Cannot get content of the extended group \"" << webBookGroup.name << "\". "
-                                      << "Skipping..."  << std::endl;
-            } else {
-                const auto extraBooks = parser::getBooks(groupText);
-                webBookGroup.books.insert(webBookGroup.books.end(), extraBooks.begin(), extraBooks.end());
-            }
+    return groupUrls;
+}
+
+void Miner::_mergeGroups(SyncJob& job, const std::vector<std::size_t>& extendedGroups) const {
+    const auto& author = job.author;
+
+    // the results are merged in the order of the groups, so the diff doesn't depend on the order of the responses
+    for (std::size_t i = 0; i < extendedGroups.size(); i++) {
+        auto& webBookGroup = job.webBookGroups[extendedGroups[i]];
+        const auto& group = job.groupPages[i];
+
+        if (group.status == http::Status::NotFound) {
+            this->_logger->warning << "Cannot get content of the extended group \"" << webBookGroup.name << "\". "
+                                  << "Skipping..."  << std::endl;
+        } else if (!group.isOk()) {
+            // otherwise the books of the group would be treated as removed
+            throw http::HTTPError("cannot get the extended group \"" + std::string(webBookGroup.name) + "\" of the author \""
+                                  + author.name + "\": " + group.error);
+        } else {
+            const auto extraBooks = stats::measure(stats::Stage::ParseBooks, [&] {
+                return parser::getBookViews(group.text, parser::DEFAULT_BOOK_PATTERN, &job.arena);
+            });
+            webBookGroup.books.insert(webBookGroup.books.end(), extraBooks.begin(), extraBooks.end());
         }
+    }
+}
 
-        this->_logger->debug << "parser found " << webBookGroup.books.size() << " book(s) in the group \""
-                            << webBookGroup.name << "\"." << " Checking..."  << std::endl;
+void Miner::_fetchGroups(SyncJob& job) const {
+    if (job.diff.isPageRemoved) {
+        return;
+    }
 
-        auto maybeNewGroup = storedGroupsBuilder.build(webBookGroup);
+    std::vector<std::size_t> extendedGroups;
+    const auto groupUrls = this->_getGroupUrls(job, extendedGroups);
+    job.groupPages = this->_fetchAll(job.author, groupUrls, stats::Stage::FetchGroup);
+    this->_mergeGroups(job, extendedGroups);
+}
 
-        for (const auto& webBook : webBookGroup.books) {
-            if (storedBooksRegistry.isNew(webBook)) {
-                this->_logger->debug << "\tBookData \"" << webBook.title << "\" is new. Adding to the result."
+void Miner::_findDifference(SyncJob& job) {
+    if (job.diff.isPageRemoved) {
+        return;
+    }
+
+    const auto& author = job.author;
+    if (this->_diffEngine == DiffEngine::Staging) {
+        const std::lock_guard lock(this->_dbMutex);
+        job.diff = stats::measure(stats::Stage::Diff, [&] {
+            return this->getStagedDifference(author, job.webBookGroups, &job.arena);
+        });
+        this->_logDiff(job.diff, author);
+        return;
+    }
+
+    db::Books storedBooks;
+    db::GroupBooks storedGroups;
+    {
+        const std::lock_guard lock(this->_dbMutex);
+        const auto criteria =  db::WhereAuthorIs(author);
+
+        storedBooks = stats::measure(stats::Stage::Retrieve, [&] {
+            return this->_tBook->retrieve(criteria);
+        });
+        LOG_DEBUG(this->_logger) << "DB contains " << storedBooks.size() << " book(s) of the author \"" << author.name
+                                << "\". "  << std::endl;
+
+        storedGroups = stats::measure(stats::Stage::Retrieve, [&] {
+            return this->_tGroup->retrieve(criteria);
+        });
+        LOG_DEBUG(this->_logger) << "DB contains " << storedGroups.size() << " book group(s) of the author \""
+                                << author.name << "\". "  << std::endl;
+    }
+
+    job.diff = stats::measure(stats::Stage::Diff, [&] {
+        return this->getDifference(author, storedBooks, storedGroups, job.webBookGroups, &job.arena);
+    });
+    this->_logDiff(job.diff, author);
+
+    if (this->_diffEngine == DiffEngine::Verify) {
+        const std::lock_guard lock(this->_dbMutex);
+        this->_verifyDifference(job.diff, this->getStagedDifference(author, job.webBookGroups, &job.arena), author);
+    }
+}
+
+Difference miner::Miner::getUpdates(const db::AuthorData& author) {
+    SyncJob job(author);
+    this->_fetchPage(job);
+    this->_decodePage(job);
+    this->_parsePage(job);
+    this->_fetchGroups(job);
+    this->_findDifference(job);
+
+    return std::move(job.diff);
+}
+
+// the rows of the Difference which are compared by _verifyDifference(), the timestamps are skipped
+static std::vector<std::string> describe(const Difference& diff) {
+    std::vector<std::string> rows;
+    const auto addBooks = [&rows](const char* kind, const db::Books& books) {
+        for (const auto& book : books) {
+            rows.push_back(std::string(kind) + " book #" + std::to_string(book.id) + " " + book.link
+                           + " size=" + std::to_string(book.size) + " delta=" + std::to_string(book.delta_size)
+                           + " group=" + std::to_string(book.group_id) + " new=" + std::to_string(book.is_new));
+        }
+    };
+    const auto addGroups = [&rows](const char* kind, const db::GroupBooks& groups) {
+        for (const auto& group : groups) {
+            rows.push_back(std::string(kind) + " group #" + std::to_string(group.id) + " " + group.name
+                           + " new=" + std::to_string(group.new_number));
+        }
+    };
+
+    addBooks("added", diff.added.books);
+    addBooks("updated", diff.updated.books);
+    addBooks("removed", diff.removed.books);
+    addGroups("added", diff.added.groups);
+    addGroups("updated", diff.updated.groups);
+    addGroups("removed", diff.removed.groups);
+    std::ranges::sort(rows);
+
+    return rows;
+}
+
+void Miner::_verifyDifference(const Difference& diff, const Difference& stagedDiff,
+                              const db::AuthorData& author) const {
+    const auto rows = describe(diff);
+    const auto stagedRows = describe(stagedDiff);
+    if (rows == stagedRows) {
+        LOG_DEBUG(this->_logger) << "The staged difference of the author \"" << author.name << "\" is the same."
+                                 << std::endl;
+        return;
+    }
+
+    std::vector<std::string> missing, unexpected;
+    std::ranges::set_difference(rows, stagedRows, std::back_inserter(missing));
+    std::ranges::set_difference(stagedRows, rows, std::back_inserter(unexpected));
+
+    this->_logger->warning << "The staged difference of the author \"" << author.name << "\" doesn't match: "
+                           << missing.size() << " change(s) are missing, " << unexpected.size()
+                           << " change(s) are unexpected." << std::endl;
+    for (const auto& row : missing) {
+        this->_logger->warning << "\tmissing: " << row << std::endl;
+    }
+    for (const auto& row : unexpected) {
+        this->_logger->warning << "\tunexpected: " << row << std::endl;
+    }
+
+    LOG_EVENT(this->_logger, Warning, "sync.diff_mismatch", {
+        {"author_id", author.id},
+        {"author", author.name},
+        {"missing", missing.size()},
+        {"unexpected", unexpected.size()},
+    });
+}
+
+Difference Miner::getStagedDifference(const db::AuthorData& author, const parser::BookGroupViewsList& webBookGroups,
+                                      std::pmr::memory_resource* resource) {
+    Difference diff;
+
+    this->_staging.stage(author, webBookGroups);
+    const auto groupIds = this->_staging.getGroupIds();
+
+    db::GroupBooks groups;
+    groups.reserve(webBookGroups.size());
+    for (std::size_t i = 0; i < webBookGroups.size(); i++) {
+        db::GroupBookData group;
+        group.name = webBookGroups[i].name;
+        group.display_name = webBookGroups[i].name;
+        group.author_id = author.id;
+        group.id = groupIds[i];
+        groups.push_back(std::move(group));
+    }
+
+    auto storedBookBuilder = StoredBookBuilder(author);
+    for (const auto& changedBook : this->_staging.getChangedBooks(author)) {
+        const auto& webBook = webBookGroups[changedBook.groupIndex].books[changedBook.bookIndex];
+        auto& group = groups[changedBook.groupIndex];
+
+        if (changedBook.isNew) {
+            LOG_DEBUG(this->_logger) << "\tBookData \"" << webBook.title << "\" is new. Adding to the result."
                                     << std::endl;
+            diff.added.books.push_back(storedBookBuilder.buildNew(webBook, group));
+        } else {
+            LOG_DEBUG(this->_logger) << "\tBookData \"" << webBook.title << "\" is changed. Adding to the result."
+                                    << std::endl;
+            diff.updated.books.push_back(storedBookBuilder.buildUpdated(webBook, changedBook.stored, group));
+        }
+    }
+
+    for (auto& group : groups) {
+        if (group.id < 0) {
+            diff.added.groups.push_back(std::move(group));
+        } else if (group.new_number) {
+            diff.updated.groups.push_back(std::move(group));
+        }
+    }
+
+    diff.removed.books = this->_staging.getRemovedBooks(author);
+    for (const auto& storedBook : diff.removed.books) {
+        this->_logger->warning << "BookData \"" << storedBook.title << "\""
+                              << " was removed by the author. It will be removed from the DB..."  << std::endl;
+    }
+    diff.removed.groups = this->_staging.getRemovedGroups(author);
+
+    // the stored books are needed only to tell the renamed groups and moved books from the removed ones
+    if (!diff.removed.empty()) {
+        const auto storedBooks = stats::measure(stats::Stage::Retrieve, [&] {
+            return this->_tBook->retrieve(db::WhereAuthorIs(author));
+        });
+
+        auto renameDetector = RenameDetector(storedBooks, diff, this->_logger, resource);
+        renameDetector.detectGroups();
+        renameDetector.detectBooks();
+    }
+
+    return diff;
+}
+
+Difference Miner::getDifference(const db::AuthorData& author, const db::Books& storedBooks,
+                                const db::GroupBooks& storedGroups, const parser::BookGroupViewsList& webBookGroups,
+                                std::pmr::memory_resource* resource) const {
+    Difference diff;
+
+    auto storedBooksRegistry = StoredBookRegistry(storedBooks, author, resource);
+    auto storedGroupsRegistry = StoredGroupRegistry(storedGroups, resource);
+    auto storedGroupsBuilder = StoredGroupBuilder(author);
+    auto storedBookBuilder = StoredBookBuilder(author);
+
+    for (const auto& webBookGroup : webBookGroups) {
+        LOG_DEBUG(this->_logger) << "parser found " << webBookGroup.books.size() << " book(s) in the group \""
+                                << webBookGroup.name << "\"." << " Checking..."  << std::endl;
+
+        // every web item is looked up once, the found handle is used for all the checks
+        const auto storedGroup = storedGroupsRegistry.find(webBookGroup);
+        if (storedGroup) {
+            storedGroup->isKnown = true;
+        }
+        auto maybeNewGroup = storedGroupsBuilder.build(webBookGroup, storedGroup);
+
+        for (const auto& webBook : webBookGroup.books) {
+            const auto storedBook = storedBooksRegistry.find(webBook);
+            if (storedBook) {
+                storedBook->isKnown = true;
+            }
+
+            if (!storedBook) {
+                LOG_DEBUG(this->_logger) << "\tBookData \"" << webBook.title << "\" is new. Adding to the result."
+                                        << std::endl;
                 diff.added.books.push_back(storedBookBuilder.buildNew(webBook, maybeNewGroup));
-            } else if (storedBooksRegistry.isUpdated(webBook) || storedBooksRegistry.isMoved(webBook, maybeNewGroup)) {
-                auto updatedBook = storedBookBuilder.buildUpdated(webBook, maybeNewGroup);
+            } else if (storedBook->book.size != webBook.size || storedBook->book.group_id != maybeNewGroup.id) {
+                auto updatedBook = storedBookBuilder.buildUpdated(webBook, storedBook->book, maybeNewGroup);
                 if (updatedBook.delta_size != webBook.size) {
-                    this->_logger->debug << "\tSize of the \"" << webBook.title << "\" book has been changed. "
-                                        << "New size is " << webBook.size << "k"
-                                        << " (difference is" << updatedBook.delta_size << "k). "  << std::endl;
+                    LOG_DEBUG(this->_logger) << "\tSize of the \"" << webBook.title << "\" book has been changed. "
+                                            << "New size is " << webBook.size << "k"
+                                            << " (difference is" << updatedBook.delta_size << "k). "  << std::endl;
                 } else {
-                    this->_logger->debug << "The \" "<< webBook.title << "\" book was moved to the group"
-                                        << " \"" << maybeNewGroup.name << "\"."  << std::endl;
+                    LOG_DEBUG(this->_logger) << "The \" "<< webBook.title << "\" book was moved to the group"
+                                            << " \"" << maybeNewGroup.name << "\"."  << std::endl;
                 }
 
-                this->_logger->debug << " Adding to the result."  << std::endl;
+                LOG_DEBUG(this->_logger) << " Adding to the result."  << std::endl;
                 diff.updated.books.push_back(updatedBook);
             } else {
-                this->_logger->debug << "\tBookData \"" << webBook.title << "\" is known and it's size remains the same:"
-                                    << " " << webBook.size << "k. Skipping..."  << std::endl;
+                LOG_DEBUG(this->_logger) << "\tBookData \"" << webBook.title << "\" is known and it's size remains"
+                                        << " the same: " << webBook.size << "k. Skipping..."  << std::endl;
             }
         }
 
-        if (storedGroupsRegistry.isNew(webBookGroup)) {
-            this->_logger->debug << "BookData group \"" << webBookGroup.name << "\" is new. Adding to the result.";
+        if (!storedGroup) {
+            LOG_DEBUG(this->_logger) << "BookData group \"" << webBookGroup.name << "\" is new. Adding to the result.";
             diff.added.groups.push_back(maybeNewGroup);
         } else if (maybeNewGroup.new_number) {
-            this->_logger->debug << "BookData group \"" << webBookGroup.name << "\" is changed,"
-                                << " it has " << maybeNewGroup.new_number << " new/updated book(s). "
-                                << " Adding to the result.";
+            LOG_DEBUG(this->_logger) << "BookData group \"" << webBookGroup.name << "\" is changed,"
+                                    << " it has " << maybeNewGroup.new_number << " new/updated book(s). "
+                                    << " Adding to the result.";
             diff.updated.groups.push_back(maybeNewGroup);
         } else {
-            this->_logger->debug << "BookData group \"" << webBookGroup.name << "\" is known and has no changes.";
+            LOG_DEBUG(this->_logger) << "BookData group \"" << webBookGroup.name << "\" is known and has no changes.";
         }
 
-        this->_logger->debug << std::endl;
+        LOG_DEBUG(this->_logger) << std::endl;
     }
 
     for (const auto& storedBook : storedBooksRegistry.getAbandonedBooks()) {
@@ -384,19 +978,22 @@ Difference miner::Miner::getUpdates(const db::AuthorData& author) {
     }
 
     for(const auto& group: storedGroupsRegistry.getAbandonedGroups()) {
-        this->_logger->debug << "Group \"" << group.name << "\""
-                            << " was removed by the author. It will be removed from the DB..."  << std::endl;
+        LOG_DEBUG(this->_logger) << "Group \"" << group.name << "\""
+                                << " was removed by the author. It will be removed from the DB..."  << std::endl;
         diff.removed.groups.push_back(group);
     }
 
-    this->_logDiff(diff, author);
+    auto renameDetector = RenameDetector(storedBooks, diff, this->_logger, resource);
+    renameDetector.detectGroups();
+    renameDetector.detectBooks();
 
     return diff;
 }
 
 void Miner::apply(Difference& diff, db::AuthorData& author) {
     if (diff.empty()) {
-        this->_logger->debug << "No changes to apply for the author \"" << author.name << "\". Exiting..." << std::endl;
+        LOG_DEBUG(this->_logger) << "No changes to apply for the author \"" << author.name << "\". Exiting..."
+                                 << std::endl;
         return;
     }
 
@@ -408,66 +1005,562 @@ void Miner::apply(Difference& diff, db::AuthorData& author) {
             this->_tBook->remove(byAuthor);
             this->_tGroup->remove(byAuthor);
             this->_tAuthor->remove(db::WhereMe(author));
+            this->_tAuthor->commit();
         } catch (const db::DBError &err) {
             this->_logger->error << "Cannot remove data for the author \"" << author.name << "\""
                                 << "due to DB error: \"" << err.what() << "\"" << std::endl;
             this->_tAuthor->rollback();
-            return;
+            throw;
+        } catch (...) {
+            this->_tAuthor->rollback();
+            throw;
         }
-        this->_tAuthor->commit();
-        this->_logger->debug << "All data about author \"" << author.name << "\" was removed from the DB." << std::endl;
+        LOG_DEBUG(this->_logger) << "All data about author \"" << author.name << "\" was removed from the DB."
+                                 << std::endl;
         return;
     }
 
-    if (!diff.added.empty()) {
-        auto groupMap = this->_tGroup->add(diff.added.groups);
-        for (auto& book: diff.added.books) {
-            book.group_id = groupMap[book.group_id].id;
+    // all changes of the author are saved at once (the nested transactions of the DB become savepoints), so the
+    // interrupted sync never leaves the author half-updated
+    const auto updatedAuthor = [&author] {
+        auto updated = author;
+        updated.is_new = true;
+        updated.mtime = getNow();
+        return updated;
+    }();
+
+    this->_con->begin();
+    try {
+        if (!diff.added.empty()) {
+            const auto groupMap = this->_tGroup->add(diff.added.groups);
+
+            // the books of the new groups (either new or moved from another group) refer them by the temporary
+            // negative IDs (see StoredGroupBuilder)
+            const auto resolveGroupIds = [&groupMap](db::Books& books) {
+                for (auto& book: books) {
+                    if (book.group_id < 0) {
+                        book.group_id = groupMap.at(book.group_id).id;
+                    }
+                }
+            };
+            resolveGroupIds(diff.added.books);
+            resolveGroupIds(diff.updated.books);
+            this->_tBook->add(diff.added.books);
+        }
+
+        if (!diff.updated.empty()) {
+            this->_tGroup->update(diff.updated.groups);
+            this->_tBook->update(diff.updated.books);
         }
-        this->_tBook->add(diff.added.books);
-        this->_logger->debug << "All new group/books of the author \"" << author.name << "\" were added to the DB"
-                            << std::endl;
+
+        if (!diff.removed.empty()) {
+            this->_tGroup->remove(diff.removed.groups);
+            this->_tBook->remove(diff.removed.books);
+        }
+
+        this->_tAuthor->update(updatedAuthor);
+        this->_con->commit();
+    } catch (const db::DBError &err) {
+        this->_con->rollback();
+        this->_logger->error << "Cannot save changes of the author \"" << author.name << "\" "
+                             << "due to DB error: \"" << err.what() << "\"" << std::endl;
+        throw;
+    } catch (...) {
+        this->_con->rollback();
+        throw;
     }
+    author = updatedAuthor;
 
-    if (!diff.updated.empty()) {
-        this->_tGroup->update(diff.updated.groups);
-        this->_tBook->update(diff.updated.books);
-        this->_logger->debug << "All updates of group(s)/book(s)s of the author \"" << author.name << "\""
-                            << " were saved to the DB" << std::endl;
+    LOG_DEBUG(this->_logger) << "All changes of the author \"" << author.name << "\" were saved to the DB "
+                             << "(" << diff.added.books.size() << " new, " << diff.updated.books.size() << " updated, "
+                             << diff.removed.books.size() << " removed book(s))" << std::endl;
+}
+
+void Miner::sync(db::AuthorData &author) {
+    this->_sync(author, [](const db::AuthorData&){});
+}
+
+void Miner::_save(db::AuthorData& author, Difference& diff,
+                  const std::function<void(const db::AuthorData&)>& onSynced) {
+    // apply() marks the author as updated, but it's saved only when the transaction below is committed
+    auto savedAuthor = author;
+
+    // the changes, the schedule and the journal record of the author are saved in a single transaction
+    stats::ScopedTimer applyTimer(stats::Stage::Apply);
+    const std::lock_guard lock(this->_dbMutex);
+    this->_con->begin();
+    try {
+        this->apply(diff, savedAuthor);
+
+        if (this->_scheduler) {
+            if (diff.isPageRemoved) {
+                this->_scheduler->remove(author.id);
+            } else {
+                this->_scheduler->onChecked(author, !diff.empty(), getNow());
+            }
+        }
+
+        onSynced(savedAuthor);
+        this->_con->commit();
+    } catch (...) {
+        this->_con->rollback();  // a no-op if the commit has failed, the transaction is rolled back already
+        throw;
     }
+    author = savedAuthor;
+}
 
-    if (!diff.removed.empty()) {
-        this->_tGroup->remove(diff.removed.groups);
-        this->_tBook->remove(diff.removed.books);
-        this->_logger->debug << "All group(s)/book(s)s removed by the author \"" << author.name << "\""
-                            << " were removed from the DB" << std::endl;
+void Miner::_logSynced(const db::AuthorData& author, std::chrono::steady_clock::time_point start) const {
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+    LOG_EVENT(this->_logger, Debug, "sync.author", {
+        {"author_id", author.id},
+        {"author", author.name},
+        {"duration_ms", duration.count()},
+    });
+}
+
+void Miner::_sync(db::AuthorData &author, const std::function<void(const db::AuthorData&)>& onSynced) {
+    const stats::AuthorScope statsScope(author.id, author.name);
+    const auto start = std::chrono::steady_clock::now();
+
+    {
+        stats::ScopedTimer timer(stats::Stage::Author);
+
+        auto diff = this->getUpdates(author);
+        this->_save(author, diff, onSynced);
     }
 
-    author.is_new = true;
-    author.mtime = getNow();
-    this->_tAuthor->update(author);
-    this->_logger->debug << "An update marker is added to the author \"" << author.name << "\"" << std::endl;
+    this->_logSynced(author, start);
 }
 
-void Miner::sync(db::AuthorData &author) {
-    auto diff = this->getUpdates(author);
-    this->apply(diff, author);
+async::Task<db::AuthorData> Miner::_syncAsync(db::AuthorData author, async::Strand& dbStrand,
+                                             std::function<void(const db::AuthorData&)> onSynced) {
+    // the caller's thread isn't blocked even by the first steps
+    co_await async::schedule();
+
+    // the coroutine may be resumed by another thread after every `co_await`, so every synchronous segment opens
+    // its own stats::AuthorScope (it's attributed to the current thread)
+    SyncJob job(author);
+    job.page = co_await this->_fetchAsync(job.author, this->_getPageUrl(job), stats::Stage::FetchPage, false);
+
+    std::vector<std::size_t> extendedGroups;
+    std::vector<async::Task<http::Response>> fetches;
+    {
+        const stats::AuthorScope statsScope(job.author.id, job.author.name);
+        this->_checkPage(job);
+        this->_decodePage(job);
+        this->_parsePage(job);
+
+        if (!job.diff.isPageRemoved) {
+            for (auto& url : this->_getGroupUrls(job, extendedGroups)) {
+                fetches.push_back(this->_fetchAsync(job.author, std::move(url), stats::Stage::FetchGroup, true));
+            }
+        }
+    }
+
+    if (!fetches.empty()) {
+        job.groupPages = co_await async::whenAll(std::move(fetches));
+    }
+
+    {
+        const stats::AuthorScope statsScope(job.author.id, job.author.name);
+        if (!job.diff.isPageRemoved) {
+            this->_mergeGroups(job, extendedGroups);
+        }
+
+        // the reads of the DB take turns with the writes of the strand (see _dbMutex)
+        this->_findDifference(job);
+    }
+
+    co_await dbStrand.run([&] {
+        const stats::AuthorScope statsScope(job.author.id, job.author.name);
+        this->_save(job.author, job.diff, onSynced);
+        stats::record(stats::Stage::Author, std::chrono::steady_clock::now() - job.start);
+        this->_logSynced(job.author, job.start);
+    });
+    co_return job.author;
 }
 
-void Miner::syncAll(const std::function<void(const db::AuthorData&, unsigned int, unsigned int)>& progressCallback) {
+async::Task<db::AuthorData> Miner::syncAsync(db::AuthorData author, async::Strand& dbStrand) {
+    co_return co_await this->_syncAsync(std::move(author), dbStrand, [](const db::AuthorData&){});
+}
+
+async::Task<void> Miner::_syncNext(db::Authors& authors, std::atomic<std::size_t>& next, async::Strand& dbStrand,
+                                   const std::function<void(const db::AuthorData&)>& onSynced,
+                                   std::atomic<unsigned int>& failedCount) {
+    for (auto i = next++; i < authors.size(); i = next++) {
+        try {
+            authors[i] = co_await this->_syncAsync(authors[i], dbStrand, onSynced);
+        } catch (const SamLibError& err) {
+            failedCount++;
+            this->_logFailure(authors[i], err);
+        }
+    }
+}
+
+async::Task<void> Miner::syncAllAsync(async::Strand& dbStrand, unsigned int concurrency) {
+    std::optional<db::SyncRunData> run;
+    db::Authors authors;
+    co_await dbStrand.run([&] {
+        const std::lock_guard lock(this->_dbMutex);
+        authors = this->_tAuthor->retrieve();
+        if (this->_journal) {
+            run = this->_journal->begin(authors.size(), getNow());
+        }
+    });
+
+    // it's referenced by the coroutines, so it must not be a temporary
+    const std::function<void(const db::AuthorData&)> onSynced = [this, &run](const db::AuthorData& author) {
+        if (run) {
+            this->_journal->markChecked(*run, author, getNow());
+        }
+    };
+
+    // every coroutine syncs the next unchecked author until none are left
+    std::atomic<std::size_t> next{0};
+    std::atomic<unsigned int> failedCount{0};
+    std::vector<async::Task<void>> syncs;
+    const auto count = std::min<std::size_t>(std::max(concurrency, 1u), authors.size());
+    for (std::size_t i = 0; i < count; i++) {
+        syncs.push_back(this->_syncNext(authors, next, dbStrand, onSynced, failedCount));
+    }
+    co_await async::whenAll(std::move(syncs));
+
+    if (run) {
+        co_await dbStrand.run([&] {
+            const std::lock_guard lock(this->_dbMutex);
+            this->_journal->finish(*run, getNow());
+        });
+    }
+
+    if (failedCount) {
+        this->_logger->warning << "Cannot check updates of " << failedCount.load() << " of " << authors.size()
+                               << " author(s), they will be checked next time" << std::endl;
+    }
+
+    if (stats::isEnabled()) {
+        this->_logStats();
+    }
+}
+
+void Miner::_syncPipelined(
+    db::Authors& authors,
+    const std::function<void(const db::AuthorData&)>& onSynced,
+    const std::function<void(const db::AuthorData&, const std::exception_ptr&)>& onChecked
+) {
+    using Job = std::unique_ptr<SyncJob>;
+    const auto& settings = this->_pipelineSettings;
+
+    // every step is attributed to the author of the job, the failed jobs just pass the rest of the stages
+    const auto step = [](std::function<void(SyncJob&)> method) {
+        return [method = std::move(method)](Job& job) {
+            if (job->error) {
+                return;
+            }
+
+            const stats::AuthorScope statsScope(job->author.id, job->author.name);
+            try {
+                method(*job);
+            } catch (...) {
+                job->error = std::current_exception();
+            }
+        };
+    };
+
+    pipeline::Pipeline<Job> pipeline(settings.queueDepth);
+    pipeline.addStage("fetch", settings.fetchWorkers, step([this](SyncJob& job) {
+        job.start = std::chrono::steady_clock::now();
+        this->_fetchPage(job);
+    }));
+    pipeline.addStage("decode", settings.decodeWorkers, step([this](SyncJob& job) {this->_decodePage(job);}));
+    pipeline.addStage("parse", settings.parseWorkers, step([this](SyncJob& job) {this->_parsePage(job);}));
+    pipeline.addStage("fetch groups", settings.groupWorkers, step([this](SyncJob& job) {this->_fetchGroups(job);}));
+    pipeline.addStage("diff", settings.diffWorkers, step([this](SyncJob& job) {this->_findDifference(job);}));
+    const auto save = step([this, &onSynced](SyncJob& job) {
+        this->_save(job.author, job.diff, onSynced);
+        stats::record(stats::Stage::Author, std::chrono::steady_clock::now() - job.start);
+        this->_logSynced(job.author, job.start);
+    });
+    pipeline.addStage("apply", 1, [&](Job& job) {
+        save(job);
+
+        auto& author = authors[job->index];
+        author = job->author;
+        onChecked(author, job->error);
+    });
+
+    std::vector<Job> jobs;
+    jobs.reserve(authors.size());
+    for (std::size_t i = 0; i < authors.size(); i++) {
+        jobs.push_back(std::make_unique<SyncJob>(authors[i], i));
+    }
+
+    // the stats of the running pipeline are available via getPipelineStats(), the last ones are kept after it's done
+    const auto onFinished = [this, &pipeline] {
+        const std::lock_guard lock(this->_pipelineMutex);
+        this->_pipelineStats = pipeline.getStats();
+        this->_pipeline = nullptr;
+    };
+    {
+        const std::lock_guard lock(this->_pipelineMutex);
+        this->_pipeline = &pipeline;
+    }
+    try {
+        pipeline.run(std::move(jobs));
+    } catch (...) {
+        onFinished();
+        throw;
+    }
+    onFinished();
+
+    for (const auto& stage : this->_pipelineStats) {
+        LOG_EVENT(this->_logger, Debug, "sync.pipeline", {
+            {"stage", stage.name},
+            {"workers", stage.workers},
+            {"items", stage.items},
+            {"utilization", stage.getUtilization()},
+            {"queue_avg", stage.input.averageDepth},
+            {"queue_max", stage.input.maxDepth},
+            {"queue_capacity", stage.input.capacity},
+            {"blocked_ms", std::chrono::duration<double, std::milli>(stage.input.blocked).count()},
+        });
+    }
+}
+
+void Miner::_logFailure(const db::AuthorData& author, const SamLibError& error) {
+    stats::add(stats::Counter::Failures, 1);
+    this->_logger->error << "Cannot check updates of the author \"" << author.name << "\": " << error.what()
+                         << std::endl;
+    LOG_EVENT(this->_logger, Debug, "sync.error", {
+        {"author_id", author.id},
+        {"author", author.name},
+        {"error", error.what()},
+    });
+}
+
+void Miner::_syncAuthors(
+    db::Authors& authors,
+    const std::function<void(const db::AuthorData&, unsigned int, unsigned int)>& progressCallback,
+    const std::function<void(const db::AuthorData&)>& onSynced
+) {
     unsigned int current = 1;
-    auto totalCount = this->_tAuthor->count();
-    for(auto& author : this->_tAuthor->retrieve()) {
-        this->sync(author);
+    unsigned int failedCount = 0;
+    const auto totalCount = static_cast<unsigned int>(authors.size());
+
+    // a failure of a single author (e.g. the site is temporarily unavailable) must not stop the whole sync
+    const auto onChecked = [&](const db::AuthorData& author, const std::exception_ptr& error) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const SamLibError& err) {
+                failedCount++;
+                this->_logFailure(author, err);
+            }
+        }
         progressCallback(author, current, totalCount);
         current++;
+    };
+
+    if (this->_pipelineSettings.isEnabled && authors.size() > 1) {
+        this->_syncPipelined(authors, onSynced, onChecked);
+    } else {
+        for (auto& author : authors) {
+            std::exception_ptr error;
+            try {
+                this->_sync(author, onSynced);
+            } catch (const SamLibError&) {
+                error = std::current_exception();
+            }
+            onChecked(author, error);
+        }
+    }
+
+    if (failedCount) {
+        this->_logger->warning << "Cannot check updates of " << failedCount << " of " << totalCount << " author(s), "
+                               << "they will be checked next time" << std::endl;
     }
+
+    if (stats::isEnabled()) {
+        this->_logStats();
+    }
+}
+
+void Miner::syncAll(const std::function<void(const db::AuthorData&, unsigned int, unsigned int)>& progressCallback) {
+    this->syncAll(false, progressCallback);
+}
+
+void Miner::syncAll(
+    bool resume,
+    const std::function<void(const db::AuthorData&, unsigned int, unsigned int)>& progressCallback
+) {
+    auto authors = this->_tAuthor->retrieve();
+    if (!this->_journal) {
+        this->_syncAuthors(authors, progressCallback, [](const db::AuthorData&){});
+        return;
+    }
+
+    auto run = resume ? this->_journal->getInterrupted() : std::nullopt;
+    if (run) {
+        const auto checked = this->_journal->getChecked(*run);
+        std::erase_if(authors, [&checked](const auto& author) {return checked.contains(author.id);});
+        this->_logger->info << "Resuming the interrupted run #" << run->id << ": " << checked.size()
+                            << " author(s) are already checked, " << authors.size() << " left" << std::endl;
+    } else {
+        if (resume) {
+            this->_logger->info << "There is no interrupted run to resume, starting a new one" << std::endl;
+        }
+        run = this->_journal->begin(authors.size(), getNow());
+    }
+
+    this->_syncAuthors(authors, progressCallback, [this, &run](const db::AuthorData& author) {
+        this->_journal->markChecked(*run, author, getNow());
+    });
+    this->_journal->finish(*run, getNow());
+}
+
+void Miner::syncDue(
+    bool unreadFirst,
+    const std::function<void(const db::AuthorData&, unsigned int, unsigned int)>& progressCallback
+) {
+    if (!this->_scheduler) {
+        this->syncAll(progressCallback);
+        return;
+    }
+
+    auto authors = this->_scheduler->getDueAuthors(getNow(), unreadFirst);
+    this->_logger->info << authors.size() << " of " << this->_tAuthor->count() << " author(s) are due to check"
+                        << std::endl;
+    this->_syncAuthors(authors, progressCallback, [](const db::AuthorData&){});
+}
+
+void Miner::_logStats() {
+    const auto summary = stats::getSummary();
+
+    for (std::size_t i = 0; i < stats::STAGES_COUNT; i++) {
+        const auto& stage = summary.stages[i];
+        if (!stage.count) {
+            continue;
+        }
+
+        LOG_EVENT(this->_logger, Debug, "sync.stats", {
+            {"stage", stats::getName(static_cast<stats::Stage>(i))},
+            {"count", stage.count},
+            {"total_ms", std::chrono::duration<double, std::milli>(stage.total).count()},
+            {"p50_ms", std::chrono::duration<double, std::milli>(stage.getPercentile(50)).count()},
+            {"p99_ms", std::chrono::duration<double, std::milli>(stage.getPercentile(99)).count()},
+            {"max_ms", std::chrono::duration<double, std::milli>(stage.max).count()},
+        });
+    }
+
+    LOG_EVENT(this->_logger, Debug, "sync.stats", {
+        {"stage", "total"},
+        {"requests", summary.counters[static_cast<std::size_t>(stats::Counter::Requests)]},
+        {"bytes_on_wire", summary.counters[static_cast<std::size_t>(stats::Counter::BytesOnWire)]},
+        {"bytes_downloaded", summary.counters[static_cast<std::size_t>(stats::Counter::BytesDownloaded)]},
+        {"bytes_decoded", summary.counters[static_cast<std::size_t>(stats::Counter::BytesDecoded)]},
+        {"throttled", summary.counters[static_cast<std::size_t>(stats::Counter::Throttled)]},
+        {"retries", summary.counters[static_cast<std::size_t>(stats::Counter::Retries)]},
+        {"failures", summary.counters[static_cast<std::size_t>(stats::Counter::Failures)]},
+    });
 }
 
 void Miner::syncAll() {
     this->syncAll([](const db::AuthorData&, unsigned int, unsigned int){});
 }
 
+void Miner::_logFetch(const std::string& url, const http::Response& response,
+                      std::chrono::steady_clock::time_point start) const {
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+    LOG_EVENT(this->_logger, Debug, "sync.fetch", {
+        {"url", url},
+        {"status", http::getName(response.status)},
+        {"http_code", response.httpCode},
+        {"bytes", response.text.size()},
+        {"wire_bytes", response.wireSize},
+        {"duration_ms", duration.count()},
+    });
+}
+
+http::Response Miner::_fetch(const std::string& url, stats::Stage stage, bool decode) const {
+    const auto start = std::chrono::steady_clock::now();
+    auto response = stats::measure(stage, [&url, decode] { return decode ? http::fetch(url) : http::fetchRaw(url); });
+    this->_logFetch(url, response, start);
+
+    return response;
+}
+
+async::Task<http::Response> Miner::_fetchAsync(const db::AuthorData& author, std::string url, stats::Stage stage,
+                                                bool decode) const {
+    const auto start = std::chrono::steady_clock::now();
+    auto response = co_await http::fetchRawAsync(url);
+
+    const stats::AuthorScope statsScope(author.id, author.name);
+    // the bytes are counted by the event loop, it doesn't know the author
+    stats::attribute(stats::Counter::BytesOnWire, response.wireSize);
+    stats::attribute(stats::Counter::BytesDownloaded, response.text.size());
+    if (decode && response.isOk()) {
+        response.text = http::toUtf8(response.text);
+    }
+    stats::record(stage, std::chrono::steady_clock::now() - start);
+    this->_logFetch(url, response, start);
+
+    co_return response;
+}
+
+std::vector<http::Response> Miner::_fetchAll(const db::AuthorData& author, const std::vector<std::string>& urls,
+                                             stats::Stage stage) const {
+    std::vector<http::Response> responses(urls.size());
+    if (urls.size() < 2) {
+        for (std::size_t i = 0; i < urls.size(); i++) {
+            responses[i] = this->_fetch(urls[i], stage);
+        }
+        return responses;
+    }
+
+    // there is no point to start more workers than the host's limiter lets through
+    const auto maxConnections = http::getSettings().maxConnections;
+    auto workersCount = std::min<std::size_t>(urls.size(), MAX_PARALLEL_FETCHES);
+    if (maxConnections > 0) {
+        workersCount = std::min<std::size_t>(workersCount, maxConnections);
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    const auto work = [&] {
+        for (auto i = next++; i < urls.size(); i = next++) {
+            try {
+                responses[i] = this->_fetch(urls[i], stage);
+            } catch (...) {
+                const std::lock_guard lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(workersCount - 1);
+    for (std::size_t i = 1; i < workersCount; i++) {
+        workers.emplace_back([&] {
+            const stats::AuthorScope statsScope(author.id, author.name);
+            work();
+        });
+    }
+    work();  // the current thread is one of the workers
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return responses;
+}
+
 std::string Miner::_getAuthorUrl(const std::string& url) const {
     if (url.empty()) {
         throw miner::InvalidURL("The url \"" + url + "\" isn't a valid author's URL");
@@ -479,29 +1572,28 @@ std::string Miner::_getAuthorUrl(const std::string& url) const {
         throw miner::InvalidURL("The url \"" + url + "\" isn't a valid author's URL");
     }
 
+    const auto& site = http::getSettings();
     if (matches[1].length() > 0) { // check if group 1 is not empty
-        return http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, matches[1]);
+        return http::toUrl(site.protocol, site.domain, matches[1]);
     }
 
     std::string result = matches[3];
-    auto authorUrl = http::toUrl(http::S_PROTOCOL, http::S_DOMAIN, result.substr(0, 1),  result );
+    auto authorUrl = http::toUrl(site.protocol, site.domain, result.substr(0, 1),  result );
 
     return authorUrl.ends_with("/") ? authorUrl : authorUrl + "/";
 }
 
 inline std::string stripDomain(const std::string& url) {
-    auto domainPos = url.find(http::S_DOMAIN);
-    if (domainPos > 0) {
-        return url.substr(domainPos + http::S_DOMAIN.length(), url.length());
+    const auto& domain = http::getSettings().domain;
+    auto domainPos = url.find(domain);
+    if (domainPos != std::string::npos) {
+        return url.substr(domainPos + domain.length(), url.length());
     }
 
     return url;
 }
 
-db::AuthorData Miner::getAuthor(const std::string& url) const {
-    const auto canonicalURL = this->_getAuthorUrl(url);
-    this->_logger->debug << "Fetching data from the webAuthor's page \"" << canonicalURL << "\"..."  << std::endl;
-    const auto pageText = http::get(canonicalURL);
+db::AuthorData Miner::_toAuthor(const std::string& canonicalURL, const http::Page& pageText) const {
     db::AuthorData dbAuthor;
     if (pageText.empty()) {
         this->_logger->warning << "Cannot find webAuthor's page for the URL \"" << canonicalURL << "\"." << std::endl;
@@ -515,4 +1607,26 @@ db::AuthorData Miner::getAuthor(const std::string& url) const {
     dbAuthor.mtime = getNow();
 
     return dbAuthor;
+}
+
+db::AuthorData Miner::getAuthor(const std::string& url) const {
+    const auto canonicalURL = this->_getAuthorUrl(url);
+    LOG_DEBUG(this->_logger) << "Fetching data from the webAuthor's page \"" << canonicalURL << "\"..."  << std::endl;
+    return this->_toAuthor(canonicalURL, http::get(canonicalURL));
+}
+
+async::Task<db::AuthorData> Miner::getAuthorAsync(std::string url) const {
+    const auto canonicalURL = this->_getAuthorUrl(url);
+    LOG_DEBUG(this->_logger) << "Fetching data from the webAuthor's page \"" << canonicalURL << "\"..."  << std::endl;
+
+    // the same as http::get()
+    auto response = co_await http::fetchAsync(canonicalURL);
+    if (response.status == http::Status::NotFound) {
+        response.text.clear();
+    } else if (!response.isOk()) {
+        throw http::HTTPError("cannot get \"" + canonicalURL + "\" (" + http::getName(response.status) + "): "
+                              + response.error);
+    }
+
+    co_return this->_toAuthor(canonicalURL, response.text);
 }
\ No newline at end of file
@@ -15,101 +15,295 @@
  */
 
 #include <regex>
+#include <unordered_map>
 #include "parser.h"
 #include "tools.h"
 
 using namespace parser;
 
 
-/**
- * @class TextCleaner
- *
- * @brief Class to clean text by removing HTML tags, newlines, and multiple spaces.
- *
- * The TextCleaner class provides methods to clean text strings by removing HTML tags, replacing HTML newlines with
- * newlines removing multiple spaces, trimming the leading and trailing spaces, and replacing certain special characters
- */
-class TextCleaner {
-    private:
-        std::regex _reHtmlTags;
-        std::regex _reHtmlNewLine;
-        std::regex _reMultipleSpaces;
-
-    public:
-        explicit TextCleaner() {
-            _reHtmlTags.assign("<\\/?(\\S+?)[^>]*?>", std::regex_constants::multiline | std::regex_constants::icase);
-            _reHtmlNewLine.assign("<dd>|<br/?>", std::regex_constants::multiline | std::regex_constants::icase);
-            _reMultipleSpaces.assign("\\s{2,}", std::regex_constants::multiline);
-        }
+std::string TextCleaner::clean(std::string_view text) const {
+    return cleanHtml(text);
+}
 
-        /**
-         * @brief Cleans the given text by removing HTML tags, newlines, and multiple spaces.
-         *
-         * This function takes a string `text` as input and performs the following operations to clean the text:
-         * 1. Replaces HTML newlines with actual newlines.
-         * 2. Removes HTML tags from the text.
-         * 3. Replaces multiple spaces with a single space.
-         * 4. Trims leading and trailing spaces.
-         * 5. Replaces the special character "&#8212;" with a hyphen "-".
-         *
-         * @param text The text to be cleaned.
-         * @return The cleaned version of the input text.
-         */
-        std::string clean(const std::string& text) {
-            std::string cleanText = std::regex_replace(text, _reHtmlNewLine, "\n");
-            cleanText = std::regex_replace(cleanText, _reHtmlTags, "");
-            cleanText = std::regex_replace(cleanText, _reMultipleSpaces, " ");
-            trim(cleanText, [](unsigned char ch){return ch != ' ';});
-            replaceAll(cleanText, "&#8212;", "-");
-
-            return cleanText;
-        }
-};
 
+// the compiling of a regex allocates a lot, so the patterns are compiled once per thread (std::regex isn't thread-safe)
+static const std::regex& getRegex(const std::string& pattern, std::regex_constants::syntax_option_type flags) {
+    thread_local std::unordered_map<std::string, std::regex> cache;
+    auto regex = cache.find(pattern);
+    if (regex == cache.end() || regex->second.flags() != flags) {
+        regex = cache.insert_or_assign(pattern, std::regex(pattern, flags)).first;
+    }
+    return regex->second;
+}
 
-BooksList parser::getBooks(const std::string& pageText, const std::string& bookPattern) {
-    auto textCleaner = std::make_unique<TextCleaner>();
+static std::string_view toView(const std::csub_match& match) {
+    return match.matched ? std::string_view(match.first, match.length()) : std::string_view();
+}
 
-    std::regex reBooks(bookPattern, std::regex_constants::multiline | std::regex_constants::icase);
+static unsigned int toSize(std::string_view digits) {
+    unsigned int size = 0;
+    for (const auto digit : digits) {
+        size = size * 10 + (digit - '0');
+    }
+    return size;
+}
 
-    BooksList bookList;
-    std::sregex_iterator begin = std::sregex_iterator(pageText.begin(), pageText.end(), reBooks);
-    std::sregex_iterator end;
+Book BookView::toBook(const TextCleaner& cleaner) const {
+    Book book;
+    book.size = this->size;
+    book.url = this->url;
+    book.title = this->title;
+    book.genre = this->genre;
+    book.description = cleaner.clean(this->description);
+
+    return book;
+}
+
+
+BookViewsList parser::getBookViews(std::string_view pageText, const std::string& bookPattern,
+                                   std::pmr::memory_resource* resource) {
+    const auto& reBooks = getRegex(bookPattern, std::regex_constants::multiline | std::regex_constants::icase);
+
+    BookViewsList bookList(resource);
+    std::cregex_iterator begin(pageText.data(), pageText.data() + pageText.size(), reBooks);
+    std::cregex_iterator end;
 
     // todo: rewrite by using named groups instead of indices (i.e. `(?<url>...)`, `(?<title>...)` etc
-    for (std::sregex_iterator iterator = begin; iterator != end; ++iterator) {
-        const std::smatch& match = *iterator;
-        Book book;
-        book.size = std::stoi(match[3].str());
-        book.url = match[1].str();
-        book.title = trim_copy(match[2].str(), noisyChar);
-        book.genre = trim_copy(match[4].str(), noisyChar);
-        book.description = textCleaner->clean(match[5].str());
-
-        bookList.push_back(std::move(book));
+    for (std::cregex_iterator iterator = begin; iterator != end; ++iterator) {
+        const std::cmatch& match = *iterator;
+        BookView book;
+        book.size = toSize(toView(match[3]));
+        book.url = toView(match[1]);
+        book.title = trim_view(toView(match[2]), noisyChar);
+        book.genre = trim_view(toView(match[4]), noisyChar);
+        book.description = toView(match[5]);
+
+        bookList.push_back(book);
     }
 
     return bookList;
 }
 
-BookGroupsList parser::getBookGroupList(const std::string &pageText, const std::string& bookGroupPattern) {
-    std::regex reBookGroups(bookGroupPattern, std::regex_constants::ECMAScript);
-    BookGroupsList bookGroupsList;
-    std::sregex_iterator begin = std::sregex_iterator(pageText.begin(), pageText.end(), reBookGroups);
-    std::sregex_iterator end;
+namespace {
+    // the group as it's found by the first pass over the page, its books aren't parsed yet
+    struct GroupSpan {
+        std::string_view url;
+        std::string_view name;
+        std::string_view content;
+    };
 
-    for (std::sregex_iterator i = begin; i != end; ++i) {
-        const std::smatch& match = *i;
-        const auto url = match[1].str();
+    class Scanner {
+        private:
+            std::string_view _text;
+            std::size_t _position;
 
-        BookGroup bookGroup;
-        bookGroup.type = url.empty() ? BookGroupPlain : BookGroupExternal;
-        bookGroup.name = trim_copy(match[2].str(), noisyChar);
-        bookGroup.books = getBooks(match[3].str());
+            template <typename Predicate>
+            std::string_view _takeWhile(Predicate predicate) {
+                const auto start = this->_position;
+                while (this->_position < this->_text.size() && predicate(this->_text[this->_position])) {
+                    this->_position++;
+                }
+                return this->_text.substr(start, this->_position - start);
+            }
+
+        public:
+            Scanner(std::string_view text, std::size_t position) : _text(text), _position(position) {}
+
+            [[nodiscard]] std::size_t getPosition() const {return this->_position;}
+            void setPosition(std::size_t position) {this->_position = position;}
+
+            bool skip(std::string_view token) {
+                if (!this->_text.substr(this->_position).starts_with(token)) {
+                    return false;
+                }
+                this->_position += token.size();
+                return true;
+            }
+
+            // `\s+`
+            bool skipSpaces() {return !this->_takeWhile([](char ch) {return isSpaceChar(ch);}).empty();}
+
+            // `\d+`
+            bool skipDigits() {return !this->_takeWhile([](char ch) {return ch >= '0' && ch <= '9';}).empty();}
+
+            // `[^<>]+`
+            std::string_view takeText() {return this->_takeWhile([](char ch) {return ch != '<' && ch != '>';});}
+    };
+
+    // `<a\s+href=([^<>]+)\.shtml><font\s+color=#393939>`
+    std::string_view scanGroupUrl(Scanner& scanner) {
+        const auto start = scanner.getPosition();
+        if (scanner.skip("<a") && scanner.skipSpaces() && scanner.skip("href=")) {
+            const auto url = scanner.takeText();
+            if (url.size() > 6 && url.ends_with(".shtml") && scanner.skip(">") && scanner.skip("<font")
+                && scanner.skipSpaces() && scanner.skip("color=#393939>")) {
+                return url.substr(0, url.size() - 6);
+            }
+        }
+
+        scanner.setPosition(start);
+        return {};
+    }
+
+    // the header of the group up to its content (see DEFAULT_BOOK_GROUPS_PATTERN)
+    bool scanGroupHeader(Scanner& scanner, GroupSpan& span) {
+        if (!(scanner.skip("<a") && scanner.skipSpaces() && scanner.skip("name=gr") && scanner.skipDigits()
+              && scanner.skip(">"))) {
+            return false;
+        }
+
+        span.url = scanGroupUrl(scanner);
+        span.name = scanner.takeText();
+        if (span.name.empty()) {
+            return false;
+        }
+
+        scanner.skip("</font></a>");
+        const auto position = scanner.getPosition();
+        if (!(scanner.skip("<gr") && scanner.skipDigits() && scanner.skip(">"))) {
+            scanner.setPosition(position);
+        }
+        return true;
+    }
+
+    /*
+     * The same as the search by DEFAULT_BOOK_GROUPS_PATTERN, but in linear time: std::regex matches the lazy content
+     * of a group recursively (one frame per character), which is slow and may overflow the stack on large groups.
+     */
+    std::vector<GroupSpan> findGroups(std::string_view pageText) {
+        constexpr std::string_view nextGroup = "</small><p><font";
+        constexpr std::string_view endOfContent = "</dl>";
+
+        // the ends are searched again only when they are passed, so the page is scanned once
+        std::size_t nextGroupAt = 0;
+        std::size_t endOfContentAt = 0;
+
+        std::vector<GroupSpan> groups;
+        for (auto start = pageText.find("<a"); start != std::string_view::npos; start = pageText.find("<a", start)) {
+            Scanner scanner(pageText, start);
+            GroupSpan span;
+            if (!scanGroupHeader(scanner, span)) {
+                start++;
+                continue;
+            }
+
+            const auto contentStart = scanner.getPosition();
+            if (nextGroupAt < contentStart) {
+                nextGroupAt = pageText.find(nextGroup, contentStart);
+            }
+            if (endOfContentAt < contentStart) {
+                endOfContentAt = pageText.find(endOfContent, contentStart);
+            }
+            const auto contentEnd = std::min(nextGroupAt, endOfContentAt);
+            if (contentEnd == std::string_view::npos) {
+                break;  // neither this group nor the next ones are closed
+            }
+
+            span.content = pageText.substr(contentStart, contentEnd - contentStart);
+            groups.push_back(span);
+            start = contentEnd + (contentEnd == nextGroupAt ? nextGroup.size() : endOfContent.size());
+        }
+
+        return groups;
+    }
+
+    std::vector<GroupSpan> findGroups(std::string_view pageText, const std::string& bookGroupPattern) {
+        const auto& reBookGroups = getRegex(bookGroupPattern, std::regex_constants::ECMAScript);
+        std::cregex_iterator begin(pageText.data(), pageText.data() + pageText.size(), reBookGroups);
+        std::cregex_iterator end;
+
+        std::vector<GroupSpan> groups;
+        for (std::cregex_iterator i = begin; i != end; ++i) {
+            const std::cmatch& match = *i;
+            groups.push_back({toView(match[1]), toView(match[2]), toView(match[3])});
+        }
+
+        return groups;
+    }
+
+    // the books of the groups are parsed by batches of the groups in parallel, the order of the groups is kept
+    void parseGroupsInParallel(BookGroupViewsList& bookGroupsList, const std::vector<GroupSpan>& groups,
+                               executor::Executor& executor) {
+        // the memory of the list (e.g. an arena) isn't thread-safe, so the books are copied to it afterwards
+        std::vector<BookViewsList> books(groups.size());
+
+        executor::TaskGroup tasks(executor);
+        for (std::size_t first = 0; first < groups.size();) {
+            auto last = first;
+            for (std::size_t size = 0; last < groups.size() && size < PARALLEL_PARSE_BATCH_SIZE; last++) {
+                size += groups[last].content.size();
+            }
+
+            tasks.submit([&groups, &books, first, last] {
+                for (auto i = first; i < last; i++) {
+                    books[i] = getBookViews(groups[i].content);
+                }
+            });
+            first = last;
+        }
+        tasks.wait();
+
+        for (std::size_t i = 0; i < groups.size(); i++) {
+            bookGroupsList[i].books.assign(books[i].begin(), books[i].end());
+        }
+    }
+}
+
+BookGroupViewsList parser::getBookGroupViews(std::string_view pageText, const std::string& bookGroupPattern,
+                                             std::pmr::memory_resource* resource, executor::Executor& executor) {
+    const auto groups = bookGroupPattern == DEFAULT_BOOK_GROUPS_PATTERN ? findGroups(pageText)
+                                                                       : findGroups(pageText, bookGroupPattern);
+
+    BookGroupViewsList bookGroupsList(resource);
+    bookGroupsList.reserve(groups.size());
+    std::size_t contentSize = 0;
+    for (const auto& group : groups) {
+        auto& bookGroup = bookGroupsList.emplace_back();
+        bookGroup.type = group.url.empty() ? BookGroupPlain : BookGroupExternal;
+        bookGroup.name = trim_view(group.name, noisyChar);
 
         // URL that starts from `/type` doesn't belong to the author, it is something common for the whole SamLib site
         // and because it's irrelevant to the author, we don't want to grab that information
-        bookGroup.url = url.compare(0, 5, "/type") == 0 ? "" : url ;
+        bookGroup.url = group.url.starts_with("/type") ? std::string_view() : group.url;
+        contentSize += group.content.size();
+    }
+
+    if (executor.getConcurrency() > 1 && groups.size() > 1 && contentSize > PARALLEL_PARSE_BATCH_SIZE) {
+        parseGroupsInParallel(bookGroupsList, groups, executor);
+        return bookGroupsList;
+    }
+
+    for (std::size_t i = 0; i < groups.size(); i++) {
+        bookGroupsList[i].books = getBookViews(groups[i].content, DEFAULT_BOOK_PATTERN, resource);
+    }
+
+    return bookGroupsList;
+}
+
+BooksList parser::getBooks(const std::string& pageText, const std::string& bookPattern) {
+    const TextCleaner textCleaner;
+
+    BooksList bookList;
+    for (const auto& book : getBookViews(pageText, bookPattern)) {
+        bookList.push_back(book.toBook(textCleaner));
+    }
+
+    return bookList;
+}
+
+BookGroupsList parser::getBookGroupList(const std::string &pageText, const std::string& bookGroupPattern) {
+    const TextCleaner textCleaner;
+
+    BookGroupsList bookGroupsList;
+    for (const auto& groupView : getBookGroupViews(pageText, bookGroupPattern)) {
+        BookGroup bookGroup;
+        bookGroup.type = groupView.type;
+        bookGroup.url = groupView.url;
+        bookGroup.name = groupView.name;
+        for (const auto& book : groupView.books) {
+            bookGroup.books.push_back(book.toBook(textCleaner));
+        }
 
         bookGroupsList.push_back(std::move(bookGroup));
     }
@@ -133,3 +327,37 @@ Author parser::getAuthor(const std::string& pageText, const std::string& authorP
 
     return author;
 }
+
+
+std::string parser::getText(const std::string& pageText) {
+    std::string text;
+    text.reserve(pageText.size() / 2);
+
+    bool isTag = false;
+    bool isSpace = false;
+    for (const unsigned char ch : pageText) {
+        if (isTag) {
+            isTag = ch != '>';
+            continue;
+        }
+
+        if (ch == '<') {
+            isTag = true;
+            isSpace = true;  // tags usually separate words (e.g. `<br>`, `<p>`)
+            continue;
+        }
+
+        if (std::isspace(ch)) {
+            isSpace = true;
+            continue;
+        }
+
+        if (isSpace && !text.empty()) {
+            text.push_back(' ');
+        }
+        isSpace = false;
+        text.push_back(static_cast<char>(ch));
+    }
+
+    return text;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iomanip>
+#include <sstream>
+#include "pipeline.h"
+
+using namespace pipeline;
+
+
+double StageStats::getUtilization() const {
+    const auto capacity = static_cast<double>(this->elapsed.count()) * this->workers;
+    return capacity > 0 ? std::min(1.0, static_cast<double>(this->busy.count()) / capacity) : 0.0;
+}
+
+std::string pipeline::getReport(const std::vector<StageStats>& stages) {
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1);
+
+    stream << std::left << std::setw(14) << "pipeline" << std::right
+           << std::setw(9) << "workers" << std::setw(8) << "items" << std::setw(8) << "busy, %"
+           << std::setw(11) << "queue avg" << std::setw(11) << "queue max" << std::setw(14) << "blocked, ms"
+           << std::endl;
+
+    for (const auto& stage : stages) {
+        stream << std::left << std::setw(14) << stage.name << std::right
+               << std::setw(9) << stage.workers
+               << std::setw(8) << stage.items
+               << std::setw(8) << stage.getUtilization() * 100
+               << std::setw(11) << stage.input.averageDepth
+               << std::setw(7) << stage.input.maxDepth << "/" << std::setw(3) << std::left << stage.input.capacity
+               << std::right << std::setw(14)
+               << std::chrono::duration<double, std::milli>(stage.input.blocked).count() << std::endl;
+    }
+
+    return stream.str();
+}
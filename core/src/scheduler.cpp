@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include "scheduler.h"
+
+using namespace scheduler;
+
+
+static std::time_t smooth(std::time_t interval, std::time_t observation) {
+    return static_cast<std::time_t>(
+        SMOOTHING_FACTOR * static_cast<double>(observation) + (1 - SMOOTHING_FACTOR) * static_cast<double>(interval)
+    );
+}
+
+Scheduler::Scheduler(const std::shared_ptr<db::Connection>& connection,
+                     const std::shared_ptr<db::DB<db::Author>>& authorDB) :
+    _con(connection), _tSchedule(std::make_shared<db::DB<db::Schedule>>(connection)), _tAuthor(authorDB)
+{}
+
+void Scheduler::createTable() {
+    this->_tSchedule->createTable();
+}
+
+std::time_t Scheduler::_getHistoricalInterval(const db::AuthorData& author) const {
+    const auto sql = "SELECT DISTINCT MTIME / ? AS CHANGE FROM " + db::Book::getTable()
+                   + " WHERE AUTHOR_ID = ? AND MTIME > 0 ORDER BY CHANGE DESC LIMIT ?;";
+
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(this->_con->session, sql.c_str(), -1, &statement, nullptr) != SQLITE_OK) {
+        throw db::QueryError(sqlite3_errmsg(this->_con->session));
+    }
+
+    sqlite3_bind_int64(statement, 1, MIN_CHECK_INTERVAL);
+    sqlite3_bind_int(statement, 2, author.id);
+    sqlite3_bind_int(statement, 3, static_cast<int>(HISTORY_DEPTH));
+
+    std::vector<std::time_t> changes;
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        changes.push_back(static_cast<std::time_t>(sqlite3_column_int64(statement, 0)) * MIN_CHECK_INTERVAL);
+    }
+    sqlite3_finalize(statement);
+
+    if (changes.size() < 2) {
+        return DEFAULT_UPDATE_INTERVAL;
+    }
+
+    // the changes are ordered from the latest to the oldest one, so the interval is their average gap
+    return (changes.front() - changes.back()) / static_cast<std::time_t>(changes.size() - 1);
+}
+
+void Scheduler::onChecked(const db::AuthorData& author, bool hasChanges, std::time_t now) {
+    auto schedules = this->_tSchedule->retrieve(db::WhereAuthorIs(author), 1);
+    const bool isNew = schedules.empty();
+
+    db::ScheduleData schedule;
+    if (isNew) {
+        schedule.author_id = author.id;
+        schedule.interval = this->_getHistoricalInterval(author);
+        schedule.last_change = author.mtime;
+    } else {
+        schedule = schedules.front();
+    }
+
+    if (isNew) {
+        // the first check (e.g. right after the author is added) only sets the baseline
+        if (hasChanges) {
+            schedule.last_change = now;
+        }
+    } else if (hasChanges) {
+        if (schedule.last_change > 0 && now > schedule.last_change) {
+            schedule.interval = smooth(schedule.interval, now - schedule.last_change);
+        }
+        schedule.last_change = now;
+    } else if (schedule.last_change > 0 && now - schedule.last_change > schedule.interval) {
+        // the author is quieter than expected
+        schedule.interval = smooth(schedule.interval, now - schedule.last_change);
+    }
+
+    schedule.last_check = now;
+    schedule.next_check = now + std::clamp(
+        static_cast<std::time_t>(CHECK_RATIO * static_cast<double>(schedule.interval)),
+        MIN_CHECK_INTERVAL,
+        MAX_CHECK_INTERVAL
+    );
+
+    if (isNew) {
+        this->_tSchedule->add(schedule);
+    } else {
+        this->_tSchedule->update(schedule);
+    }
+}
+
+void Scheduler::remove(unsigned int authorId) {
+    this->_tSchedule->remove(db::Where("AUTHOR_ID = " + std::to_string(authorId)));
+}
+
+db::Authors Scheduler::getDueAuthors(std::time_t now, bool unreadFirst) const {
+    std::unordered_map<int, std::time_t> nextChecks;
+    for (const auto& schedule : this->_tSchedule->retrieve()) {
+        nextChecks[schedule.author_id] = schedule.next_check;
+    }
+
+    const auto getNextCheck = [&nextChecks](const db::AuthorData& author) {
+        const auto nextCheck = nextChecks.find(author.id);
+        return nextCheck == nextChecks.end() ? 0 : nextCheck->second;  // never checked means overdue
+    };
+
+    db::Authors dueAuthors;
+    for (auto& author : this->_tAuthor->retrieve()) {
+        if (getNextCheck(author) <= now) {
+            dueAuthors.push_back(std::move(author));
+        }
+    }
+
+    std::stable_sort(dueAuthors.begin(), dueAuthors.end(), [&](const auto& a, const auto& b) {
+        if (unreadFirst && a.is_new != b.is_new) {
+            return a.is_new;
+        }
+        return getNextCheck(a) < getNextCheck(b);
+    });
+
+    return dueAuthors;
+}
+
+db::ScheduleData Scheduler::getSchedule(unsigned int authorId) const {
+    auto schedules = this->_tSchedule->retrieve(db::Where("AUTHOR_ID = " + std::to_string(authorId)), 1);
+    if (schedules.empty()) {
+        throw db::DoesNotExist("The author #" + std::to_string(authorId) + " has no schedule");
+    }
+
+    return schedules.front();
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "staging.h"
+
+using namespace staging;
+
+// the stored names of the groups are trimmed as the names on the page are (see noisyChar())
+static std::string trimNoisy(const std::string& expression) {
+    return "trim(" + expression + ", ' ,.:;@-' || char(9, 10, 11, 12, 13))";
+}
+
+/**
+ * @brief Owns the prepared statement, so it's finalized on any exit.
+ */
+class Statement {
+    private:
+        sqlite3* _session;
+        sqlite3_stmt* _statement = nullptr;
+
+    public:
+        Statement(sqlite3* session, const std::string& sql) : _session(session) {
+            if (sqlite3_prepare_v2(session, sql.c_str(), -1, &this->_statement, nullptr) != SQLITE_OK) {
+                throw db::QueryError(sqlite3_errmsg(session));
+            }
+        }
+        ~Statement() {
+            sqlite3_finalize(this->_statement);
+        }
+
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+
+        sqlite3_stmt* operator*() const {return this->_statement;}
+
+        // the text must be alive until the statement is executed
+        void bind(int index, std::string_view text) const {
+            sqlite3_bind_text(this->_statement, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        }
+        void bind(int index, long long value) const {
+            sqlite3_bind_int64(this->_statement, index, value);
+        }
+
+        /**
+         * @return true if there is a row to read
+         */
+        bool step() const {
+            const auto rc = sqlite3_step(this->_statement);
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+                throw db::QueryError(sqlite3_errmsg(this->_session));
+            }
+            return rc == SQLITE_ROW;
+        }
+
+        // executes the statement once more with the new parameters
+        void run() const {
+            this->step();
+            sqlite3_reset(this->_statement);
+        }
+};
+
+static void exec(sqlite3* session, const std::string& sql) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(session, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::string error(errMsg ? errMsg : "unknown error");
+        sqlite3_free(errMsg);
+        throw db::QueryError(error);
+    }
+}
+
+
+StagingDiff::StagingDiff(const std::shared_ptr<db::Connection>& connection,
+                         const std::shared_ptr<db::DB<db::Book>>& bookDB,
+                         const std::shared_ptr<db::DB<db::GroupBook>>& groupDB) :
+    _con(connection), _tBook(bookDB), _tGroup(groupDB)
+{}
+
+void StagingDiff::_createTables() {
+    // the temporary tables exist as long as the connection; the books are inserted in the order of the page, so their
+    // ROWID is the order
+    exec(this->_con->session,
+        "CREATE TEMP TABLE IF NOT EXISTS StagingGroup (\n"
+        "    GROUP_INDEX INTEGER PRIMARY KEY,\n"
+        "    NAME        TEXT NOT NULL,\n"
+        "    GROUP_ID    INTEGER\n"
+        ");\n"
+        "CREATE TEMP TABLE IF NOT EXISTS StagingBook (\n"
+        "    GROUP_INDEX INTEGER NOT NULL,\n"
+        "    BOOK_INDEX  INTEGER NOT NULL,\n"
+        "    LINK        TEXT NOT NULL,\n"
+        "    SIZE        INTEGER NOT NULL\n"
+        ");\n"
+        "CREATE INDEX IF NOT EXISTS temp.idx_staging_book_link ON StagingBook (LINK);\n"
+    );
+    this->_isCreated = true;
+}
+
+void StagingDiff::stage(const db::AuthorData& author, const parser::BookGroupViewsList& webBookGroups) {
+    if (!this->_isCreated) {
+        this->_createTables();
+    }
+
+    // the links of the books are stored without the leading slash, see Book.LINK
+    const auto urlPrefix = std::string_view(author.url).substr(1);
+    const auto session = this->_con->session;
+
+    this->_con->begin();
+    try {
+        exec(session, "DELETE FROM temp.StagingGroup; DELETE FROM temp.StagingBook;");
+
+        const Statement insertGroup(session, "INSERT INTO temp.StagingGroup (GROUP_INDEX, NAME) VALUES (?1, ?2);");
+        const Statement insertBook(
+            session, "INSERT INTO temp.StagingBook (GROUP_INDEX, BOOK_INDEX, LINK, SIZE) VALUES (?1, ?2, ?3 || ?4, ?5);"
+        );
+        insertBook.bind(3, urlPrefix);
+
+        for (std::size_t groupIndex = 0; groupIndex < webBookGroups.size(); groupIndex++) {
+            const auto& webBookGroup = webBookGroups[groupIndex];
+            insertGroup.bind(1, static_cast<long long>(groupIndex));
+            insertGroup.bind(2, webBookGroup.name);
+            insertGroup.run();
+
+            insertBook.bind(1, static_cast<long long>(groupIndex));
+            for (std::size_t bookIndex = 0; bookIndex < webBookGroup.books.size(); bookIndex++) {
+                const auto& webBook = webBookGroup.books[bookIndex];
+                insertBook.bind(2, static_cast<long long>(bookIndex));
+                insertBook.bind(4, webBook.url);
+                insertBook.bind(5, static_cast<long long>(webBook.size));
+                insertBook.run();
+            }
+        }
+
+        // the first stored group wins if several ones have the same name, as in the registry of the stored groups
+        const Statement matchGroups(session,
+            "UPDATE temp.StagingGroup SET GROUP_ID = COALESCE(\n"
+            "    (SELECT MIN(g._id) FROM " + db::GroupBook::getTable() + " g"
+            "     WHERE g.AUTHOR_ID = ?1 AND " + trimNoisy("g.NAME") + " = StagingGroup.NAME),\n"
+            "    -(GROUP_INDEX + 1)\n"
+            ");"
+        );
+        matchGroups.bind(1, static_cast<long long>(author.id));
+        matchGroups.run();
+    } catch (const db::DBError&) {
+        this->_con->rollback();
+        throw;
+    }
+    this->_con->commit();
+}
+
+std::vector<int> StagingDiff::getGroupIds() const {
+    const Statement select(this->_con->session, "SELECT GROUP_ID FROM temp.StagingGroup ORDER BY GROUP_INDEX;");
+
+    std::vector<int> ids;
+    while (select.step()) {
+        ids.push_back(sqlite3_column_int(*select, 0));
+    }
+
+    return ids;
+}
+
+ChangedBooks StagingDiff::getChangedBooks(const db::AuthorData& author) const {
+    // the stored book is found by the index (AUTHOR_ID, LINK)
+    const Statement select(this->_con->session,
+        "SELECT s.GROUP_INDEX, s.BOOK_INDEX, b._id, b.SIZE, b.GROUP_ID, b.DATE\n"
+        "FROM temp.StagingBook s\n"
+        "JOIN temp.StagingGroup g ON g.GROUP_INDEX = s.GROUP_INDEX\n"
+        "LEFT JOIN " + db::Book::getTable() + " b ON b.AUTHOR_ID = ?1 AND b.LINK = s.LINK\n"
+        "WHERE b._id IS NULL OR IFNULL(b.SIZE, 0) != s.SIZE OR b.GROUP_ID != g.GROUP_ID\n"
+        "ORDER BY s.rowid;"
+    );
+    select.bind(1, static_cast<long long>(author.id));
+
+    ChangedBooks books;
+    while (select.step()) {
+        ChangedBook book;
+        book.groupIndex = static_cast<std::size_t>(sqlite3_column_int64(*select, 0));
+        book.bookIndex = static_cast<std::size_t>(sqlite3_column_int64(*select, 1));
+        book.isNew = sqlite3_column_type(*select, 2) == SQLITE_NULL;
+        if (!book.isNew) {
+            book.stored.id = sqlite3_column_int(*select, 2);
+            book.stored.size = sqlite3_column_int(*select, 3);
+            book.stored.group_id = sqlite3_column_int(*select, 4);
+            book.stored.date = static_cast<std::time_t>(sqlite3_column_int64(*select, 5));
+        }
+        books.push_back(std::move(book));
+    }
+
+    return books;
+}
+
+db::Books StagingDiff::getRemovedBooks(const db::AuthorData& author) const {
+    return this->_tBook->retrieve(db::WhereAuthorIs(author) & db::Where(
+        "NOT EXISTS (SELECT 1 FROM temp.StagingBook s WHERE s.LINK = " + db::Book::getTable() + ".LINK)"
+    ));
+}
+
+db::GroupBooks StagingDiff::getRemovedGroups(const db::AuthorData& author) const {
+    return this->_tGroup->retrieve(db::WhereAuthorIs(author) & db::Where(
+        "NOT EXISTS (SELECT 1 FROM temp.StagingGroup s WHERE s.NAME = "
+        + trimNoisy(db::GroupBook::getTable() + ".NAME") + ")"
+    ));
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright 2024 Yurii Havenchuk.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include "stats.h"
+
+using namespace stats;
+
+namespace {
+    struct AtomicStageSummary {
+        std::atomic<unsigned long long> count{0};
+        std::atomic<long long> total{0};
+        std::atomic<long long> max{0};
+        std::array<std::atomic<unsigned long long>, HISTOGRAM_BUCKETS> buckets{};
+    };
+
+    std::atomic<bool> isCollecting{false};
+    std::array<AtomicStageSummary, STAGES_COUNT> stageSummaries{};
+    std::array<std::atomic<unsigned long long>, COUNTERS_COUNT> counters{};
+
+    // the per-author summaries are touched only when the collecting is enabled, so the plain mutex is fine here
+    std::mutex authorsMutex;
+    std::unordered_map<unsigned int, AuthorSummary> authorSummaries;
+
+    thread_local AuthorSummary* currentAuthor = nullptr;
+
+    std::size_t getBucket(std::chrono::nanoseconds duration) {
+        const auto count = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        const auto microseconds = static_cast<unsigned long long>(std::max<decltype(count)>(count, 0));
+        return std::min<std::size_t>(std::bit_width(microseconds), HISTOGRAM_BUCKETS - 1);
+    }
+
+    double toMilliseconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    double toMilliseconds(std::chrono::microseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+
+std::chrono::microseconds StageSummary::getPercentile(double percentile) const {
+    if (this->count == 0) {
+        return std::chrono::microseconds{0};
+    }
+
+    const auto rank = static_cast<unsigned long long>(static_cast<double>(this->count) * percentile / 100.0);
+    unsigned long long seen = 0;
+    for (std::size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += this->buckets[i];
+        if (seen > rank || seen == this->count) {
+            // the max is more precise than the upper bound of the last bucket
+            return std::min(
+                std::chrono::microseconds{1LL << i},
+                std::chrono::duration_cast<std::chrono::microseconds>(this->max)
+            );
+        }
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(this->max);
+}
+
+
+void stats::setEnabled(bool isEnabled) {
+    isCollecting.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool stats::isEnabled() {
+    return isCollecting.load(std::memory_order_relaxed);
+}
+
+void stats::reset() {
+    for (auto& summary : stageSummaries) {
+        summary.count.store(0, std::memory_order_relaxed);
+        summary.total.store(0, std::memory_order_relaxed);
+        summary.max.store(0, std::memory_order_relaxed);
+        for (auto& bucket : summary.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(authorsMutex);
+    for (auto& [_, author] : authorSummaries) {
+        author.summary = Summary{};  // the entries are kept: they may be referenced by the active AuthorScope
+    }
+}
+
+void stats::record(Stage stage, std::chrono::nanoseconds duration) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    const auto index = static_cast<std::size_t>(stage);
+    const auto bucket = getBucket(duration);
+
+    auto& summary = stageSummaries[index];
+    summary.count.fetch_add(1, std::memory_order_relaxed);
+    summary.total.fetch_add(duration.count(), std::memory_order_relaxed);
+    summary.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    auto max = summary.max.load(std::memory_order_relaxed);
+    while (max < duration.count() && !summary.max.compare_exchange_weak(max, duration.count())) {}
+
+    if (currentAuthor) {
+        std::lock_guard<std::mutex> lock(authorsMutex);
+        auto& authorStage = currentAuthor->summary.stages[index];
+        authorStage.count++;
+        authorStage.total += duration;
+        authorStage.max = std::max(authorStage.max, duration);
+        authorStage.buckets[bucket]++;
+    }
+}
+
+void stats::add(Counter counter, unsigned long long value) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    const auto index = static_cast<std::size_t>(counter);
+    counters[index].fetch_add(value, std::memory_order_relaxed);
+
+    if (currentAuthor) {
+        std::lock_guard<std::mutex> lock(authorsMutex);
+        currentAuthor->summary.counters[index] += value;
+    }
+}
+
+void stats::attribute(Counter counter, unsigned long long value) {
+    if (!isEnabled() || !currentAuthor) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(authorsMutex);
+    currentAuthor->summary.counters[static_cast<std::size_t>(counter)] += value;
+}
+
+const char* stats::getName(Stage stage) {
+    switch (stage) {
+        case Stage::Author:      return "author";
+        case Stage::FetchPage:   return "fetch page";
+        case Stage::FetchGroup:  return "fetch group";
+        case Stage::Download:    return "download";
+        case Stage::Throttle:    return "throttle";
+        case Stage::Decode:      return "decode";
+        case Stage::ParseGroups: return "parse groups";
+        case Stage::ParseBooks:  return "parse books";
+        case Stage::Retrieve:    return "retrieve";
+        case Stage::Diff:        return "diff";
+        case Stage::Apply:       return "apply";
+        default:                 return "unknown";
+    }
+}
+
+const char* stats::getName(Counter counter) {
+    switch (counter) {
+        case Counter::Requests:        return "requests";
+        case Counter::BytesOnWire:     return "bytes on wire";
+        case Counter::BytesDownloaded: return "bytes downloaded";
+        case Counter::BytesDecoded:    return "bytes decoded";
+        case Counter::Throttled:       return "throttled";
+        case Counter::Retries:         return "retries";
+        case Counter::Failures:        return "failures";
+        default:                       return "unknown";
+    }
+}
+
+Summary stats::getSummary() {
+    Summary result;
+
+    for (std::size_t i = 0; i < STAGES_COUNT; i++) {
+        const auto& source = stageSummaries[i];
+        auto& target = result.stages[i];
+
+        target.count = source.count.load(std::memory_order_relaxed);
+        target.total = std::chrono::nanoseconds{source.total.load(std::memory_order_relaxed)};
+        target.max = std::chrono::nanoseconds{source.max.load(std::memory_order_relaxed)};
+        for (std::size_t j = 0; j < HISTOGRAM_BUCKETS; j++) {
+            target.buckets[j] = source.buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (std::size_t i = 0; i < COUNTERS_COUNT; i++) {
+        result.counters[i] = counters[i].load(std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+std::vector<AuthorSummary> stats::getAuthorSummaries() {
+    std::vector<AuthorSummary> result;
+
+    std::lock_guard<std::mutex> lock(authorsMutex);
+    result.reserve(authorSummaries.size());
+    for (const auto& [_, author] : authorSummaries) {
+        if (author.summary.stages[static_cast<std::size_t>(Stage::Author)].count) {
+            result.push_back(author);
+        }
+    }
+
+    return result;
+}
+
+std::string stats::getReport() {
+    const auto summary = getSummary();
+    auto authors = getAuthorSummaries();
+
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1);
+
+    stream << std::left << std::setw(14) << "stage" << std::right
+           << std::setw(8) << "count" << std::setw(12) << "total, ms" << std::setw(10) << "mean, ms"
+           << std::setw(10) << "p50, ms" << std::setw(10) << "p90, ms" << std::setw(10) << "p99, ms"
+           << std::setw(10) << "max, ms" << std::endl;
+
+    for (std::size_t i = 0; i < STAGES_COUNT; i++) {
+        const auto& stage = summary.stages[i];
+        if (!stage.count) {
+            continue;
+        }
+
+        stream << std::left << std::setw(14) << getName(static_cast<Stage>(i)) << std::right
+               << std::setw(8) << stage.count
+               << std::setw(12) << toMilliseconds(stage.total)
+               << std::setw(10) << toMilliseconds(stage.total) / static_cast<double>(stage.count)
+               << std::setw(10) << toMilliseconds(stage.getPercentile(50))
+               << std::setw(10) << toMilliseconds(stage.getPercentile(90))
+               << std::setw(10) << toMilliseconds(stage.getPercentile(99))
+               << std::setw(10) << toMilliseconds(stage.max) << std::endl;
+    }
+
+    stream << std::endl;
+    for (std::size_t i = 0; i < COUNTERS_COUNT; i++) {
+        stream << getName(static_cast<Counter>(i)) << ": " << summary.counters[i] << std::endl;
+    }
+
+    if (authors.empty()) {
+        return stream.str();
+    }
+
+    const auto getTotal = [](const AuthorSummary& author, Stage stage) {
+        return author.summary.stages[static_cast<std::size_t>(stage)].total;
+    };
+
+    std::sort(authors.begin(), authors.end(), [&getTotal](const auto& a, const auto& b) {
+        return getTotal(a, Stage::Author) > getTotal(b, Stage::Author);
+    });
+
+    stream << std::endl << std::right
+           << std::setw(8) << "author" << std::setw(12) << "total, ms" << std::setw(12) << "fetch, ms"
+           << std::setw(12) << "parse, ms" << std::setw(12) << "apply, ms" << std::setw(12) << "KiB"
+           << "  name" << std::endl;
+
+    for (const auto& author : authors) {
+        const auto fetch = getTotal(author, Stage::FetchPage) + getTotal(author, Stage::FetchGroup);
+        const auto parse = getTotal(author, Stage::ParseGroups) + getTotal(author, Stage::ParseBooks);
+        const auto bytes = author.summary.counters[static_cast<std::size_t>(Counter::BytesDownloaded)];
+
+        stream << std::setw(8) << author.authorId
+               << std::setw(12) << toMilliseconds(getTotal(author, Stage::Author))
+               << std::setw(12) << toMilliseconds(fetch)
+               << std::setw(12) << toMilliseconds(parse)
+               << std::setw(12) << toMilliseconds(getTotal(author, Stage::Apply))
+               << std::setw(12) << static_cast<double>(bytes) / 1024.0
+               << "  " << author.name << std::endl;
+    }
+
+    return stream.str();
+}
+
+
+ScopedTimer::ScopedTimer(Stage stage) : _stage(stage), _isEnabled(isEnabled()) {
+    if (this->_isEnabled) {
+        this->_start = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (this->_isEnabled) {
+        record(this->_stage, std::chrono::steady_clock::now() - this->_start);
+    }
+}
+
+
+AuthorScope::AuthorScope(unsigned int authorId, const std::string& name) : _isEnabled(isEnabled()) {
+    if (!this->_isEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(authorsMutex);
+    auto& author = authorSummaries[authorId];
+    author.authorId = authorId;
+    author.name = name;
+    currentAuthor = &author;
+}
+
+AuthorScope::~AuthorScope() {
+    if (this->_isEnabled) {
+        currentAuthor = nullptr;
+    }
+}
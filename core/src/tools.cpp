@@ -15,50 +15,239 @@
  */
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "tools.h"
 
-// C++ code for the above approach:
-
-unsigned long levenshteinRecursive(const std::string& text1, const std::string& text2, unsigned long m, unsigned long n)
+unsigned long getLevenshteinDistance(const std::string& text1, const std::string& text2)
 {
-    // text1 is empty
-    if (m == 0)
-    {
-        return n;
-    }
-    // text2 is empty
-    if (n == 0)
-    {
-        return m;
+    // classic dynamic programming approach which keeps only two rows of the distance matrix in memory
+    const auto& shorter = text1.length() < text2.length() ? text1 : text2;
+    const auto& longer = text1.length() < text2.length() ? text2 : text1;
+
+    std::vector<unsigned long> previous(shorter.length() + 1);
+    std::vector<unsigned long> current(shorter.length() + 1);
+
+    for (unsigned long j = 0; j <= shorter.length(); ++j) {
+        previous[j] = j;
     }
 
-    if (text1[m - 1] == text2[n - 1])
-    {
-        return levenshteinRecursive(text1, text2, m - 1, n - 1);
+    for (unsigned long i = 1; i <= longer.length(); ++i) {
+        current[0] = i;
+        for (unsigned long j = 1; j <= shorter.length(); ++j) {
+            if (longer[i - 1] == shorter[j - 1]) {
+                current[j] = previous[j - 1];
+                continue;
+            }
+
+            current[j] = 1 + std::min({
+                current[j - 1],   // Insert
+                previous[j],      // Remove
+                previous[j - 1]   // Replace
+            });
+        }
+        std::swap(previous, current);
     }
 
-    return 1 + std::min(
-            // Insert
-            levenshteinRecursive(text1, text2, m, n - 1),
-            std::min(
-                // Remove
-                levenshteinRecursive(text1, text2, m - 1, n),
-                // Replace
-                levenshteinRecursive(text1, text2, m - 1, n - 1)
-            )
-    );
+    return previous[shorter.length()];
 }
 
-
-unsigned long getLevenshteinDistance(const std::string& text1, const std::string& text2)
+double getSimilarity(const std::string& text1, const std::string& text2)
 {
-    return levenshteinRecursive(text1, text2, text1.length(), text2.length());
+    const auto maxLength = std::max(text1.length(), text2.length());
+    if (maxLength == 0) {
+        return 1.0;
+    }
+
+    return 1.0 - static_cast<double>(getLevenshteinDistance(text1, text2)) / static_cast<double>(maxLength);
 }
 
 void replaceAll(std::string& input, const std::string& search, const std::string& replacement) {
-    size_t start_pos = 0;
-    while ((start_pos = input.find(search, start_pos)) != std::string::npos) {
-        input.replace(start_pos, search.length(), replacement);
-        start_pos += replacement.length();
+    auto position = search.empty() ? std::string::npos : input.find(search);
+    if (position == std::string::npos) {
+        return;
     }
+
+    // the result is built aside, the replacing in place would move the tail of the input on every hit
+    std::string result;
+    result.reserve(input.size());
+    std::size_t start = 0;
+    for (; position != std::string::npos; position = input.find(search, start)) {
+        result.append(input, start, position - start).append(replacement);
+        start = position + search.size();
+    }
+    result.append(input, start);
+    input = std::move(result);
 }
+
+
+namespace {
+    const std::string_view EM_DASH = "&#8212;";
+
+    char toLower(char ch) {
+        return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    // the length of the `<dd>`, `<br>` or `<br/>` at the position, 0 if there's none of them
+    std::size_t getLineBreakLength(std::string_view html, std::size_t position) {
+        const auto tag = html.substr(position, 5);
+        if (tag.size() < 4 || tag[0] != '<') {
+            return 0;
+        }
+
+        const auto first = toLower(tag[1]);
+        const auto second = toLower(tag[2]);
+        if (first == 'd' && second == 'd' && tag[3] == '>') {
+            return 4;
+        }
+        if (first == 'b' && second == 'r') {
+            if (tag[3] == '>') {
+                return 4;
+            }
+            if (tag.size() == 5 && tag[3] == '/' && tag[4] == '>') {
+                return 5;
+            }
+        }
+        return 0;
+    }
+
+    bool isLineBreakEnd(std::string_view html, std::size_t position) {
+        return (position >= 3 && getLineBreakLength(html, position - 3) == 4)
+               || (position >= 4 && getLineBreakLength(html, position - 4) == 5);
+    }
+
+    /*
+     * The line breaks are replaced before the tags are removed, so their `>` doesn't close a tag and their first
+     * byte is a whitespace.
+     */
+    class TagFinder {
+        private:
+            std::string_view _html;
+            std::size_t _noEndsFrom = std::string_view::npos;   // there's no `>` of a tag from this position
+
+            std::size_t _findEnd(std::size_t from) {
+                if (from >= this->_noEndsFrom) {
+                    return std::string_view::npos;
+                }
+
+                auto end = this->_html.find('>', from);
+                while (end != std::string_view::npos && isLineBreakEnd(this->_html, end)) {
+                    end = this->_html.find('>', end + 1);
+                }
+                if (end == std::string_view::npos) {
+                    this->_noEndsFrom = from;
+                }
+                return end;
+            }
+
+            // `\S`
+            [[nodiscard]] bool _isNameChar(std::size_t position) const {
+                return position < this->_html.size() && !isSpaceChar(this->_html[position])
+                       && !getLineBreakLength(this->_html, position);
+            }
+
+        public:
+            explicit TagFinder(std::string_view html) : _html(html) {}
+
+            // the position of the `>` of the tag `<\/?(\S+?)[^>]*?>` which starts at the position, npos if it isn't
+            // a tag
+            std::size_t find(std::size_t position) {
+                if (this->_html.substr(position + 1).starts_with('/') && this->_isNameChar(position + 2)) {
+                    if (const auto end = this->_findEnd(position + 3); end != std::string_view::npos) {
+                        return end;
+                    }
+                }
+
+                return this->_isNameChar(position + 1) ? this->_findEnd(position + 2) : std::string_view::npos;
+            }
+    };
+
+    // the position of the first whitespace or markup byte (see CharClass), the size of the text if there's none
+    std::size_t findSpecialChar(std::string_view html, std::size_t from) {
+#if defined(__SSE2__)
+        const auto less = _mm_set1_epi8('<');
+        const auto semicolon = _mm_set1_epi8(';');
+        const auto blank = _mm_set1_epi8(' ');
+        const auto tab = _mm_set1_epi8('\t');
+        const auto lastControl = _mm_set1_epi8('\r' - '\t');
+
+        for (; from + sizeof(__m128i) <= html.size(); from += sizeof(__m128i)) {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(html.data() + from));
+            // `\t`, `\n`, `\v`, `\f` and `\r` are in a row
+            const auto control = _mm_sub_epi8(chunk, tab);
+            const auto isControl = _mm_cmpeq_epi8(_mm_min_epu8(control, lastControl), control);
+            const auto isMarkup = _mm_or_si128(_mm_cmpeq_epi8(chunk, less), _mm_cmpeq_epi8(chunk, semicolon));
+            const auto isSpecial = _mm_or_si128(_mm_or_si128(isMarkup, isControl), _mm_cmpeq_epi8(chunk, blank));
+
+            if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(isSpecial))) {
+                return from + std::countr_zero(mask);
+            }
+        }
+#endif
+        while (from < html.size() && !(CHAR_CLASSES[static_cast<unsigned char>(html[from])] & (CharSpace | CharMarkup))) {
+            from++;
+        }
+        return from;
+    }
+}
+
+std::string cleanHtml(std::string_view html) {
+    std::string text;
+    text.reserve(html.size());
+
+    // the whitespaces are written when the run of them ends: 2 or more of them as a single space
+    std::size_t spacesCount = 0;
+    char space = ' ';
+    const auto addSpace = [&](char ch) {
+        space = spacesCount++ ? ' ' : ch;
+    };
+    const auto writeSpaces = [&] {
+        if (spacesCount && !(text.empty() && space == ' ')) {
+            text.push_back(space);
+        }
+        spacesCount = 0;
+    };
+
+    TagFinder tags(html);
+    for (std::size_t position = 0; position < html.size();) {
+        if (const auto next = findSpecialChar(html, position); next > position) {
+            writeSpaces();
+            text.append(html.substr(position, next - position));
+            position = next;
+            continue;
+        }
+
+        const auto ch = html[position];
+        if (isSpaceChar(ch)) {
+            addSpace(ch);
+            position++;
+        } else if (ch == ';') {
+            writeSpaces();
+            text.push_back(ch);
+            if (text.ends_with(EM_DASH)) {
+                text.replace(text.size() - EM_DASH.size(), EM_DASH.size(), "-");
+            }
+            position++;
+        } else if (const auto length = getLineBreakLength(html, position)) {
+            addSpace('\n');
+            position += length;
+        } else if (const auto end = tags.find(position); end != std::string_view::npos) {
+            position = end + 1;
+        } else {
+            writeSpaces();
+            text.push_back(ch);
+            position++;
+        }
+    }
+
+    // the trailing space is trimmed
+    if (spacesCount == 1 && space != ' ') {
+        text.push_back(space);
+    }
+
+    return text;
+}
\ No newline at end of file